@@ -0,0 +1,108 @@
+// evaluation: numeric arrays against scalar loops in flisp, and the simd
+// kernel sets against each other
+//
+//   make bench && ./build/bench_arrays [elements] [rounds]
+//
+// a script computes a dot product, a sum and an element-wise product of
+// two vectors of floats with while loops over vec_get, then with the
+// array builtins on arrays of the same floats. the kernels of simd.h the
+// cpu supports are then timed on the same work directly
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "interp.h"
+#include "parser.h"
+#include "simd.h"
+
+static std::string setup(std::size_t elements) {
+  return "(def n " + std::to_string(elements) +
+         ")"
+         "(def xs (vec)) (def ys (vec)) (def i 0)"
+         "(while (< i n)"
+         "  (def x (vec_push xs (* i 0.5))) (def y (vec_push ys (- n i)))"
+         "  (set i (+ i 1)))"
+         "(def a (to_array xs)) (def b (to_array ys))";
+}
+
+static std::string scalar_round() {
+  return "(def i 0) (def dot 0.0) (def sum 0.0) (def out (vec))"
+         "(while (< i n)"
+         "  (set dot (+ dot (* (vec_get xs i) (vec_get ys i))))"
+         "  (set sum (+ sum (vec_get xs i)))"
+         "  (def p (vec_push out (* (vec_get xs i) (vec_get ys i))))"
+         "  (set i (+ i 1)))";
+}
+
+static std::string array_round() {
+  return "(def dot (arr_dot a b)) (def sum (arr_sum a))"
+         "(def out (arr_mul a b))";
+}
+
+static double run_script(const std::string& setup, const std::string& round,
+                         std::size_t rounds) {
+  eval_context ctx;
+  interp evaluator;
+  evaluator.eval(ctx, parse_source(setup), true);
+
+  std::string body;
+
+  for (std::size_t i = 0; i < rounds; ++i) {
+    body += round;
+  }
+
+  auto tree = parse_source(body);
+  auto start = std::chrono::steady_clock::now();
+  evaluator.eval(ctx, tree, true);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / rounds;
+}
+
+int main(int argc, char const* argv[]) {
+  std::size_t elements =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+  std::size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+
+  double scalar = run_script(setup(elements), scalar_round(), rounds);
+  double arrays = run_script(setup(elements), array_round(), rounds);
+
+  std::cout << elements << " floats, dot + sum + product per round"
+            << std::endl;
+  std::cout << "scalar loop in flisp: " << scalar * 1e6 << " us" << std::endl;
+  std::cout << "array builtins (" << simd().name << "): " << arrays * 1e6
+            << " us, " << scalar / arrays << "x" << std::endl;
+
+  std::vector<double> a(elements), b(elements), out(elements);
+
+  for (std::size_t i = 0; i < elements; ++i) {
+    a[i] = i * 0.5;
+    b[i] = static_cast<double>(elements - i);
+  }
+
+  std::size_t repeats = 200000000 / (elements + 1) + 1;
+
+  for (const simd_kernels* kernels : simd_available()) {
+    double check = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t r = 0; r < repeats; ++r) {
+      check += kernels->dot(a.data(), b.data(), elements);
+      check += kernels->sum(a.data(), elements);
+      kernels->apply(simd_op::mul, a.data(), false, b.data(), false,
+                     out.data(), elements);
+      check += out[r % elements];
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << kernels->name << " kernels: "
+              << elapsed.count() * 1e6 / repeats << " us (check " << check
+              << ")" << std::endl;
+  }
+
+  return 0;
+}
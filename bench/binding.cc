@@ -0,0 +1,64 @@
+// evaluation: calling bound c++ functions from a script
+//
+//   make bench && ./build/bench_binding [calls]
+//
+// runs the same loop calling a c++ function bound with eval_context::bind
+// and a fun doing the same arithmetic, so the difference is the cost of
+// going through the binding (argument checks and conversion) instead of
+// interpreting a body. the jit is off, both calls are interpreted
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "interp.h"
+#include "parser.h"
+
+static int64_t host_mix(int64_t acc, int64_t i, double scale) {
+  return acc + i * static_cast<int64_t>(scale);
+}
+
+static double time_loop(eval_context& ctx, interp& evaluator,
+                        const std::string& function, std::size_t calls) {
+  std::string loop = "(def acc 0) (def i 0) (while (< i " +
+                     std::to_string(calls) + ") (set acc (" + function +
+                     " acc i 2.0)) (set i (+ i 1)))";
+  std::shared_ptr<ast> tree = parse_source(loop);
+
+  auto start = std::chrono::steady_clock::now();
+  evaluator.eval(ctx, tree, true);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+int main(int argc, char const* argv[]) {
+  std::size_t calls = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+  eval_context ctx;
+  interp evaluator;
+  ctx.jit = false;
+  ctx.bind("host_mix", &host_mix);
+  evaluator.eval(ctx, parse_source("(fun mix (acc i scale) "
+                                   "((+ acc (* i (/ scale 2.0) 2))))"),
+                 true);
+
+  double host_time = time_loop(ctx, evaluator, "host_mix", calls);
+  expr_value host_acc = ctx.globals[0];
+  double fun_time = time_loop(ctx, evaluator, "mix", calls);
+  expr_value fun_acc = ctx.globals[0];
+
+  if (host_acc.as_number() != fun_acc.as_number()) {
+    std::cerr << "error: bound function and fun disagree" << std::endl;
+    return 1;
+  }
+
+  std::cout << calls << " calls from a loop" << std::endl;
+  std::cout << "bound: " << host_time * 1e9 / calls
+            << " ns/call, fun: " << fun_time * 1e9 / calls << " ns/call"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,270 @@
+// node dispatch: kind-tagged switch vs the former rtti-based dispatch
+//
+//   make bench && ./build/bench_dispatch [forms]
+//
+// the program is tests/main.lsp-style arithmetic repeated many times.
+// "old" mirrors the tree into the previous shared_ptr/virtual node
+// layout and evaluates it with the dynamic_pointer_cast chain that
+// get_value_from_expr used, and traverses it with the type_index map
+// and std::function callbacks visit() used. "new" runs the interpreter
+// and visit() as they are now over the arena tree (resolved, for the
+// interpreter). both evaluate with the same float accumulation
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+
+#include "interp.h"
+#include "lexer.h"
+#include "parser.h"
+
+namespace legacy {
+
+struct node {
+  virtual ~node() = default;
+};
+
+struct symbol : node {
+  symbol_id id;
+  explicit symbol(symbol_id id) : id(id) {}
+};
+
+struct integer : node {
+  int value;
+  explicit integer(int value) : value(value) {}
+};
+
+struct floating : node {
+  float value;
+  explicit floating(float value) : value(value) {}
+};
+
+struct boolean : node {
+  bool value;
+  explicit boolean(bool value) : value(value) {}
+};
+
+struct list : node {
+  std::vector<std::shared_ptr<node>> items;
+};
+
+std::shared_ptr<node> mirror(const expr* e) {
+  switch (e->kind()) {
+    case expr_kind::symbol:
+      return std::make_shared<symbol>(expr_cast<symbol_expr>(e)->get_id());
+    case expr_kind::integer:
+      return std::make_shared<integer>(expr_cast<integer_expr>(e)->get_value());
+    case expr_kind::floating:
+      return std::make_shared<floating>(expr_cast<float_expr>(e)->get_value());
+    case expr_kind::boolean:
+      return std::make_shared<boolean>(expr_cast<boolean_expr>(e)->get_value());
+    case expr_kind::string:
+    case expr_kind::local:
+    case expr_kind::global:
+    case expr_kind::call:
+      break;
+    case expr_kind::list: {
+      auto out = std::make_shared<list>();
+
+      for (const expr* child : expr_cast<list_expr>(e)->get_exprs()) {
+        out->items.push_back(mirror(child));
+      }
+
+      return out;
+    }
+  }
+
+  std::cerr << "error: only unresolved trees without strings are mirrored"
+            << std::endl;
+  exit(1);
+}
+
+float number(const expr_value& value) {
+  if (!value.is_number()) {
+    std::cerr << "error: invalid operand" << std::endl;
+    exit(1);
+  }
+
+  return value.as_number();
+}
+
+// variables as the interpreter used to keep them, keyed by symbol id
+using environment = std::unordered_map<symbol_id, expr_value>;
+
+expr_value eval(environment& ctx, const std::shared_ptr<node>& n) {
+  if (auto i = std::dynamic_pointer_cast<integer>(n)) {
+    return i->value;
+  } else if (auto f = std::dynamic_pointer_cast<floating>(n)) {
+    return f->value;
+  } else if (auto b = std::dynamic_pointer_cast<boolean>(n)) {
+    return b->value;
+  } else if (auto s = std::dynamic_pointer_cast<symbol>(n)) {
+    return ctx.at(s->id);
+  } else if (auto l = std::dynamic_pointer_cast<list>(n)) {
+    auto head = std::dynamic_pointer_cast<symbol>(l->items.front());
+    std::size_t size = l->items.size();
+
+    if (head->id == symbol_if) {
+      bool condition = eval(ctx, l->items[1]).as_bool();
+      return eval(ctx, l->items[condition ? 2 : 3]);
+    }
+
+    float acc = head->id == symbol_mul ? 1 : 0;
+    std::size_t first = 1;
+
+    if (head->id == symbol_sub || head->id == symbol_div) {
+      acc = number(eval(ctx, l->items[1]));
+      first = 2;
+    }
+
+    for (std::size_t i = first; i < size; ++i) {
+      float operand = number(eval(ctx, l->items[i]));
+
+      switch (head->id) {
+        case symbol_add:
+          acc += operand;
+          break;
+        case symbol_sub:
+          acc -= operand;
+          break;
+        case symbol_mul:
+          acc *= operand;
+          break;
+        case symbol_div:
+          acc /= operand;
+          break;
+      }
+    }
+
+    return acc;
+  }
+
+  std::cerr << "error: unknown expression type" << std::endl;
+  exit(1);
+}
+
+void visit(const std::shared_ptr<node>& n,
+           const std::unordered_map<std::type_index,
+                                    std::function<void(std::shared_ptr<node>)>>&
+               callbacks) {
+  auto it = callbacks.find(std::type_index(typeid(*n)));
+
+  if (it != callbacks.end()) {
+    it->second(n);
+  }
+
+  if (auto l = std::dynamic_pointer_cast<list>(n)) {
+    for (const auto& child : l->items) {
+      visit(child, callbacks);
+    }
+  }
+}
+
+}  // namespace legacy
+
+static std::string synthesize(std::size_t forms) {
+  std::string out;
+
+  for (std::size_t i = 0; i < forms; ++i) {
+    out += "(debug (+ 2 (- 3 7)) (/ m (- 3 11)) (* 3.142 7 7) (if #t 1 0)\n";
+    out += "       (+ n (* n 2) (- (/ 99 3) (* 0.1 0.2 (+ m n)))))\n";
+  }
+
+  return out;
+}
+
+template <typename F>
+static double best_of(int rounds, F&& f) {
+  double best = 1e300;
+
+  for (int i = 0; i < rounds; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+
+  return best;
+}
+
+int main(int argc, char const* argv[]) {
+  std::size_t forms = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+  std::string source = synthesize(forms);
+  std::vector<token> tokens = tokenize(source);
+  std::shared_ptr<ast> tree = parser(tokens).parse();
+  auto mirrored = std::dynamic_pointer_cast<legacy::list>(
+      legacy::mirror(tree->root));
+
+  legacy::environment env;
+  env[intern("n")] = 7;
+  env[intern("m")] = -2;
+
+  eval_context ctx;
+  interp evaluator;
+  evaluator.eval(ctx, parse_source("(def n 7) (def m (- 0 2))"), true);
+  std::shared_ptr<const ast> resolved = ctx.names.resolve(tree, true);
+  auto program = expr_cast<list_expr>(resolved->root);
+
+  float sink_old = 0, sink_new = 0;
+  std::size_t nodes_old = 0, nodes_new = 0;
+
+  double eval_old = best_of(5, [&] {
+    for (const auto& form : mirrored->items) {
+      auto debug = std::static_pointer_cast<legacy::list>(form);
+
+      for (std::size_t i = 1; i < debug->items.size(); ++i) {
+        sink_old += legacy::number(legacy::eval(env, debug->items[i]));
+      }
+    }
+  });
+
+  double eval_new = best_of(5, [&] {
+    for (const expr* form : program->get_exprs()) {
+      auto args = expr_cast<list_expr>(form)->get_exprs();
+
+      for (std::size_t i = 1; i < args.size(); ++i) {
+        sink_new += legacy::number(get_value_from_expr(ctx, args[i]));
+      }
+    }
+  });
+
+  std::unordered_map<std::type_index,
+                     std::function<void(std::shared_ptr<legacy::node>)>>
+      callbacks;
+  auto count_old = [&](std::shared_ptr<legacy::node>) { ++nodes_old; };
+
+  for (std::type_index type :
+       {std::type_index(typeid(legacy::symbol)),
+        std::type_index(typeid(legacy::integer)),
+        std::type_index(typeid(legacy::floating)),
+        std::type_index(typeid(legacy::boolean)),
+        std::type_index(typeid(legacy::list))}) {
+    callbacks[type] = count_old;
+  }
+
+  double visit_old =
+      best_of(5, [&] { legacy::visit(mirrored, callbacks); });
+  double visit_new = best_of(5, [&] {
+    visit(tree->root, [&](const auto*) { ++nodes_new; });
+  });
+
+  if (sink_old != sink_new || nodes_old != nodes_new) {
+    std::cerr << "error: old and new dispatch disagree" << std::endl;
+    return 1;
+  }
+
+  std::cout << forms << " forms, " << nodes_new / 5 << " nodes" << std::endl;
+  std::cout << "eval  old: " << eval_old * 1e3 << " ms, new: " << eval_new * 1e3
+            << " ms (" << eval_old / eval_new << "x)" << std::endl;
+  std::cout << "visit old: " << visit_old * 1e3
+            << " ms, new: " << visit_new * 1e3 << " ms ("
+            << visit_old / visit_new << "x)" << std::endl;
+
+  return 0;
+}
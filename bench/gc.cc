@@ -0,0 +1,49 @@
+// evaluation: garbage collector pauses against the young generation size
+//
+//   make bench && ./build/bench_gc [iterations]
+//
+// runs a loop that builds short-lived lists while a long-lived one stays
+// reachable, with young generations of different sizes. a smaller young
+// generation gives shorter but more frequent minor pauses
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "interp.h"
+#include "parser.h"
+
+static std::string program(std::size_t iterations) {
+  return "(fun range (n acc) ((if (= n 0) acc (range (- n 1) (cons n acc)))))"
+         "(def kept (range 50000 (list)))"
+         "(def i 0)"
+         "(while (< i " +
+         std::to_string(iterations) +
+         ") (def tmp (range 20 (list))) (set i (+ i 1)))";
+}
+
+int main(int argc, char const* argv[]) {
+  std::size_t iterations =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+
+  for (std::size_t young_kb : {64, 256, 1024, 4096}) {
+    eval_context ctx;
+    interp evaluator;
+    ctx.heap.young_limit = young_kb << 10;
+
+    auto start = std::chrono::steady_clock::now();
+    evaluator.eval(ctx, parse_source(program(iterations)), true);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    const gc_stats& gc = ctx.heap.stats();
+    std::cout << "young " << young_kb << " KB: " << elapsed.count() * 1e3
+              << " ms, " << gc.minor_collections << " minor and "
+              << gc.major_collections << " major collections, pauses "
+              << gc.max_pause * 1e3 << " ms max, "
+              << gc.total_pause * 1e3 << " ms total" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,70 @@
+// evaluation: independent scripts run concurrently in isolates
+//
+//   make bench && ./build/bench_isolates [scripts]
+//
+// runs the same batch of scripts with run_isolated (see isolate.h) on
+// pools of 1, 2, 4, .. up to the number of cores, and reports the
+// scripts finished per second for each. the scripts are parsed once and
+// shared by all the runs, the jit is off so each isolate does the same
+// amount of interpreting
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "isolate.h"
+#include "thread_pool.h"
+
+static std::string source(int n) {
+  return "(fun fib (n) ((if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))"
+         "(def i 0) (def acc 0)"
+         "(while (< i 2000) (set acc (+ acc (* i 0.5))) (set i (+ i 1)))"
+         "(debug (fib " +
+         std::to_string(n) + ") acc)";
+}
+
+int main(int argc, char const* argv[]) {
+  std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+  std::vector<std::shared_ptr<const script>> scripts;
+
+  for (std::size_t i = 0; i < count; ++i) {
+    scripts.push_back(std::make_shared<script>(source(16 + i % 4)));
+  }
+
+  auto setup = [](isolate& context) { context.context().jit = false; };
+  std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::string> expected;
+  double single = 0;
+
+  for (std::size_t threads = 1;; threads = std::min(threads * 2, cores)) {
+    thread_pool pool(threads - 1);  // the calling thread runs scripts too
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> outputs = run_isolated(scripts, setup, pool);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    if (expected.empty()) {
+      expected = outputs;
+      single = elapsed.count();
+    } else if (outputs != expected) {
+      std::cerr << "error: isolates disagree across runs" << std::endl;
+      return 1;
+    }
+
+    std::cout << threads << " threads: " << count / elapsed.count()
+              << " scripts/s (" << single / elapsed.count() << "x)"
+              << std::endl;
+
+    if (threads == cores) {
+      break;
+    }
+  }
+
+  return 0;
+}
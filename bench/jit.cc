@@ -0,0 +1,83 @@
+// evaluation: interpreted vs jit-compiled functions
+//
+//   make bench && ./build/bench_jit [n]
+//
+// runs a recursive int function (fib n) and a tail-recursive float loop
+// on the interpreter with and without the jit (see jit.h). the functions
+// are warmed up first, so the jit timings are the native code's steady
+// state and not the compilation
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "interp.h"
+#include "parser.h"
+
+static const char* program =
+    "(fun fib (n) ((if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))"
+    "(fun area (n step acc)"
+    "  ((if (<= n 0) acc (area (- n 1) step (+ acc (* step (* n step)))))))";
+
+template <typename F>
+static double best_of(int rounds, F&& f) {
+  double best = 1e300;
+
+  for (int i = 0; i < rounds; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+
+  return best;
+}
+
+// times evaluating form (resolved in ctx) with the jit on or off
+static double run(eval_context& ctx, const std::string& form, bool jit,
+                  double& sink) {
+  ctx.jit = jit;
+  std::shared_ptr<const ast> resolved =
+      ctx.names.resolve(parse_source(form), true);
+  const expr* call = expr_cast<list_expr>(resolved->root)->get_exprs()[0];
+
+  get_value_from_expr(ctx, call);  // warm up, compiles when jit is on
+
+  return best_of(5, [&] {
+    sink += get_value_from_expr(ctx, call).as_number();
+  });
+}
+
+int main(int argc, char const* argv[]) {
+  int n = argc > 1 ? std::atoi(argv[1]) : 27;
+
+  eval_context ctx;
+  interp evaluator;
+  evaluator.eval(ctx, parse_source(program), true);
+
+  std::string fib = "(fib " + std::to_string(n) + ")";
+  std::string area = "(area " + std::to_string(n * 100000) + " 0.001 0.0)";
+
+  for (const std::string& form : {fib, area}) {
+    double sink_interp = 0, sink_jit = 0;
+    double interp_time = run(ctx, form, false, sink_interp);
+    double jit_time = run(ctx, form, true, sink_jit);
+
+    if (sink_interp != sink_jit) {
+      std::cerr << "error: interpreter and jit disagree" << std::endl;
+      return 1;
+    }
+
+    std::cout << form << std::endl;
+    std::cout << "interp: " << interp_time * 1e3
+              << " ms, jit: " << jit_time * 1e3 << " ms ("
+              << interp_time / jit_time << "x)" << std::endl;
+  }
+
+  std::cout << ctx.jit_compiled << " functions compiled, " << ctx.jit_runs
+            << " native calls" << std::endl;
+  return 0;
+}
@@ -0,0 +1,93 @@
+// lexer throughput for each scanning path available on this cpu
+//
+//   make bench && ./build/bench_lexer [file.lsp | -] [megabytes]
+//
+// without a file (or with "-"), a synthetic program shaped like tests/main.lsp is
+// generated (long identifiers and string literals so the vector paths
+// have runs worth scanning)
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "lexer.h"
+#include "scan.h"
+#include "source.h"
+
+static std::string synthesize(std::size_t target_bytes) {
+  std::string out;
+  out.reserve(target_bytes + 256);
+
+  for (std::size_t i = 0; out.size() < target_bytes; ++i) {
+    std::string n = std::to_string(i);
+    out += "(def accumulated_total_" + n + " (+ 2 (- 3 7) 1024.5))\n";
+    out += "(set accumulated_total_" + n + " (* 3.142 7 7))\n";
+    out += "(debug \"formatted output for record number " + n + "\" #t)\n";
+    out += "(fun compute_weighted_average_" + n +
+           " (left_operand right_operand)\n"
+           "    ((/ (+ left_operand right_operand) 2)))\n\n";
+  }
+
+  return out;
+}
+
+static std::size_t lex_all(std::string_view source) {
+  lexer lex(source);
+  std::size_t count = 0;
+
+  while (lex.next_token().get_type() != token_type::token_end_of_file) {
+    ++count;
+  }
+
+  return count;
+}
+
+int main(int argc, char const* argv[]) {
+  source_buffer source;
+
+  if (argc > 1 && std::string(argv[1]) != "-") {
+    source = source_buffer::map_file(argv[1]);
+  } else {
+    std::size_t megabytes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64;
+    source = source_buffer(synthesize(megabytes << 20));
+  }
+
+  const int rounds = 5;
+  double mb = static_cast<double>(source.size()) / (1 << 20);
+  double scalar_rate = 0;
+
+  std::cout << "input: " << mb << " MB" << std::endl;
+
+  for (scan_isa isa : {scan_isa::scalar, scan_isa::sse2, scan_isa::avx2}) {
+    if (!scan_select(isa)) {
+      std::cout << scan_isa_name(isa) << ": unsupported" << std::endl;
+      continue;
+    }
+
+    double best = 0;
+    std::size_t tokens = lex_all(source.view());  // warm up the mapping
+
+    for (int i = 0; i < rounds; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      tokens = lex_all(source.view());
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+
+      if (mb / elapsed.count() > best) {
+        best = mb / elapsed.count();
+      }
+    }
+
+    if (isa == scan_isa::scalar) {
+      scalar_rate = best;
+    }
+
+    std::cout << scan_isa_name(isa) << ": " << best << " MB/s (" << tokens
+              << " tokens, " << best / scalar_rate << "x scalar)"
+              << std::endl;
+  }
+
+  scan_select(scan_detect());
+  return 0;
+}
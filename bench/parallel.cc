@@ -0,0 +1,78 @@
+// evaluation: pmap against arr_map as the number of threads grows
+//
+//   make bench && ./build/bench_parallel [elements]
+//
+// maps a function that does some interpreting per element (fib of a
+// small number, jit off so every call does the same work) over an array,
+// first with arr_map on the calling thread, then with pmap on pools of
+// 1, 2, 4, .. up to the number of cores, and reports the speedup of each
+// over arr_map
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "interp.h"
+#include "parser.h"
+#include "thread_pool.h"
+
+static std::string program(const char* map, std::size_t elements) {
+  return "(fun fib (n) ((if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))"
+         "(fun work (i) ((fib (+ 12 (- i (* (/ i 4) 4))))))"
+         "(debug (arr_sum (" +
+         std::string(map) + " \"work\" (array_range " +
+         std::to_string(elements) + "))))";
+}
+
+// seconds taken, and the output in out
+static double run(const std::string& source, thread_pool* pool,
+                  std::string& out) {
+  std::ostringstream output;
+  eval_context ctx;
+  interp evaluator;
+  ctx.jit = false;
+  ctx.pool = pool;
+  ctx.out = &output;
+
+  auto start = std::chrono::steady_clock::now();
+  evaluator.eval(ctx, parse_source(source), true);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  out = output.str();
+  return elapsed.count();
+}
+
+int main(int argc, char const* argv[]) {
+  std::size_t elements =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000;
+  std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+  std::string expected;
+  double serial = run(program("arr_map", elements), nullptr, expected);
+  std::cout << "arr_map: " << serial * 1e3 << " ms" << std::endl;
+
+  for (std::size_t threads = 1;; threads = std::min(threads * 2, cores)) {
+    thread_pool pool(threads - 1);  // the calling thread runs chunks too
+    std::string out;
+    double elapsed = run(program("pmap", elements), &pool, out);
+
+    if (out != expected) {
+      std::cerr << "error: pmap and arr_map disagree" << std::endl;
+      return 1;
+    }
+
+    std::cout << "pmap, " << threads << " threads: " << elapsed * 1e3
+              << " ms (" << serial / elapsed << "x)" << std::endl;
+
+    if (threads == cores) {
+      break;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,75 @@
+// evaluation: updating one entry of a large persistent map against
+// copying a std::unordered_map to update it
+//
+//   make bench && ./build/bench_persistent [entries] [updates]
+//
+// both sides start from a map of the given number of int keys and make
+// a new version with one key changed, over and over, keeping the first
+// version to check it still reads as it did. the persistent map copies
+// a path of small nodes per update, the hash table copies every entry
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+
+#include "gc.h"
+#include "persistent.h"
+
+int main(int argc, char const* argv[]) {
+  int64_t entries = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 10000;
+  int64_t updates = argc > 2 ? std::strtol(argv[2], nullptr, 10) : 2000;
+
+  {
+    gc_heap heap;
+    gc_map* first = gc_map::empty(heap);
+
+    for (int64_t i = 0; i < entries; ++i) {
+      first = first->assoc(heap, i, i);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    gc_map* map = first;
+
+    for (int64_t i = 0; i < updates; ++i) {
+      map = map->assoc(heap, i % entries, -i);
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    bool intact = first->find(entries / 2)->as_int() == entries / 2;
+
+    std::cout << "persistent map: " << elapsed.count() * 1e6 / updates
+              << " us per update, first version "
+              << (intact ? "intact" : "changed") << std::endl;
+  }
+
+  {
+    std::unordered_map<int64_t, expr_value> first;
+
+    for (int64_t i = 0; i < entries; ++i) {
+      first.emplace(i, i);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::unordered_map<int64_t, expr_value> map = first;
+
+    for (int64_t i = 0; i < updates; ++i) {
+      std::unordered_map<int64_t, expr_value> next = map;
+      next[i % entries] = -i;
+      map = std::move(next);
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    bool intact = first.at(entries / 2).as_int() == entries / 2;
+
+    std::cout << "copied std::unordered_map: "
+              << elapsed.count() * 1e6 / updates
+              << " us per update, first version "
+              << (intact ? "intact" : "changed") << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,96 @@
+// evaluation: many scripts waiting on the host at once, as tasks
+//
+//   make bench && ./build/bench_tasks [tasks] [lookups] [latency in ms]
+//
+// every task runs the same script, which makes a number of calls to
+// lookup, a host function standing in for a remote call: it suspends
+// the task and answers after the latency has passed. the tasks run on
+// the shared thread pool, so all of them are waiting at once instead of
+// one after the other. reports the time taken against the time the
+// lookups would block a thread for in a row, and the heap taken by a
+// task once spawned (glibc only)
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "scheduler.h"
+
+static std::string program(std::size_t lookups) {
+  return "(fun fetch (k) ((lookup k)))"
+         "(def total 0) (def i 0)"
+         "(while (< i " +
+         std::to_string(lookups) +
+         ")"
+         "  (set total (+ total (fetch i))) (set i (+ i 1)))"
+         "(debug total)";
+}
+
+static std::size_t heap_in_use() {
+#ifdef __GLIBC__
+  return mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+int main(int argc, char const* argv[]) {
+  std::size_t tasks = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+  std::size_t lookups = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+  double latency = argc > 3 ? std::strtod(argv[3], nullptr) : 2;
+
+  auto code = std::make_shared<const script>(program(lookups));
+  auto delay = std::chrono::duration_cast<scheduler::clock::duration>(
+      std::chrono::duration<double, std::milli>(latency));
+  symbol_id lookup = intern("lookup");
+  scheduler loop;
+
+  std::size_t heap_before = heap_in_use();
+
+  for (std::size_t i = 0; i < tasks; ++i) {
+    loop.spawn(code, [&](task& added) {
+      added.machine().bind(lookup, 1, [&, target = &added](
+                                          vm& machine, const vm_value* args) {
+        machine.suspend();
+        loop.resume_after(*target, delay, std::get<int64_t>(args[0]) * 2);
+        return vm_value();
+      });
+    });
+  }
+
+  std::size_t heap_spawned = heap_in_use();
+
+  auto start = std::chrono::steady_clock::now();
+  loop.run();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::string expected =
+      "int: " + std::to_string(lookups * (lookups - 1)) + "\n";
+
+  for (const auto& done : loop.tasks()) {
+    if (done->output() != expected) {
+      std::cerr << "error: a task printed " << done->output() << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << tasks << " tasks, " << lookups << " lookups of " << latency
+            << " ms each, " << thread_pool::shared().size() + 1
+            << " threads" << std::endl;
+  std::cout << "took " << elapsed.count() * 1e3 << " ms, blocking in a row: "
+            << tasks * lookups * latency << " ms" << std::endl;
+
+  if (heap_spawned > heap_before) {
+    std::cout << "heap per task: " << (heap_spawned - heap_before) / tasks
+              << " bytes" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,92 @@
+// evaluation: tree-walking interpreter vs bytecode vm
+//
+//   make bench && ./build/bench_vm [calls]
+//
+// defines a small arithmetic function with both engines, then evaluates
+// the same call form over and over. the interpreter walks the form each
+// time, the vm compiles it once and reruns the bytecode, so this is the
+// steady-state cost of a call (argument evaluation, the call itself and
+// the arithmetic in the body)
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "compiler.h"
+#include "interp.h"
+#include "lexer.h"
+#include "parser.h"
+#include "vm.h"
+
+static const char* program =
+    "(fun f (a b c) ((+ (* a b) (- c a) (/ b 2))))"
+    "(f 3 2.5 (+ 1 (f 1 2 3)))";
+
+static float number(const expr_value& value) { return value.as_number(); }
+
+static float number(const vm_value& value) {
+  if (auto i = std::get_if<int64_t>(&value)) {
+    return *i;
+  }
+
+  return std::get<double>(value);
+}
+
+template <typename F>
+static double best_of(int rounds, F&& f) {
+  double best = 1e300;
+
+  for (int i = 0; i < rounds; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+
+  return best;
+}
+
+int main(int argc, char const* argv[]) {
+  std::size_t calls = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+  std::shared_ptr<ast> tree = parse_source(program);
+  expr_span forms = expr_cast<list_expr>(tree->root)->get_exprs();
+
+  eval_context ctx;
+  interp evaluator;
+  evaluator.eval(ctx, parse_source(program), true);
+  std::shared_ptr<const ast> resolved = ctx.names.resolve(tree, true);
+  const expr* call_form = expr_cast<list_expr>(resolved->root)->get_exprs()[1];
+
+  vm machine;
+  machine.eval(forms[0]);
+  std::unique_ptr<vm_function> call = compile(machine, forms[1]);
+
+  float sink_interp = 0, sink_vm = 0;
+
+  double interp_time = best_of(5, [&] {
+    for (std::size_t i = 0; i < calls; ++i) {
+      sink_interp += number(get_value_from_expr(ctx, call_form));
+    }
+  });
+
+  double vm_time = best_of(5, [&] {
+    for (std::size_t i = 0; i < calls; ++i) {
+      sink_vm += number(machine.run(*call));
+    }
+  });
+
+  if (sink_interp != sink_vm) {
+    std::cerr << "error: interpreter and vm disagree" << std::endl;
+    return 1;
+  }
+
+  std::cout << calls << " evaluations of a nested call" << std::endl;
+  std::cout << "interp: " << interp_time * 1e3
+            << " ms, vm: " << vm_time * 1e3 << " ms ("
+            << interp_time / vm_time << "x)" << std::endl;
+
+  return 0;
+}
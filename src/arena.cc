@@ -0,0 +1,124 @@
+#include "./arena.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+namespace {
+
+constexpr std::size_t max_block_size = 1 << 20;
+
+}  // namespace
+
+ast_arena::ast_arena(std::size_t block_size) : next_block_size_(block_size) {}
+
+ast_arena::~ast_arena() { release(); }
+
+ast_arena::ast_arena(ast_arena&& other) noexcept
+    : next_block_size_(other.next_block_size_) {
+  *this = std::move(other);
+}
+
+ast_arena& ast_arena::operator=(ast_arena&& other) noexcept {
+  if (this != &other) {
+    release();
+
+    head_ = std::exchange(other.head_, nullptr);
+    cursor_ = std::exchange(other.cursor_, nullptr);
+    limit_ = std::exchange(other.limit_, nullptr);
+    reserved_ = std::exchange(other.reserved_, 0);
+    next_block_size_ = other.next_block_size_;
+  }
+
+  return *this;
+}
+
+void ast_arena::release() {
+  while (head_) {
+    block* next = head_->next;
+    std::free(head_);
+    head_ = next;
+  }
+
+  cursor_ = limit_ = nullptr;
+  reserved_ = 0;
+}
+
+void* ast_arena::allocate(std::size_t size, std::size_t align) {
+  std::uintptr_t at = reinterpret_cast<std::uintptr_t>(cursor_);
+  std::uintptr_t aligned = (at + align - 1) & ~(align - 1);
+
+  if (!cursor_ || aligned + size > reinterpret_cast<std::uintptr_t>(limit_)) {
+    grow(size + align);
+    at = reinterpret_cast<std::uintptr_t>(cursor_);
+    aligned = (at + align - 1) & ~(align - 1);
+  }
+
+  cursor_ = reinterpret_cast<char*>(aligned + size);
+  return reinterpret_cast<void*>(aligned);
+}
+
+// blocks double in size up to a cap, so a small form costs one small
+// block while large programs still amortize to a few allocations
+
+void ast_arena::grow(std::size_t min_size) {
+  std::size_t size = next_block_size_;
+
+  while (size < min_size + sizeof(block)) {
+    size *= 2;
+  }
+
+  block* fresh = static_cast<block*>(std::malloc(size));
+
+  if (!fresh) {
+    throw std::bad_alloc();
+  }
+
+  fresh->next = head_;
+  fresh->size = size;
+  head_ = fresh;
+  cursor_ = reinterpret_cast<char*>(fresh + 1);
+  limit_ = reinterpret_cast<char*>(fresh) + size;
+  reserved_ += size;
+
+  if (next_block_size_ < max_block_size) {
+    next_block_size_ *= 2;
+  }
+}
+
+std::string_view ast_arena::copy(std::string_view text) {
+  if (text.empty()) {
+    return {};
+  }
+
+  char* out = static_cast<char*>(allocate(text.size(), 1));
+  std::memcpy(out, text.data(), text.size());
+  return {out, text.size()};
+}
+
+void ast_arena::adopt(ast_arena&& other) {
+  if (!other.head_) {
+    return;
+  }
+
+  if (!head_) {
+    *this = std::move(other);
+    return;
+  }
+
+  // splice the other chain in behind our current block so that we keep
+  // bump-allocating from where we were
+
+  block* tail = other.head_;
+
+  while (tail->next) {
+    tail = tail->next;
+  }
+
+  tail->next = head_->next;
+  head_->next = other.head_;
+  reserved_ += other.reserved_;
+
+  other.head_ = nullptr;
+  other.cursor_ = other.limit_ = nullptr;
+  other.reserved_ = 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <utility>
+
+// bump allocator for syntax trees. nodes are carved out of large blocks
+// back to back and released all at once when the arena goes away, no
+// destructor is ever run, so anything placed in it must only hold
+// trivially destructible members (other arena pointers, string_views
+// into the arena, plain values)
+
+class ast_arena {
+ public:
+  explicit ast_arena(std::size_t block_size = 1024);
+  ~ast_arena();
+
+  ast_arena(const ast_arena&) = delete;
+  ast_arena& operator=(const ast_arena&) = delete;
+  ast_arena(ast_arena&& other) noexcept;
+  ast_arena& operator=(ast_arena&& other) noexcept;
+
+  void* allocate(std::size_t size, std::size_t align);
+
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  template <typename T>
+  T* copy_array(const T* items, std::size_t count) {
+    if (count == 0) {
+      return nullptr;
+    }
+
+    T* out = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    std::memcpy(out, items, sizeof(T) * count);
+    return out;
+  }
+
+  std::string_view copy(std::string_view text);
+
+  // takes over the blocks of another arena, so trees built in it (e.g.
+  // on another thread) can be linked into ours and freed with it
+  void adopt(ast_arena&& other);
+
+  std::size_t bytes_reserved() const { return reserved_; }
+
+ private:
+  struct block {
+    block* next;
+    std::size_t size;
+  };
+
+  block* head_ = nullptr;  // current block, older ones follow it
+  char* cursor_ = nullptr;
+  char* limit_ = nullptr;
+  std::size_t next_block_size_;
+  std::size_t reserved_ = 0;
+
+  void grow(std::size_t min_size);
+  void release();
+};
+
+#endif  // ARENA_H
@@ -0,0 +1,85 @@
+#pragma once
+
+#ifndef ARITH_H
+#define ARITH_H
+
+#include <cstdint>
+
+#include "error.h"
+
+// arithmetic shared by interp and vm so both agree on the numeric tower:
+// ints are int64 and stay ints while both operands are, overflowing is
+// an error. anything involving a float is done in double, as is a
+// quotient of ints that isn't a whole number
+
+// one step on two ints. anything but ok leaves out unset: overflow is an
+// error, inexact carries on in double
+enum class int_step { ok, overflow, inexact };
+
+[[noreturn]] inline void div_by_zero() {
+  throw eval_error("div by zero");
+}
+
+struct add_op {
+  static constexpr const char* name = "add";
+
+  static int_step ints(int64_t a, int64_t b, int64_t* out) {
+    return __builtin_add_overflow(a, b, out) ? int_step::overflow
+                                             : int_step::ok;
+  }
+
+  static double floats(double a, double b) { return a + b; }
+};
+
+struct sub_op {
+  static constexpr const char* name = "sub";
+
+  static int_step ints(int64_t a, int64_t b, int64_t* out) {
+    return __builtin_sub_overflow(a, b, out) ? int_step::overflow
+                                             : int_step::ok;
+  }
+
+  static double floats(double a, double b) { return a - b; }
+};
+
+struct mul_op {
+  static constexpr const char* name = "mul";
+
+  static int_step ints(int64_t a, int64_t b, int64_t* out) {
+    return __builtin_mul_overflow(a, b, out) ? int_step::overflow
+                                             : int_step::ok;
+  }
+
+  static double floats(double a, double b) { return a * b; }
+};
+
+struct div_op {
+  static constexpr const char* name = "div";
+
+  static int_step ints(int64_t a, int64_t b, int64_t* out) {
+    if (b == 0) {
+      div_by_zero();
+    }
+
+    if (b == -1 && a == INT64_MIN) {
+      return int_step::overflow;
+    }
+
+    if (a % b != 0) {
+      return int_step::inexact;
+    }
+
+    *out = a / b;
+    return int_step::ok;
+  }
+
+  static double floats(double a, double b) {
+    if (b == 0) {
+      div_by_zero();
+    }
+
+    return a / b;
+  }
+};
+
+#endif  // ARITH_H
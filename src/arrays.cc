@@ -0,0 +1,405 @@
+#include "./arrays.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <vector>
+
+#include "./arith.h"
+#include "./error.h"
+#include "./lists.h"
+#include "./persistent.h"
+#include "./simd.h"
+
+gc_array::gc_array(bool floats, std::size_t length)
+    : floats_(floats),
+      length_(length),
+      data_(::operator new(std::max<std::size_t>(length, 1) * sizeof(double),
+                           std::align_val_t(alignment))) {
+  std::memset(data_, 0, length * sizeof(double));
+}
+
+gc_array::~gc_array() { ::operator delete(data_, std::align_val_t(alignment)); }
+
+gc_array* make_array(gc_heap& heap, const expr_value* items, std::size_t count,
+                     const char* op) {
+  bool floats = false;
+
+  for (std::size_t i = 0; i < count; ++i) {
+    if (!items[i].is_number()) {
+      invalid_type(op);
+    }
+
+    floats |= items[i].is_float();
+  }
+
+  gc_array* array = heap.make<gc_array>(floats, count);
+
+  for (std::size_t i = 0; i < count; ++i) {
+    if (floats) {
+      array->doubles()[i] = items[i].as_number();
+    } else {
+      array->ints()[i] = items[i].as_int();
+    }
+  }
+
+  return array;
+}
+
+namespace {
+
+gc_array* array_of(const expr_value& value, const char* op) {
+  auto array =
+      value.is_object() ? dynamic_cast<gc_array*>(value.as_object()) : nullptr;
+
+  if (!array) {
+    invalid_type(op);
+  }
+
+  return array;
+}
+
+std::size_t index_of(const gc_array* array, const expr_value& value,
+                     const char* op) {
+  if (!value.is_int()) {
+    invalid_type(op);
+  }
+
+  int64_t i = value.as_int();
+
+  if (i < 0 || static_cast<uint64_t>(i) >= array->length()) {
+    throw eval_error(std::string("index out of range for ") + op);
+  }
+
+  return static_cast<std::size_t>(i);
+}
+
+// the elements of an int array as doubles, or those of a float array
+// as they are
+const double* doubles_of(const gc_array* array, std::vector<double>& scratch) {
+  if (array->floats()) {
+    return array->doubles();
+  }
+
+  scratch.assign(array->ints(), array->ints() + array->length());
+  return scratch.data();
+}
+
+[[noreturn]] void lengths_differ(const char* op) {
+  throw eval_error(std::string("array lengths differ for ") + op);
+}
+
+[[noreturn]] void overflow(const char* op) {
+  throw eval_error(std::string("integer overflow in ") + op);
+}
+
+expr_value array(eval_context& ctx, const expr_value* args,
+                 std::size_t argc) {
+  return make_array(ctx.heap, args, argc, "array");
+}
+
+expr_value to_array(eval_context& ctx, const expr_value* args, std::size_t) {
+  std::vector<expr_value> items;
+  const expr_value& coll = args[0];
+  gc_object* object = coll.is_object() ? coll.as_object() : nullptr;
+
+  if (auto vector = dynamic_cast<const gc_vector*>(object)) {
+    for (std::size_t i = 0; i < vector->length(); ++i) {
+      items.push_back((*vector)[i]);
+    }
+  } else if (auto vector = dynamic_cast<const gc_pvec*>(object)) {
+    for (std::size_t i = 0; i < vector->count(); ++i) {
+      items.push_back((*vector)[i]);
+    }
+  } else if (auto array = dynamic_cast<const gc_array*>(object)) {
+    for (std::size_t i = 0; i < array->length(); ++i) {
+      items.push_back((*array)[i]);
+    }
+  } else if (coll.is_empty_list() || dynamic_cast<const gc_pair*>(object)) {
+    for (expr_value rest = coll; !rest.is_empty_list();) {
+      auto pair = static_cast<const gc_pair*>(rest.as_object());
+      items.push_back(pair->head);
+      rest = pair->tail;
+    }
+  } else {
+    invalid_type("to_array");
+  }
+
+  return make_array(ctx.heap, items.data(), items.size(), "to_array");
+}
+
+expr_value array_fill(eval_context& ctx, const expr_value* args,
+                      std::size_t) {
+  if (!args[0].is_int() || args[0].as_int() < 0 || !args[1].is_number()) {
+    invalid_type("array_fill");
+  }
+
+  std::size_t length = static_cast<std::size_t>(args[0].as_int());
+  gc_array* array = ctx.heap.make<gc_array>(args[1].is_float(), length);
+
+  if (array->floats()) {
+    std::fill_n(array->doubles(), length, args[1].as_float());
+  } else {
+    std::fill_n(array->ints(), length, args[1].as_int());
+  }
+
+  return array;
+}
+
+expr_value array_range(eval_context& ctx, const expr_value* args,
+                       std::size_t) {
+  if (!args[0].is_int() || args[0].as_int() < 0) {
+    invalid_type("array_range");
+  }
+
+  std::size_t length = static_cast<std::size_t>(args[0].as_int());
+  gc_array* array = ctx.heap.make<gc_array>(false, length);
+
+  for (std::size_t i = 0; i < length; ++i) {
+    array->ints()[i] = static_cast<int64_t>(i);
+  }
+
+  return array;
+}
+
+expr_value arr_get(eval_context&, const expr_value* args, std::size_t) {
+  const gc_array* array = array_of(args[0], "arr_get");
+  return (*array)[index_of(array, args[1], "arr_get")];
+}
+
+expr_value arr_set(eval_context&, const expr_value* args, std::size_t) {
+  gc_array* array = array_of(args[0], "arr_set");
+  std::size_t i = index_of(array, args[1], "arr_set");
+
+  if (array->floats() && args[2].is_number()) {
+    array->doubles()[i] = args[2].as_number();
+  } else if (!array->floats() && args[2].is_int()) {
+    array->ints()[i] = args[2].as_int();
+  } else {
+    invalid_type("arr_set");
+  }
+
+  return args[2];
+}
+
+// an operand of element-wise arithmetic, an array or a number used for
+// every element
+struct operand {
+  const gc_array* array = nullptr;
+  expr_value number;
+
+  bool floats() const {
+    return array ? array->floats() : number.is_float();
+  }
+};
+
+operand operand_of(const expr_value& value, const char* op) {
+  operand result;
+
+  if (value.is_number()) {
+    result.number = value;
+  } else {
+    result.array = array_of(value, op);
+  }
+
+  return result;
+}
+
+// a or b at i, as an int
+int64_t int_at(const operand& x, std::size_t i) {
+  return x.array ? x.array->ints()[i] : x.number.as_int();
+}
+
+// the doubles of x, a single one for a number
+const double* doubles_at(const operand& x, double& single,
+                         std::vector<double>& scratch) {
+  if (x.array) {
+    return doubles_of(x.array, scratch);
+  }
+
+  single = x.number.as_number();
+  return &single;
+}
+
+template <typename Op, simd_op code>
+expr_value elementwise(eval_context& ctx, const expr_value* args,
+                       const char* op) {
+  operand a = operand_of(args[0], op);
+  operand b = operand_of(args[1], op);
+
+  if (!a.array && !b.array) {
+    invalid_type(op);
+  }
+
+  if (a.array && b.array && a.array->length() != b.array->length()) {
+    lengths_differ(op);
+  }
+
+  std::size_t length = a.array ? a.array->length() : b.array->length();
+
+  // ints stay ints unless a quotient isn't whole, then the whole array
+  // is done again in floats
+  if (!a.floats() && !b.floats()) {
+    gc_array* result = ctx.heap.make<gc_array>(false, length);
+    std::size_t i = 0;
+
+    for (; i < length; ++i) {
+      int_step step =
+          Op::ints(int_at(a, i), int_at(b, i), &result->ints()[i]);
+
+      if (step == int_step::overflow) {
+        overflow(op);
+      }
+
+      if (step == int_step::inexact) {
+        break;
+      }
+    }
+
+    if (i == length) {
+      return result;
+    }
+  }
+
+  double single_a, single_b;
+  std::vector<double> scratch_a, scratch_b;
+  const double* x = doubles_at(a, single_a, scratch_a);
+  const double* y = doubles_at(b, single_b, scratch_b);
+
+  std::size_t divisors = b.array ? length : 1;
+
+  if (code == simd_op::div && std::find(y, y + divisors, 0.0) != y + divisors) {
+    div_by_zero();
+  }
+
+  gc_array* result = ctx.heap.make<gc_array>(true, length);
+  simd().apply(code, x, !a.array, y, !b.array, result->doubles(), length);
+  return result;
+}
+
+expr_value arr_add(eval_context& ctx, const expr_value* args, std::size_t) {
+  return elementwise<add_op, simd_op::add>(ctx, args, "arr_add");
+}
+
+expr_value arr_sub(eval_context& ctx, const expr_value* args, std::size_t) {
+  return elementwise<sub_op, simd_op::sub>(ctx, args, "arr_sub");
+}
+
+expr_value arr_mul(eval_context& ctx, const expr_value* args, std::size_t) {
+  return elementwise<mul_op, simd_op::mul>(ctx, args, "arr_mul");
+}
+
+expr_value arr_div(eval_context& ctx, const expr_value* args, std::size_t) {
+  return elementwise<div_op, simd_op::div>(ctx, args, "arr_div");
+}
+
+expr_value arr_sum(eval_context&, const expr_value* args, std::size_t) {
+  const gc_array* array = array_of(args[0], "arr_sum");
+
+  if (array->floats()) {
+    return simd().sum(array->doubles(), array->length());
+  }
+
+  int64_t total = 0;
+
+  for (std::size_t i = 0; i < array->length(); ++i) {
+    if (__builtin_add_overflow(total, array->ints()[i], &total)) {
+      overflow("arr_sum");
+    }
+  }
+
+  return total;
+}
+
+expr_value arr_dot(eval_context&, const expr_value* args, std::size_t) {
+  const gc_array* a = array_of(args[0], "arr_dot");
+  const gc_array* b = array_of(args[1], "arr_dot");
+
+  if (a->length() != b->length()) {
+    lengths_differ("arr_dot");
+  }
+
+  if (!a->floats() && !b->floats()) {
+    int64_t total = 0;
+
+    for (std::size_t i = 0; i < a->length(); ++i) {
+      int64_t product;
+
+      if (__builtin_mul_overflow(a->ints()[i], b->ints()[i], &product) ||
+          __builtin_add_overflow(total, product, &total)) {
+        overflow("arr_dot");
+      }
+    }
+
+    return total;
+  }
+
+  std::vector<double> scratch_a, scratch_b;
+  return simd().dot(doubles_of(a, scratch_a), doubles_of(b, scratch_b),
+                    a->length());
+}
+
+// the least element, or the greatest when most is set
+expr_value extreme(const expr_value& value, bool most, const char* op) {
+  const gc_array* array = array_of(value, op);
+
+  if (array->length() == 0) {
+    throw eval_error(std::string("empty array for ") + op);
+  }
+
+  if (array->floats()) {
+    return (most ? simd().max : simd().min)(array->doubles(),
+                                            array->length());
+  }
+
+  const int64_t* first = array->ints();
+  const int64_t* last = first + array->length();
+  return most ? *std::max_element(first, last) : *std::min_element(first, last);
+}
+
+expr_value arr_min(eval_context&, const expr_value* args, std::size_t) {
+  return extreme(args[0], false, "arr_min");
+}
+
+expr_value arr_max(eval_context&, const expr_value* args, std::size_t) {
+  return extreme(args[0], true, "arr_max");
+}
+
+// the function may reach safepoints, where the array stays reachable as
+// an argument of this call on the value stack. args itself may not stay
+// valid, the stack can grow
+expr_value arr_map(eval_context& ctx, const expr_value* args, std::size_t) {
+  if (!args[0].is_string()) {
+    invalid_type("arr_map");
+  }
+
+  symbol_id function = intern(args[0].as_string());
+  const gc_array* array = array_of(args[1], "arr_map");
+  std::vector<expr_value> results;
+  results.reserve(array->length());
+
+  for (std::size_t i = 0; i < array->length(); ++i) {
+    expr_value element = (*array)[i];
+    results.push_back(call_function(ctx, function, &element, 1));
+  }
+
+  return make_array(ctx.heap, results.data(), results.size(), "arr_map");
+}
+
+}  // namespace
+
+void define_array_functions(eval_context& ctx) {
+  static const primitive_def functions[] = {
+      {"array", 0, any_args, array},  {"to_array", 1, 1, to_array},
+      {"array_fill", 2, 2, array_fill}, {"array_range", 1, 1, array_range},
+      {"arr_get", 2, 2, arr_get},     {"arr_set", 3, 3, arr_set},
+      {"arr_add", 2, 2, arr_add},     {"arr_sub", 2, 2, arr_sub},
+      {"arr_mul", 2, 2, arr_mul},     {"arr_div", 2, 2, arr_div},
+      {"arr_sum", 1, 1, arr_sum},     {"arr_dot", 2, 2, arr_dot},
+      {"arr_min", 1, 1, arr_min},     {"arr_max", 1, 1, arr_max},
+      {"arr_map", 2, 2, arr_map},
+  };
+
+  define_primitives(ctx, functions, std::size(functions));
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef ARRAYS_H
+#define ARRAYS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "gc.h"
+#include "interp.h"
+
+// numeric arrays: a fixed number of int64s or doubles stored unboxed,
+// one after the other, on the garbage collected heap. the element-wise
+// arithmetic and the reductions on float arrays run on the simd kernels
+// of simd.h, int arrays follow the rules of arith.h element by element
+// (overflowing is an error)
+
+class gc_array final : public gc_object {
+ public:
+  // the storage is aligned for the widest vector loads of simd.h
+  static constexpr std::size_t alignment = 32;
+
+  // of length zeroed elements
+  gc_array(bool floats, std::size_t length);
+  gc_array(const gc_array&) = delete;
+  gc_array& operator=(const gc_array&) = delete;
+  ~gc_array() override;
+
+  void trace(gc_heap&) const override {}
+  std::size_t size() const override {
+    return sizeof(*this) + length_ * sizeof(double);
+  }
+
+  bool floats() const { return floats_; }
+  std::size_t length() const { return length_; }
+
+  // only the one of the array's kind is valid
+  double* doubles() { return static_cast<double*>(data_); }
+  const double* doubles() const { return static_cast<const double*>(data_); }
+  int64_t* ints() { return static_cast<int64_t*>(data_); }
+  const int64_t* ints() const { return static_cast<const int64_t*>(data_); }
+
+  expr_value operator[](std::size_t i) const {
+    return floats_ ? expr_value(doubles()[i]) : expr_value(ints()[i]);
+  }
+
+ private:
+  bool floats_;
+  std::size_t length_;
+  void* data_;
+};
+
+// an array of items, which have to be numbers (an invalid type for op
+// otherwise): of ints when every item is one, of floats otherwise
+gc_array* make_array(gc_heap& heap, const expr_value* items, std::size_t count,
+                     const char* op);
+
+// the functions on arrays every eval_context starts out with, length
+// (see lists.h) counts them too. an array is of ints when made from ints
+// only, of floats otherwise. fn names a function of one argument
+//
+//   (array a ..)           an array of the arguments
+//   (to_array c)           an array of the numbers in a list or vector
+//   (array_fill n x)       an array of n times x
+//   (array_range n)        the ints 0 to n - 1
+//   (arr_get a i)          element i
+//   (arr_set a i x)        replaces element i with x, gives x. an int
+//                          array only takes ints
+//   (arr_add a b)          element-wise, a or b may be a number used
+//   (arr_sub a b)          for every element. an int array divided
+//   (arr_mul a b)          gives floats unless every quotient is whole
+//   (arr_div a b)
+//   (arr_sum a)            of the elements, 0 for none
+//   (arr_dot a b)          the sum of the products of the elements
+//   (arr_min a)            the least element of a non-empty array
+//   (arr_max a)            the greatest element of a non-empty array
+//   (arr_map "fn" a)       the array of the results of fn on each element
+
+void define_array_functions(eval_context& ctx);
+
+#endif  // ARRAYS_H
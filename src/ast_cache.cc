@@ -0,0 +1,497 @@
+#include "./ast_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FLISP_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char image_magic[8] = {'f', 'l', 'i', 's', 'p', 'a', 's', 't'};
+constexpr uint32_t image_version = 2;
+
+// nodes are stored as they are laid out in memory, so an image can only
+// be used by a build with the same node sizes, pointer width and byte
+// order as the one that wrote it
+
+constexpr uint32_t image_layout =
+    (sizeof(void*) << 24) | (sizeof(list_expr) << 16) |
+    (sizeof(string_expr) << 8) | (sizeof(symbol_expr) << 4) |
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? 1 : 0);
+
+struct image_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t layout;
+  uint64_t source_hash;
+  uint64_t source_size;
+  uint64_t image_hash;  // of the whole file
+
+  // node offsets are relative to the start of the nodes section, which
+  // is also what every pointer in a node holds until it is relocated,
+  // symbol ids are indices into the name table until then
+
+  uint64_t nodes_offset, nodes_size;
+  uint64_t root;
+
+  // name_count {uint32_t offset, uint32_t size} entries (offsets relative
+  // to names_offset) followed by the names themselves
+  uint64_t names_offset, name_count;
+};
+
+uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+
+template <typename T>
+T* as_pointer(uint64_t offset) {
+  return reinterpret_cast<T*>(static_cast<std::uintptr_t>(offset));
+}
+
+// offset of the first item of count items of size bytes at offset
+// within a region of region_size bytes, false if they do not fit
+bool fits(uint64_t offset, uint64_t count, uint64_t size,
+          uint64_t region_size) {
+  return offset <= region_size && count <= (region_size - offset) / size;
+}
+
+}  // namespace
+
+// builds the image of a tree (children before their parents) and
+// relocates mapped images in place. it is a friend of the node classes
+// since it has to rewrite their pointer and symbol fields
+
+class ast_image {
+ public:
+  explicit ast_image(const ast& tree) { root_ = emit(tree.root); }
+
+  std::string finish(std::string_view source);
+
+  static const expr* relocate(char* image, std::size_t size,
+                              std::string_view source);
+
+ private:
+  std::string nodes_;
+  std::vector<symbol_id> names_;  // symbol of each name table index
+  std::unordered_map<symbol_id, uint32_t> name_index_;
+  uint64_t root_ = 0;
+
+  uint64_t reserve(std::size_t size, std::size_t align) {
+    uint64_t at = (nodes_.size() + align - 1) & ~uint64_t(align - 1);
+    nodes_.resize(at + size);  // padding stays zeroed
+    return at;
+  }
+
+  template <typename T, typename... Args>
+  T* place(uint64_t& at, Args&&... args) {
+    at = reserve(sizeof(T), alignof(T));
+    return new (&nodes_[at]) T(std::forward<Args>(args)...);
+  }
+
+  uint64_t emit(const expr* node);
+};
+
+uint64_t ast_image::emit(const expr* node) {
+  uint64_t at = 0;
+
+  switch (node->kind()) {
+    case expr_kind::symbol: {
+      symbol_id id = static_cast<const symbol_expr*>(node)->get_id();
+      auto [it, added] = name_index_.emplace(id, names_.size());
+
+      if (added) {
+        names_.push_back(id);
+      }
+
+      place<symbol_expr>(at, symbol_id(it->second));
+      break;
+    }
+    case expr_kind::integer:
+      place<integer_expr>(at, *static_cast<const integer_expr*>(node));
+      break;
+    case expr_kind::floating:
+      place<float_expr>(at, *static_cast<const float_expr*>(node));
+      break;
+    case expr_kind::boolean:
+      place<boolean_expr>(at, *static_cast<const boolean_expr*>(node));
+      break;
+    case expr_kind::string: {
+      std::string_view text = static_cast<const string_expr*>(node)->get_value();
+      uint64_t chars = reserve(text.size(), 1);
+      text.copy(&nodes_[chars], text.size());
+
+      place<string_expr>(
+          at, std::string_view(as_pointer<const char>(chars), text.size()));
+      break;
+    }
+    case expr_kind::local:
+    case expr_kind::global:
+    case expr_kind::call:
+      // slots are only meaningful to the process that resolved the tree
+      throw std::invalid_argument("resolved trees cannot be cached");
+    case expr_kind::list: {
+      expr_span children = static_cast<const list_expr*>(node)->get_exprs();
+      std::vector<uint64_t> offsets;
+      offsets.reserve(children.size());
+
+      for (const expr* child : children) {
+        offsets.push_back(emit(child));
+      }
+
+      if (offsets.empty()) {
+        place<list_expr>(at, expr_span());
+        break;
+      }
+
+      uint64_t array =
+          reserve(sizeof(const expr*) * offsets.size(), alignof(const expr*));
+
+      for (std::size_t i = 0; i < offsets.size(); ++i) {
+        const expr* child = as_pointer<const expr>(offsets[i]);
+        uint64_t slot = array + i * sizeof(const expr*);
+        std::memcpy(&nodes_[slot], &child, sizeof(child));
+      }
+
+      place<list_expr>(
+          at, expr_span(as_pointer<const expr* const>(array), offsets.size()));
+      break;
+    }
+  }
+
+  return at;
+}
+
+std::string ast_image::finish(std::string_view source) {
+  image_header header = {};
+  std::memcpy(header.magic, image_magic, sizeof(image_magic));
+  header.version = image_version;
+  header.layout = image_layout;
+  header.source_hash = hash_source(source);
+  header.source_size = source.size();
+  header.root = root_;
+
+  std::string image(sizeof(image_header), '\0');
+
+  auto align = [&image]() { image.resize((image.size() + 15) & ~15); };
+  auto append = [&image](const void* data, std::size_t size) {
+    image.append(static_cast<const char*>(data), size);
+  };
+
+  align();
+  header.nodes_offset = image.size();
+  header.nodes_size = nodes_.size();
+  image += nodes_;
+
+  align();
+  header.names_offset = image.size();
+  header.name_count = names_.size();
+
+  uint32_t name_at = names_.size() * 2 * sizeof(uint32_t);
+
+  for (symbol_id id : names_) {
+    uint32_t entry[2] = {name_at, uint32_t(symbol_name(id).size())};
+    append(entry, sizeof(entry));
+    name_at += entry[1];
+  }
+
+  for (symbol_id id : names_) {
+    image += symbol_name(id);
+  }
+
+  std::memcpy(&image[0], &header, sizeof(header));
+  header.image_hash = hash_source(image);
+  std::memcpy(&image[0], &header, sizeof(header));
+
+  return image;
+}
+
+const expr* ast_image::relocate(char* image, std::size_t size,
+                                std::string_view source) {
+  image_header header;
+
+  if (size < sizeof(header)) {
+    return nullptr;
+  }
+
+  std::memcpy(&header, image, sizeof(header));
+
+  if (std::memcmp(header.magic, image_magic, sizeof(image_magic)) != 0 ||
+      header.version != image_version || header.layout != image_layout ||
+      header.source_size != source.size() ||
+      header.source_hash != hash_source(source)) {
+    return nullptr;
+  }
+
+  // the image hash is taken with its own field zeroed
+
+  image_header unhashed = header;
+  unhashed.image_hash = 0;
+  std::memcpy(image, &unhashed, sizeof(unhashed));
+
+  if (header.image_hash != hash_source(std::string_view(image, size))) {
+    return nullptr;
+  }
+
+  if (!fits(header.nodes_offset, header.nodes_size, 1, size) ||
+      !fits(header.names_offset, header.name_count, 2 * sizeof(uint32_t),
+            size) ||
+      header.nodes_offset % alignof(std::max_align_t) != 0) {
+    return nullptr;
+  }
+
+  char* nodes = image + header.nodes_offset;
+  const char* names = image + header.names_offset;
+  std::size_t names_size = size - header.names_offset;
+  std::vector<symbol_id> ids(header.name_count);
+
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    uint32_t entry[2];
+    std::memcpy(entry, names + i * sizeof(entry), sizeof(entry));
+
+    if (!fits(entry[0], entry[1], 1, names_size)) {
+      return nullptr;
+    }
+
+    ids[i] = intern(std::string_view(names + entry[0], entry[1]));
+  }
+
+  // walks the tree from the root and fixes up each node in place.
+  // children (and string bytes) are written before their parents, so
+  // everything a node points to has to end before the node starts,
+  // which also keeps a damaged image from sending the walk in circles
+
+  std::vector<std::pair<uint64_t, uint64_t>> pending = {
+      {header.root, header.nodes_size}};  // node offset, end of its space
+
+  auto node_at = [nodes](uint64_t at, uint64_t end, auto* type) {
+    using node_type = std::remove_pointer_t<decltype(type)>;
+    return at % alignof(node_type) == 0 && fits(at, 1, sizeof(node_type), end)
+               ? reinterpret_cast<node_type*>(nodes + at)
+               : nullptr;
+  };
+
+  while (!pending.empty()) {
+    auto [at, end] = pending.back();
+    pending.pop_back();
+
+    if (at >= end) {
+      return nullptr;
+    }
+
+    switch (reinterpret_cast<const expr*>(nodes + at)->kind()) {
+      case expr_kind::symbol: {
+        auto node = node_at(at, end, static_cast<symbol_expr*>(nullptr));
+
+        if (!node || node->id_ >= ids.size()) {
+          return nullptr;
+        }
+
+        node->id_ = ids[node->id_];
+        break;
+      }
+      case expr_kind::integer:
+        if (!node_at(at, end, static_cast<integer_expr*>(nullptr))) {
+          return nullptr;
+        }
+        break;
+      case expr_kind::floating:
+        if (!node_at(at, end, static_cast<float_expr*>(nullptr))) {
+          return nullptr;
+        }
+        break;
+      case expr_kind::boolean:
+        if (!node_at(at, end, static_cast<boolean_expr*>(nullptr))) {
+          return nullptr;
+        }
+        break;
+      case expr_kind::string: {
+        auto node = node_at(at, end, static_cast<string_expr*>(nullptr));
+
+        if (!node) {
+          return nullptr;
+        }
+
+        uint64_t chars = reinterpret_cast<std::uintptr_t>(node->data_);
+
+        if (!fits(chars, node->size_, 1, at)) {
+          return nullptr;
+        }
+
+        node->data_ = nodes + chars;
+        break;
+      }
+      case expr_kind::list: {
+        auto node = node_at(at, end, static_cast<list_expr*>(nullptr));
+
+        if (!node) {
+          return nullptr;
+        }
+
+        if (node->size_ == 0) {
+          break;
+        }
+
+        uint64_t array = reinterpret_cast<std::uintptr_t>(node->data_);
+
+        if (array % alignof(const expr*) != 0 ||
+            !fits(array, node->size_, sizeof(const expr*), at)) {
+          return nullptr;
+        }
+
+        auto children = reinterpret_cast<const expr**>(nodes + array);
+
+        for (std::size_t i = 0; i < node->size_; ++i) {
+          uint64_t child = reinterpret_cast<std::uintptr_t>(children[i]);
+          children[i] = reinterpret_cast<const expr*>(nodes + child);
+          pending.emplace_back(child, array);
+        }
+
+        node->data_ = children;
+        break;
+      }
+      default:
+        return nullptr;
+    }
+  }
+
+  return reinterpret_cast<const expr*>(nodes + header.root);
+}
+
+uint64_t hash_source(std::string_view source) {
+  const char* p = source.data();
+  std::size_t n = source.size();
+  uint64_t h = mix(n);
+
+  for (; n >= sizeof(uint64_t); p += sizeof(uint64_t), n -= sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    h = (h ^ mix(word)) * 0x9e3779b97f4a7c15;
+  }
+
+  uint64_t tail = 0;
+  std::memcpy(&tail, p, n);
+
+  return mix(h ^ mix(tail));
+}
+
+std::string ast_cache_path(std::string_view source) {
+  const char* dir = std::getenv("FLISP_CACHE_DIR");
+
+  if (!dir || !*dir) {
+    return {};
+  }
+
+  char name[32];
+  std::snprintf(name, sizeof(name), "/%016llx.ast",
+                static_cast<unsigned long long>(hash_source(source)));
+
+  return std::string(dir) + name;
+}
+
+std::shared_ptr<const ast> load_ast_cache(const std::string& cache_path,
+                                          std::string_view source) {
+#ifdef FLISP_HAS_MMAP
+  int fd = open(cache_path.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+      st.st_size < static_cast<off_t>(sizeof(image_header))) {
+    close(fd);
+    return nullptr;
+  }
+
+  // a private writable mapping, only the pages that get relocated are
+  // copied and nothing is ever written back to the file
+
+  std::size_t size = static_cast<std::size_t>(st.st_size);
+  void* addr =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+
+  std::shared_ptr<const void> mapping(
+      addr, [size](const void* p) { munmap(const_cast<void*>(p), size); });
+
+  const expr* root =
+      ast_image::relocate(static_cast<char*>(addr), size, source);
+
+  if (!root) {
+    return nullptr;
+  }
+
+  mprotect(addr, size, PROT_READ);
+
+  auto tree = std::make_shared<ast>();
+  tree->root = root;
+  tree->backing = std::move(mapping);
+  return tree;
+#else
+  return nullptr;
+#endif
+}
+
+bool store_ast_cache(const std::string& cache_path, std::string_view source,
+                     const ast& tree) {
+  std::string image = ast_image(tree).finish(source);
+  std::filesystem::path path(cache_path);
+  std::error_code error;
+
+  if (path.has_parent_path()) {
+    std::filesystem::create_directories(path.parent_path(), error);
+  }
+
+  // written next to the final name and renamed over it, so a concurrent
+  // run never maps a half-written image
+
+#ifdef FLISP_HAS_MMAP
+  std::string temp_path = cache_path + ".tmp." + std::to_string(getpid());
+#else
+  std::string temp_path = cache_path + ".tmp";
+#endif
+
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file.write(image.data(), image.size());
+
+    if (!file.flush()) {
+      file.close();
+      std::filesystem::remove(temp_path, error);
+      return false;
+    }
+  }
+
+  std::filesystem::rename(temp_path, cache_path, error);
+
+  if (error) {
+    std::filesystem::remove(temp_path, error);
+    return false;
+  }
+
+  return true;
+}
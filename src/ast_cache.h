@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "parser.h"
+
+// on-disk cache of parsed trees, keyed by a hash of the source text.
+//
+// a cache file is an image of the tree's nodes laid out exactly as they
+// are in memory, with every pointer stored as an offset into the image
+// and every symbol as an index into a name table at the end of the file.
+// loading maps the file privately, walks the nodes once to add the
+// mapping's address to their pointers and swap the symbol indices for
+// ids interned in this process, and hands out the mapped nodes as they
+// are. nothing is allocated per node and nothing is lexed or parsed.
+//
+// images are only valid for the build that wrote them (node layout,
+// pointer size and byte order are checked), anything that does not
+// match or looks damaged is treated as a miss
+
+uint64_t hash_source(std::string_view source);
+
+// where the tree for source is cached: a file named after the hash in
+// $FLISP_CACHE_DIR, empty (no caching) unless that is set and not empty
+std::string ast_cache_path(std::string_view source);
+
+// nullptr on a miss
+std::shared_ptr<const ast> load_ast_cache(const std::string& cache_path,
+                                          std::string_view source);
+
+// false if the image could not be written, a failed write never leaves
+// a partial file behind. only trees straight from the parser can be
+// stored, not resolved ones (see resolver.h)
+bool store_ast_cache(const std::string& cache_path, std::string_view source,
+                     const ast& tree);
+
+#endif  // AST_CACHE_H
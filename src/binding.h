@@ -0,0 +1,171 @@
+#pragma once
+
+#ifndef BINDING_H
+#define BINDING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "error.h"
+#include "symbol.h"
+#include "value.h"
+
+// calling c++ functions from scripts (see eval_context::bind). the
+// parameter and return types of a bound function are read off its
+// signature at compile time, so a call checks the argument count and
+// the type of each argument and converts it in place on the value stack,
+// without building a vector or copying values around:
+//
+//   parameter type                  argument
+//   expr_value                      anything
+//   bool                            a bool
+//   any other integer type          an int that fits in it
+//   float, double                   a number (ints are converted)
+//   std::string, std::string_view   a string
+//
+// parameters may also be const references to these. results are
+// converted back likewise (const char* too), void results in 0 (the
+// value of nothing)
+
+template <typename T>
+using host_param = std::remove_cv_t<std::remove_reference_t<T>>;
+
+template <typename T>
+constexpr bool host_is_string = std::is_same_v<T, std::string> ||
+                                std::is_same_v<T, std::string_view>;
+
+template <typename T>
+bool host_accepts(const expr_value& value) {
+  using U = host_param<T>;
+
+  if constexpr (std::is_same_v<U, expr_value>) {
+    return true;
+  } else if constexpr (std::is_same_v<U, bool>) {
+    return value.is_bool();
+  } else if constexpr (std::is_integral_v<U>) {
+    if (!value.is_int()) {
+      return false;
+    }
+
+    int64_t i = value.as_int();
+    return i >= static_cast<int64_t>(std::numeric_limits<U>::min()) &&
+           (i < 0 || static_cast<uint64_t>(i) <=
+                         static_cast<uint64_t>(std::numeric_limits<U>::max()));
+  } else if constexpr (std::is_floating_point_v<U>) {
+    return value.is_number();
+  } else {
+    static_assert(host_is_string<U>, "unsupported parameter type");
+    return value.is_string();
+  }
+}
+
+// the argument as a U, once host_accepts said it is one
+template <typename T>
+decltype(auto) host_unbox(const expr_value& value) {
+  using U = host_param<T>;
+
+  if constexpr (std::is_same_v<U, expr_value>) {
+    return value;
+  } else if constexpr (std::is_same_v<U, bool>) {
+    return value.as_bool();
+  } else if constexpr (std::is_integral_v<U>) {
+    return static_cast<U>(value.as_int());
+  } else if constexpr (std::is_floating_point_v<U>) {
+    return static_cast<U>(value.as_number());
+  } else if constexpr (std::is_same_v<U, std::string_view>) {
+    return std::string_view(value.as_string());
+  } else {
+    return value.as_string();  // const std::string&
+  }
+}
+
+template <typename R>
+expr_value host_box(R&& result) {
+  using U = host_param<R>;
+
+  if constexpr (std::is_same_v<U, expr_value> || std::is_same_v<U, bool>) {
+    return std::forward<R>(result);
+  } else if constexpr (std::is_integral_v<U>) {
+    return static_cast<int64_t>(result);
+  } else if constexpr (std::is_floating_point_v<U>) {
+    return static_cast<double>(result);
+  } else {
+    static_assert(host_is_string<U> || std::is_same_v<U, const char*>,
+                  "unsupported result type");
+    return std::string(result);
+  }
+}
+
+// the signature of a function pointer, or of the call operator of a
+// function object (which can't be overloaded or a template)
+template <typename F>
+struct host_signature : host_signature<decltype(&F::operator())> {};
+
+template <typename R, typename... Args>
+struct host_signature<R (*)(Args...)> {
+  using result = R;
+  static constexpr std::size_t arity = sizeof...(Args);
+
+  template <std::size_t I>
+  using param = std::tuple_element_t<I, std::tuple<Args...>>;
+};
+
+template <typename R, typename... Args>
+struct host_signature<R (*)(Args...) noexcept>
+    : host_signature<R (*)(Args...)> {};
+
+template <typename C, typename R, typename... Args>
+struct host_signature<R (C::*)(Args...)> : host_signature<R (*)(Args...)> {};
+
+template <typename C, typename R, typename... Args>
+struct host_signature<R (C::*)(Args...) const>
+    : host_signature<R (*)(Args...)> {};
+
+template <typename C, typename R, typename... Args>
+struct host_signature<R (C::*)(Args...) noexcept>
+    : host_signature<R (*)(Args...)> {};
+
+template <typename C, typename R, typename... Args>
+struct host_signature<R (C::*)(Args...) const noexcept>
+    : host_signature<R (*)(Args...)> {};
+
+// calls function with the argc values at args, name is only for errors
+template <typename F, std::size_t... I>
+expr_value host_invoke(symbol_id name, F& function, const expr_value* args,
+                       std::size_t argc, std::index_sequence<I...>) {
+  using signature = host_signature<F>;
+
+  if (argc != signature::arity) {
+    throw eval_error("argument count does not match parameter count");
+  }
+
+  std::size_t bad = signature::arity;
+
+  // the index of the first argument of the wrong type, if any
+  ((bad == signature::arity &&
+            !host_accepts<typename signature::template param<I>>(args[I])
+        ? bad = I
+        : bad),
+   ...);
+
+  if (bad != signature::arity) {
+    throw eval_error("invalid type for argument " + std::to_string(bad + 1) +
+                     " of '" + symbol_name(name) + "'");
+  }
+
+  if constexpr (std::is_void_v<typename signature::result>) {
+    function(host_unbox<typename signature::template param<I>>(args[I])...);
+    return {};
+  } else {
+    return host_box(
+        function(host_unbox<typename signature::template param<I>>(args[I])...));
+  }
+}
+
+#endif  // BINDING_H
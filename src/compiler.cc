@@ -0,0 +1,442 @@
+#include "./compiler.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// registers are handed out like a stack: a value being built goes into
+// a register below top_, anything needed to compute it is allocated from
+// top_ upwards and released again once the value is in place
+
+class function_compiler {
+ public:
+  // form is the top-level form being compiled, the only place a fun may
+  // be, none for the body of a function
+  function_compiler(vm& machine, vm_function& function,
+                    std::vector<symbol_id> params,
+                    const expr* form = nullptr)
+      : machine_(machine),
+        function_(function),
+        params_(std::move(params)),
+        form_(form) {
+    if (params_.size() > 255) {
+      throw compile_error("too many parameters");
+    }
+
+    function_.arity = params_.size();
+    top_ = params_.size();
+  }
+
+  // compiles each form in turn and returns the value of the last one,
+  // which is in tail position
+  void compile_body(const expr* const* begin, const expr* const* end) {
+    uint8_t result = allocate();
+
+    if (begin == end) {
+      load_nothing(result);
+    }
+
+    for (auto it = begin; it != end; ++it) {
+      compile(*it, result, it + 1 == end);
+    }
+
+    emit(vm_instr::abc(op_ret, result));
+  }
+
+ private:
+  vm& machine_;
+  vm_function& function_;
+  std::vector<symbol_id> params_;
+  const expr* form_;
+  unsigned top_ = 0;
+
+  uint8_t allocate() {
+    if (top_ > 255) {
+      throw compile_error("expression needs too many registers");
+    }
+
+    function_.registers = std::max<uint16_t>(function_.registers, top_ + 1);
+    return top_++;
+  }
+
+  void emit(vm_instr instr) { function_.code.push_back(instr); }
+
+  uint16_t constant(vm_value value) {
+    if (function_.constants.size() > 0xffff) {
+      throw compile_error("too many constants");
+    }
+
+    function_.constants.push_back(std::move(value));
+    return function_.constants.size() - 1;
+  }
+
+  int param(const symbol_expr* symbol) const {
+    auto it = std::find(params_.begin(), params_.end(), symbol->get_id());
+    return it == params_.end() ? -1 : it - params_.begin();
+  }
+
+  // value of a form whose value is not defined (if without an else
+  // branch, debug), the same as an empty expr_value in the interpreter
+  void load_nothing(uint8_t dst) {
+    emit(vm_instr::abx(op_loadk, dst, constant(int64_t(0))));
+  }
+
+  // register holding the value of node, parameters are used in place
+  // and anything else is computed into a new register
+  uint8_t operand(const expr* node) {
+    if (auto symbol = expr_cast<symbol_expr>(node)) {
+      if (int index = param(symbol); index >= 0) {
+        return index;
+      }
+    }
+
+    uint8_t reg = allocate();
+    compile(node, reg);
+    return reg;
+  }
+
+  // a form in tail position is the last thing its function does, calls
+  // there reuse the frame instead of returning to it
+
+  void compile(const expr* node, uint8_t dst, bool tail = false);
+  void compile_list(const list_expr* list, uint8_t dst, bool tail);
+  void compile_assign(const list_expr* list, uint8_t dst, bool define);
+  void compile_debug(const list_expr* list, uint8_t dst);
+  void compile_fun(const list_expr* list, uint8_t dst);
+  void compile_if(const list_expr* list, uint8_t dst, bool tail);
+  void compile_while(const list_expr* list, uint8_t dst);
+  void compile_arith(const list_expr* list, uint8_t dst, vm_op op,
+                     int64_t identity, const char* name);
+  void compile_compare(const list_expr* list, uint8_t dst, vm_op op);
+  void compile_call(const list_expr* list, uint8_t dst, bool tail);
+
+  std::size_t jump_from_here(vm_op op, uint8_t a) {
+    emit(vm_instr::abx(op, a, 0));
+    return function_.code.size() - 1;
+  }
+
+  void patch_jump_here(std::size_t at) {
+    std::ptrdiff_t offset = function_.code.size() - (at + 1);
+
+    if (offset > 0x7fff) {
+      throw compile_error("branch too long");
+    }
+
+    function_.code[at] =
+        vm_instr::abx(function_.code[at].op, function_.code[at].a, offset);
+  }
+
+  void jump_back_to(std::size_t target) {
+    std::ptrdiff_t offset = target - (function_.code.size() + 1);
+
+    if (offset < -0x8000) {
+      throw compile_error("branch too long");
+    }
+
+    emit(vm_instr::abx(op_jump, 0, static_cast<uint16_t>(offset)));
+  }
+};
+
+void function_compiler::compile(const expr* node, uint8_t dst, bool tail) {
+  unsigned top = top_;
+
+  switch (node->kind()) {
+    case expr_kind::integer:
+      emit(vm_instr::abx(
+          op_loadk, dst,
+          constant(static_cast<const integer_expr*>(node)->get_value())));
+      break;
+    case expr_kind::floating:
+      emit(vm_instr::abx(
+          op_loadk, dst,
+          constant(static_cast<const float_expr*>(node)->get_value())));
+      break;
+    case expr_kind::boolean:
+      emit(vm_instr::abx(
+          op_loadk, dst,
+          constant(static_cast<const boolean_expr*>(node)->get_value())));
+      break;
+    case expr_kind::string:
+      emit(vm_instr::abx(
+          op_loadk, dst,
+          constant(std::string(
+              static_cast<const string_expr*>(node)->get_value()))));
+      break;
+    case expr_kind::symbol: {
+      auto symbol = static_cast<const symbol_expr*>(node);
+
+      if (int index = param(symbol); index >= 0) {
+        emit(vm_instr::abc(op_move, dst, index));
+      } else {
+        emit(vm_instr::abx(op_getglobal, dst,
+                           machine_.global_slot(symbol->get_id())));
+      }
+
+      break;
+    }
+    case expr_kind::list:
+      compile_list(static_cast<const list_expr*>(node), dst, tail);
+      break;
+    case expr_kind::local:
+    case expr_kind::global:
+    case expr_kind::call:
+      // the compiler binds names itself, it is fed trees from the parser
+      throw compile_error("unexpected resolved reference");
+  }
+
+  top_ = top;
+}
+
+void function_compiler::compile_list(const list_expr* list, uint8_t dst,
+                                     bool tail) {
+  auto head = list->get_exprs().empty()
+                  ? nullptr
+                  : expr_cast<symbol_expr>(list->get_exprs().front());
+
+  if (!head) {
+    throw compile_error("unknown expression type");
+  }
+
+  switch (head->get_id()) {
+    case symbol_def:
+      return compile_assign(list, dst, true);
+    case symbol_set:
+      return compile_assign(list, dst, false);
+    case symbol_debug:
+      return compile_debug(list, dst);
+    case symbol_fun:
+      if (list != form_) {
+        throw compile_error("'fun' cannot be used as an expression");
+      }
+
+      return compile_fun(list, dst);
+    case symbol_if:
+      return compile_if(list, dst, tail);
+    case symbol_while:
+      return compile_while(list, dst);
+    case symbol_add:
+      return compile_arith(list, dst, op_add, 0, "add");
+    case symbol_sub:
+      return compile_arith(list, dst, op_sub, 0, "sub");
+    case symbol_mul:
+      return compile_arith(list, dst, op_mul, 1, "mul");
+    case symbol_div:
+      return compile_arith(list, dst, op_div, 0, "div");
+    case symbol_lt:
+      return compile_compare(list, dst, op_lt);
+    case symbol_gt:
+      return compile_compare(list, dst, op_gt);
+    case symbol_le:
+      return compile_compare(list, dst, op_le);
+    case symbol_ge:
+      return compile_compare(list, dst, op_ge);
+    case symbol_eq:
+      return compile_compare(list, dst, op_eq);
+  }
+
+  compile_call(list, dst, tail);
+}
+
+// def always binds a global, set assigns to a parameter of the function
+// being compiled if it names one
+void function_compiler::compile_assign(const list_expr* list, uint8_t dst,
+                                       bool define) {
+  expr_span exprs = list->get_exprs();
+  auto symbol = exprs.size() == 3 ? expr_cast<symbol_expr>(exprs[1]) : nullptr;
+
+  if (!symbol) {
+    throw compile_error(std::string("'") + (define ? "def" : "set") +
+                        "' expression requires a name and a value");
+  }
+
+  compile(exprs[2], dst);
+
+  if (int index = param(symbol); !define && index >= 0) {
+    emit(vm_instr::abc(op_move, index, dst));
+  } else {
+    emit(vm_instr::abx(op_setglobal, dst,
+                       machine_.global_slot(symbol->get_id())));
+  }
+}
+
+void function_compiler::compile_debug(const list_expr* list, uint8_t dst) {
+  expr_span exprs = list->get_exprs();
+
+  for (std::size_t i = 1; i < exprs.size(); ++i) {
+    unsigned top = top_;
+    emit(vm_instr::abc(op_debug, operand(exprs[i])));
+    top_ = top;
+  }
+
+  load_nothing(dst);
+}
+
+void function_compiler::compile_fun(const list_expr* list, uint8_t dst) {
+  expr_span exprs = list->get_exprs();
+
+  if (exprs.size() < 4) {
+    throw compile_error(
+        "'fun' expression requires a name, parameters, and a body");
+  }
+
+  auto name = expr_cast<symbol_expr>(exprs[1]);
+  auto params = expr_cast<list_expr>(exprs[2]);
+  auto body = expr_cast<list_expr>(exprs[3]);
+
+  if (!name || !params || !body) {
+    throw compile_error("invalid 'fun' expression structure");
+  }
+
+  std::vector<symbol_id> param_ids;
+
+  for (const expr* param : params->get_exprs()) {
+    if (auto symbol = expr_cast<symbol_expr>(param)) {
+      param_ids.push_back(symbol->get_id());
+    } else {
+      throw compile_error("'fun' parameters must be symbols");
+    }
+  }
+
+  auto function = std::make_unique<vm_function>();
+  function->name = name->get_id();
+
+  function_compiler(machine_, *function, std::move(param_ids))
+      .compile_body(body->get_exprs().begin(), body->get_exprs().end());
+
+  const vm_function* defined = machine_.adopt(std::move(function));
+
+  emit(vm_instr::abx(op_loadk, dst, constant(defined)));
+  emit(vm_instr::abx(op_setfn, dst, machine_.function_slot(name->get_id())));
+}
+
+void function_compiler::compile_if(const list_expr* list, uint8_t dst,
+                                   bool tail) {
+  expr_span exprs = list->get_exprs();
+
+  if (exprs.size() < 3) {
+    throw compile_error(
+        "'if' expression requires at least a condition and a then clause");
+  }
+
+  std::size_t to_else = jump_from_here(op_jumpf, operand(exprs[1]));
+  compile(exprs[2], dst, tail);
+  std::size_t to_end = jump_from_here(op_jump, 0);
+  patch_jump_here(to_else);
+
+  if (exprs.size() > 3) {
+    compile(exprs[3], dst, tail);
+  } else {
+    load_nothing(dst);
+  }
+
+  patch_jump_here(to_end);
+}
+
+void function_compiler::compile_while(const list_expr* list, uint8_t dst) {
+  expr_span exprs = list->get_exprs();
+
+  if (exprs.size() < 2) {
+    throw compile_error("'while' expression requires a condition");
+  }
+
+  std::size_t start = function_.code.size();
+  std::size_t to_end = jump_from_here(op_loopf, operand(exprs[1]));
+
+  for (std::size_t i = 2; i < exprs.size(); ++i) {
+    compile(exprs[i], dst);
+  }
+
+  jump_back_to(start);
+  patch_jump_here(to_end);
+  load_nothing(dst);
+}
+
+// folds left like the interpreter's accumulators, a single operand is
+// only checked to be a number, no operands at all gives identity
+void function_compiler::compile_arith(const list_expr* list, uint8_t dst,
+                                      vm_op op, int64_t identity,
+                                      const char* name) {
+  expr_span exprs = list->get_exprs();
+
+  if (exprs.size() == 1) {
+    if (op == op_sub || op == op_div) {
+      throw compile_error(std::string("at least one operand required for ") +
+                          name);
+    }
+
+    emit(vm_instr::abx(op_loadk, dst, constant(identity)));
+    return;
+  }
+
+  if (exprs.size() == 2) {
+    emit(vm_instr::abc(op_tonumber, dst, operand(exprs[1])));
+    return;
+  }
+
+  uint8_t lhs = operand(exprs[1]);
+  uint8_t rhs = operand(exprs[2]);
+  emit(vm_instr::abc(op, dst, lhs, rhs));
+
+  for (std::size_t i = 3; i < exprs.size(); ++i) {
+    unsigned top = top_;
+    emit(vm_instr::abc(op, dst, dst, operand(exprs[i])));
+    top_ = top;
+  }
+}
+
+void function_compiler::compile_compare(const list_expr* list, uint8_t dst,
+                                        vm_op op) {
+  expr_span exprs = list->get_exprs();
+  auto head = static_cast<const symbol_expr*>(exprs[0]);
+
+  if (exprs.size() != 3) {
+    throw compile_error("'" + head->get_name() + "' requires two operands");
+  }
+
+  uint8_t lhs = operand(exprs[1]);
+  uint8_t rhs = operand(exprs[2]);
+  emit(vm_instr::abc(op, dst, lhs, rhs));
+}
+
+// the callee goes in a fresh register followed by the arguments, which
+// is where the vm expects them
+void function_compiler::compile_call(const list_expr* list, uint8_t dst,
+                                     bool tail) {
+  expr_span exprs = list->get_exprs();
+  auto name = static_cast<const symbol_expr*>(exprs[0]);
+
+  if (exprs.size() - 1 > 255) {
+    throw compile_error("too many arguments");
+  }
+
+  uint8_t base = allocate();
+  emit(vm_instr::abx(op_getfn, base, machine_.function_slot(name->get_id())));
+
+  for (std::size_t i = 1; i < exprs.size(); ++i) {
+    uint8_t arg = allocate();
+    unsigned top = top_;
+    compile(exprs[i], arg);
+    top_ = top;
+  }
+
+  if (tail) {
+    emit(vm_instr::abc(op_tailcall, base, exprs.size() - 1));
+    return;
+  }
+
+  emit(vm_instr::abc(op_call, base, exprs.size() - 1));
+
+  if (dst != base) {
+    emit(vm_instr::abc(op_move, dst, base));
+  }
+}
+
+}  // namespace
+
+std::unique_ptr<vm_function> compile(vm& machine, const expr* form) {
+  auto function = std::make_unique<vm_function>();
+  function_compiler(machine, *function, {}, form)
+      .compile_body(&form, &form + 1);
+  return function;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "parser.h"
+#include "vm.h"
+
+class compile_error : public std::runtime_error {
+ public:
+  explicit compile_error(const std::string& message)
+      : std::runtime_error(message) {}
+};
+
+// compiles a top-level form into a function taking no arguments that
+// returns the form's value. a function defined by the form (a fun, which
+// has to be the form itself) is compiled along with it and handed to the
+// vm, names are bound to the vm's global and function slots
+std::unique_ptr<vm_function> compile(vm& machine, const expr* form);
+
+#endif  // COMPILER_H
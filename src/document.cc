@@ -0,0 +1,155 @@
+#include "./document.h"
+
+#include <algorithm>
+
+document::document(std::string source) : source_(std::move(source)) {
+  lexer tokens(source_);
+  parser forms(tokens);
+
+  while (auto tree = forms.parse_next()) {
+    std::string_view text = forms.last_form();
+    std::size_t begin = text.data() - source_.data();
+    forms_.push_back({begin, begin + text.size(), std::move(tree)});
+  }
+
+  last_reparsed_ = forms_.size();
+}
+
+void document::edit(std::size_t offset, std::size_t length,
+                    std::string_view text) {
+  if (offset > source_.size()) {
+    throw std::out_of_range("edit offset past the end of the document");
+  }
+
+  length = std::min(length, source_.size() - offset);
+
+  std::size_t old_end = offset + length;
+  std::size_t new_end = offset + text.size();
+  std::ptrdiff_t delta = static_cast<std::ptrdiff_t>(text.size()) -
+                         static_cast<std::ptrdiff_t>(length);
+
+  // forms that touch the edited range (including ones that merely end or
+  // begin on its boundary, since their edge tokens may merge with the
+  // new text) are [first, last), anything before or after is untouched
+
+  auto first = std::partition_point(
+      forms_.begin(), forms_.end(),
+      [&](const document_form& form) { return form.end < offset; });
+  auto last = std::partition_point(
+      first, forms_.end(),
+      [&](const document_form& form) { return form.begin <= old_end; });
+
+  // when no form touches the edit it lies in whitespace between forms
+  std::size_t restart = first != last ? std::min(first->begin, offset) : offset;
+
+  std::string removed = source_.substr(offset, length);
+  source_.replace(offset, length, text);
+
+  std::vector<document_form> fresh;
+  auto resume = last;
+
+  try {
+    lexer tokens(std::string_view(source_).substr(restart));
+    parser forms(tokens);
+
+    for (;;) {
+      const char* next = forms.lookahead();
+
+      if (!next) {
+        resume = forms_.end();
+        break;
+      }
+
+      // past the edit, lexing from a token boundary at top level yields
+      // exactly the old tokens again, so once the next token starts
+      // where an old form starts the remaining forms can be reused
+
+      std::size_t at = next - source_.data();
+
+      if (at >= new_end) {
+        while (resume != forms_.end() &&
+               static_cast<std::ptrdiff_t>(resume->begin) + delta <
+                   static_cast<std::ptrdiff_t>(at)) {
+          ++resume;  // swallowed by a re-parsed form
+        }
+
+        if (resume != forms_.end() &&
+            static_cast<std::ptrdiff_t>(resume->begin) + delta ==
+                static_cast<std::ptrdiff_t>(at)) {
+          break;
+        }
+      }
+
+      auto tree = forms.parse_next();
+      std::string_view form_text = forms.last_form();
+      std::size_t begin = form_text.data() - source_.data();
+      fresh.push_back({begin, begin + form_text.size(), std::move(tree)});
+    }
+  } catch (...) {
+    source_.replace(offset, text.size(), removed);
+    throw;
+  }
+
+  for (auto it = resume; it != forms_.end(); ++it) {
+    it->begin += delta;
+    it->end += delta;
+  }
+
+  last_reparsed_ = fresh.size();
+
+  std::vector<document_form> forms;
+  forms.reserve((first - forms_.begin()) + fresh.size() +
+                (forms_.end() - resume));
+  std::move(forms_.begin(), first, std::back_inserter(forms));
+  std::move(fresh.begin(), fresh.end(), std::back_inserter(forms));
+  std::move(resume, forms_.end(), std::back_inserter(forms));
+  forms_ = std::move(forms);
+}
+
+void document::reload(std::string_view source) {
+  std::string_view current = source_;
+  std::size_t limit = std::min(current.size(), source.size());
+  std::size_t prefix = 0;
+
+  while (prefix < limit && current[prefix] == source[prefix]) {
+    ++prefix;
+  }
+
+  std::size_t suffix = 0;
+
+  while (suffix < limit - prefix &&
+         current[current.size() - 1 - suffix] ==
+             source[source.size() - 1 - suffix]) {
+    ++suffix;
+  }
+
+  if (prefix == current.size() && prefix == source.size()) {
+    last_reparsed_ = 0;
+    return;
+  }
+
+  edit(prefix, current.size() - prefix - suffix,
+       source.substr(prefix, source.size() - prefix - suffix));
+}
+
+// the program tree only holds the list of forms in its own arena, the
+// forms themselves stay in (and keep alive) their per-form trees
+
+std::shared_ptr<ast> document::tree() const {
+  auto tree = std::make_shared<ast>(256);
+  std::vector<const expr*> children;
+
+  children.reserve(forms_.size());
+  tree->depends_on.reserve(forms_.size());
+
+  for (const auto& form : forms_) {
+    children.push_back(form.tree->root);
+    tree->depends_on.push_back(form.tree);
+  }
+
+  const expr* const* span =
+      tree->arena.copy_array(children.data(), children.size());
+  tree->root = tree->arena.make<list_expr>(expr_span(span, children.size()));
+
+  return tree;
+}
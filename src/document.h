@@ -0,0 +1,50 @@
+#pragma once
+
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.h"
+
+// an editable source that keeps its top-level forms parsed, for hosts
+// that reload scripts as they change. an edit re-lexes and re-parses
+// only the forms touching the edited byte range (and any the new text
+// swallows, e.g. after deleting a paren) and reuses every other form's
+// tree as-is, so small edits to large files cost about the edit size
+
+struct document_form {
+  std::size_t begin;
+  std::size_t end;
+  std::shared_ptr<ast> tree;
+};
+
+class document {
+ public:
+  explicit document(std::string source);
+
+  // replaces [offset, offset + length) with text, on a parse error the
+  // document is left unchanged and the error is rethrown
+  void edit(std::size_t offset, std::size_t length, std::string_view text);
+
+  // diffs source against the current text and applies it as one edit
+  void reload(std::string_view source);
+
+  const std::string& source() const { return source_; }
+  const std::vector<document_form>& forms() const { return forms_; }
+  std::shared_ptr<ast> tree() const;
+
+  // number of forms parsed by the last edit, the rest were reused
+  std::size_t last_reparsed() const { return last_reparsed_; }
+
+ private:
+  std::string source_;
+  std::vector<document_form> forms_;
+  std::size_t last_reparsed_ = 0;
+};
+
+#endif  // DOCUMENT_H
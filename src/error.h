@@ -0,0 +1,20 @@
+#pragma once
+
+#ifndef ERROR_H
+#define ERROR_H
+
+#include <stdexcept>
+#include <string>
+
+// an error running a program, on either engine: an operand of the wrong
+// type, an int overflow, a call to a function that isn't defined, .. it
+// unwinds to whatever runs the program, which for the command line
+// means reporting it and exiting, and for an isolate ending the script
+// it is in (see isolate.h)
+class eval_error : public std::runtime_error {
+ public:
+  explicit eval_error(const std::string& message)
+      : std::runtime_error(message) {}
+};
+
+#endif  // ERROR_H
@@ -0,0 +1,302 @@
+#include "./gc.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "./arrays.h"
+#include "./persistent.h"
+
+namespace {
+
+// nesting deeper than this is written as ..., which also keeps a vector
+// holding itself from being written forever
+constexpr int max_write_depth = 32;
+
+void write_element(std::ostream& out, const expr_value& value, int depth);
+
+void write_object(std::ostream& out, const expr_value& value, int depth) {
+  if (depth > max_write_depth) {
+    out << "...";
+    return;
+  }
+
+  if (auto vector = dynamic_cast<const gc_vector*>(value.as_object())) {
+    out << '[';
+
+    for (std::size_t i = 0; i < vector->length(); ++i) {
+      out << (i ? " " : "");
+      write_element(out, (*vector)[i], depth + 1);
+    }
+
+    out << ']';
+    return;
+  }
+
+  if (auto vector = dynamic_cast<const gc_pvec*>(value.as_object())) {
+    out << '[';
+
+    for (std::size_t i = 0; i < vector->count(); ++i) {
+      out << (i ? " " : "");
+      write_element(out, (*vector)[i], depth + 1);
+    }
+
+    out << ']';
+    return;
+  }
+
+  if (auto array = dynamic_cast<const gc_array*>(value.as_object())) {
+    out << '[';
+
+    for (std::size_t i = 0; i < array->length(); ++i) {
+      out << (i ? " " : "");
+      write_element(out, (*array)[i], depth + 1);
+    }
+
+    out << ']';
+    return;
+  }
+
+  if (auto map = dynamic_cast<const gc_map*>(value.as_object())) {
+    bool first = true;
+    out << '{';
+
+    map->for_each([&](const expr_value& key, const expr_value& item) {
+      out << (first ? "" : ", ");
+      write_element(out, key, depth + 1);
+      out << ' ';
+      write_element(out, item, depth + 1);
+      first = false;
+    });
+
+    out << '}';
+    return;
+  }
+
+  out << '(';
+  expr_value rest = value;
+
+  for (bool first = true; rest.is_object(); first = false) {
+    auto pair = dynamic_cast<const gc_pair*>(rest.as_object());
+
+    if (!pair) {
+      break;
+    }
+
+    out << (first ? "" : " ");
+    write_element(out, pair->head, depth + 1);
+    rest = pair->tail;
+  }
+
+  out << ')';
+}
+
+void write_element(std::ostream& out, const expr_value& value, int depth) {
+  if (value.is_int()) {
+    out << value.as_int();
+  } else if (value.is_float()) {
+    out << value.as_float();
+  } else if (value.is_bool()) {
+    out << (value.as_bool() ? "true" : "false");
+  } else if (value.is_string()) {
+    out << '"' << value.as_string() << '"';
+  } else if (value.is_empty_list()) {
+    out << "()";
+  } else if (value.is_object()) {
+    write_object(out, value, depth);
+  } else {
+    out << "<fun>";
+  }
+}
+
+}  // namespace
+
+void gc_pair::trace(gc_heap& heap) const {
+  heap.mark(head);
+  heap.mark(tail);
+}
+
+void gc_vector::trace(gc_heap& heap) const {
+  for (const expr_value& item : items_) {
+    heap.mark(item);
+  }
+}
+
+gc_heap::~gc_heap() {
+  for (gc_object* list : {young_, old_}) {
+    while (list) {
+      gc_object* next = list->next_;
+      delete list;
+      list = next;
+    }
+  }
+}
+
+void gc_heap::allocated(std::size_t bytes) {
+  young_bytes_ += bytes;
+  stats_.allocated_bytes += bytes;
+  stats_.heap_bytes += bytes;
+}
+
+// the write barrier: an old vector now pointing to a young object is a
+// root for minor collections until the object is promoted
+void gc_heap::remember(gc_vector* vector, const expr_value& value) {
+  if (vector->old_ && !vector->remembered_ && value.is_object() &&
+      !value.as_object()->old_) {
+    vector->remembered_ = true;
+    remembered_.push_back(vector);
+  }
+}
+
+void gc_heap::store(gc_vector* vector, std::size_t i, expr_value value) {
+  remember(vector, value);
+  vector->items_[i] = std::move(value);
+}
+
+void gc_heap::append(gc_vector* vector, expr_value value) {
+  remember(vector, value);
+  std::size_t before = vector->size();
+  vector->items_.push_back(std::move(value));
+
+  if (vector->size() > before) {
+    allocated(vector->size() - before);
+    old_bytes_ += vector->old_ ? vector->size() - before : 0;
+  }
+}
+
+void gc_heap::mark(const expr_value& value) {
+  if (!value.is_object()) {
+    return;
+  }
+
+  gc_object* object = value.as_object();
+
+  if (object->marked_ || (object->old_ && !full_)) {
+    return;
+  }
+
+  object->marked_ = true;
+  gray_.push_back(object);
+}
+
+void gc_heap::collect(const std::vector<expr_value>& globals,
+                      const std::vector<expr_value>& stack, std::size_t top,
+                      bool full) {
+  auto start = std::chrono::steady_clock::now();
+  full_ = full || old_bytes_ >= std::max(old_limit_, min_old_limit);
+
+  for (const expr_value& value : globals) {
+    mark(value);
+  }
+
+  for (std::size_t i = 0; i < top; ++i) {
+    mark(stack[i]);
+  }
+
+  if (!full_) {
+    for (gc_object* object : remembered_) {
+      object->trace(*this);
+    }
+  }
+
+  while (!gray_.empty()) {
+    gc_object* object = gray_.back();
+    gray_.pop_back();
+    object->trace(*this);
+  }
+
+  // every young survivor is promoted, so nothing old points to a young
+  // object any more. cleared before sweeping, which may free them
+  for (gc_object* object : remembered_) {
+    object->remembered_ = false;
+  }
+
+  remembered_.clear();
+
+  // the old generation first, young survivors are moved into it unmarked
+  if (full_) {
+    old_bytes_ = sweep(old_, false);
+  }
+
+  old_bytes_ += sweep(young_, true);
+  young_bytes_ = 0;
+
+  if (full_) {
+    old_limit_ = std::max(min_old_limit, 2 * old_bytes_);
+    ++stats_.major_collections;
+  } else {
+    ++stats_.minor_collections;
+  }
+
+  std::chrono::duration<double> pause =
+      std::chrono::steady_clock::now() - start;
+  stats_.heap_bytes = old_bytes_;
+  stats_.last_pause = pause.count();
+  stats_.max_pause = std::max(stats_.max_pause, pause.count());
+  stats_.total_pause += pause.count();
+}
+
+// frees the unmarked objects of list and unmarks the others, returns
+// the bytes of those. survivors are moved to the old generation when
+// promote is set
+std::size_t gc_heap::sweep(gc_object*& list, bool promote) {
+  std::size_t survived = 0;
+  gc_object** link = &list;
+
+  while (gc_object* object = *link) {
+    if (!object->marked_) {
+      *link = object->next_;
+      delete object;
+      ++stats_.freed_objects;
+      --stats_.objects;
+      continue;
+    }
+
+    object->marked_ = false;
+    survived += object->size();
+
+    if (promote) {
+      *link = object->next_;
+      object->old_ = true;
+      object->next_ = old_;
+      old_ = object;
+    } else {
+      link = &object->next_;
+    }
+  }
+
+  return survived;
+}
+
+void write_object(std::ostream& out, const expr_value& value) {
+  if (value.is_empty_list()) {
+    out << "()";
+  } else {
+    write_object(out, value, 0);
+  }
+}
+
+const char* object_type(const expr_value& value) {
+  if (value.is_empty_list()) {
+    return "list";
+  }
+
+  const gc_object* object = value.as_object();
+
+  if (dynamic_cast<const gc_vector*>(object)) {
+    return "vector";
+  }
+
+  if (dynamic_cast<const gc_pvec*>(object)) {
+    return "pvec";
+  }
+
+  if (dynamic_cast<const gc_map*>(object)) {
+    return "map";
+  }
+
+  if (dynamic_cast<const gc_array*>(object)) {
+    return "array";
+  }
+
+  return "list";
+}
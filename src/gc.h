@@ -0,0 +1,167 @@
+#pragma once
+
+#ifndef GC_H
+#define GC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "value.h"
+
+// the garbage collected heap of an eval_context, holding pairs (the
+// cells of lists) and vectors. values point to these objects without
+// counting references, the objects are found by tracing instead, so
+// lists and vectors can share structure and form cycles.
+//
+// the collector is precise, generational and non-moving. new objects are
+// young, a minor collection marks the young objects reachable from the
+// roots (the globals and the live part of the value stack) and frees the
+// rest, the survivors become old. old objects are only traced by a
+// major collection, which marks from the roots through everything. the
+// only way an old object can come to point to a young one is storing
+// into a vector, which goes through the heap so it can remember the
+// vector and trace it on the next minor collection.
+//
+// collections only happen at safepoints of the interpreter (entering a
+// function body, a loop iteration or a top-level form), where every live
+// value is reachable from the roots. allocating never collects, so a
+// value can be held in a local across allocations as long as no code
+// that may reach a safepoint runs in between. values must not outlive
+// the context whose heap their objects are in
+
+class gc_heap;
+
+class gc_object {
+ public:
+  virtual ~gc_object() = default;
+
+  // marks every value the object holds (see gc_heap::mark)
+  virtual void trace(gc_heap& heap) const = 0;
+
+  // bytes owned, for the heap size
+  virtual std::size_t size() const = 0;
+
+ private:
+  friend class gc_heap;
+
+  gc_object* next_ = nullptr;  // in the list of its generation
+  bool marked_ = false;
+  bool old_ = false;
+  bool remembered_ = false;
+};
+
+class gc_pair final : public gc_object {
+ public:
+  gc_pair(expr_value head, expr_value tail)
+      : head(std::move(head)), tail(std::move(tail)) {}
+
+  void trace(gc_heap& heap) const override;
+  std::size_t size() const override { return sizeof(*this); }
+
+  const expr_value head;
+  const expr_value tail;  // the rest of the list, a pair or empty
+};
+
+class gc_vector final : public gc_object {
+ public:
+  explicit gc_vector(std::vector<expr_value> items)
+      : items_(std::move(items)) {}
+
+  void trace(gc_heap& heap) const override;
+  std::size_t size() const override {
+    return sizeof(*this) + items_.capacity() * sizeof(expr_value);
+  }
+
+  std::size_t length() const { return items_.size(); }
+  const expr_value& operator[](std::size_t i) const { return items_[i]; }
+
+ private:
+  friend class gc_heap;  // stores go through the heap's write barrier
+
+  std::vector<expr_value> items_;
+};
+
+// what the collector has done, pauses are in seconds
+struct gc_stats {
+  uint64_t minor_collections = 0;
+  uint64_t major_collections = 0;
+  double last_pause = 0;
+  double max_pause = 0;
+  double total_pause = 0;
+  uint64_t allocated_bytes = 0;  // ever
+  uint64_t freed_objects = 0;    // ever
+  std::size_t heap_bytes = 0;    // in objects not freed yet
+  std::size_t objects = 0;       // not freed yet
+};
+
+class gc_heap {
+ public:
+  gc_heap() = default;
+  gc_heap(const gc_heap&) = delete;
+  gc_heap& operator=(const gc_heap&) = delete;
+  ~gc_heap();  // frees every object
+
+  // bytes allocated (by new objects and growing vectors) between minor
+  // collections, and the smallest size the old generation may grow to
+  // before a minor collection becomes a major one. the limit after a
+  // major collection is twice what survived it
+  std::size_t young_limit = std::size_t(1) << 20;
+  std::size_t min_old_limit = std::size_t(8) << 20;
+
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    T* object = new T(std::forward<Args>(args)...);
+    object->next_ = young_;
+    young_ = object;
+    allocated(object->size());
+    ++stats_.objects;
+    return object;
+  }
+
+  void store(gc_vector* vector, std::size_t i, expr_value value);
+  void append(gc_vector* vector, expr_value value);
+
+  // checked at safepoints
+  bool wants_collection() const { return young_bytes_ >= young_limit; }
+
+  // a minor collection unless full (or the old generation is over its
+  // limit). roots are the values in globals and in stack below top
+  void collect(const std::vector<expr_value>& globals,
+               const std::vector<expr_value>& stack, std::size_t top,
+               bool full);
+
+  // for gc_object::trace
+  void mark(const expr_value& value);
+
+  const gc_stats& stats() const { return stats_; }
+
+ private:
+  gc_object* young_ = nullptr;
+  gc_object* old_ = nullptr;
+  std::size_t young_bytes_ = 0;
+  std::size_t old_bytes_ = 0;
+  std::size_t old_limit_ = 0;  // min_old_limit until the first major
+
+  std::vector<gc_object*> remembered_;  // old vectors stored into
+  std::vector<gc_object*> gray_;        // marked, not traced yet
+  bool full_ = false;                   // the collection running is major
+
+  gc_stats stats_;
+
+  void allocated(std::size_t bytes);
+  void remember(gc_vector* vector, const expr_value& value);
+  std::size_t sweep(gc_object*& list, bool promote);
+};
+
+// writes a list as (a b c), a vector (persistent or not) or an array
+// as [a b c] and a map as {k v, k v}, with their elements as written by debug (strings
+// quoted)
+void write_object(std::ostream& out, const expr_value& value);
+
+// list, vector, pvec, map or array, for an object or the empty list
+const char* object_type(const expr_value& value);
+
+#endif  // GC_H
@@ -1,382 +1,801 @@
 #include "interp.h"
 
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <optional>
 
-expr_value get_value_from_expr(eval_context& ctx,
-                               const std::shared_ptr<expr>& node) {
-  if (auto int_node = std::dynamic_pointer_cast<integer_expr>(node)) {
-    return int_node->get_value();
-  } else if (auto float_node = std::dynamic_pointer_cast<float_expr>(node)) {
-    return float_node->get_value();
-  } else if (auto bool_node = std::dynamic_pointer_cast<boolean_expr>(node)) {
-    return bool_node->get_value();
-  } else if (auto str_node = std::dynamic_pointer_cast<string_expr>(node)) {
-    return str_node->get_value();
-  } else if (auto symbol_node = std::dynamic_pointer_cast<symbol_expr>(node)) {
-    const std::string& name = symbol_node->get_name();
-
-    if (ctx.vmap.find(name) != ctx.vmap.end()) {
-      return std::move(ctx.vmap.at(name));
+#include "./arith.h"
+#include "./arrays.h"
+#include "./error.h"
+#include "./gc.h"
+#include "./jit.h"
+#include "./lists.h"
+#include "./parallel.h"
+#include "./persistent.h"
+
+namespace {
+
+// body entries before a closure is compiled to native code
+constexpr uint32_t hot_entries = 1000;
+
+void push(eval_context& ctx, expr_value value) {
+  if (ctx.stack_top == ctx.stack.size()) {
+    ctx.stack.resize(2 * ctx.stack.size());
+  }
+
+  ctx.stack[ctx.stack_top++] = std::move(value);
+}
+
+template <typename T>
+bool compare(symbol_id op, T a, T b) {
+  switch (op) {
+    case symbol_lt:
+      return a < b;
+    case symbol_gt:
+      return a > b;
+    case symbol_le:
+      return a <= b;
+    case symbol_ge:
+      return a >= b;
+    default:
+      return a == b;
+  }
+}
+
+// collects garbage if enough was allocated since the last collection.
+// called where nothing but the roots holds on to values (see gc.h)
+void safepoint(eval_context& ctx) {
+  if (ctx.heap.wants_collection()) {
+    ctx.heap.collect(ctx.globals, ctx.stack, ctx.stack_top, false);
+  }
+}
+
+// the head of a list form, if it's a symbol
+const symbol_expr* head_of(const expr* node) {
+  auto list = expr_cast<list_expr>(node);
+
+  if (!list || list->get_exprs().empty()) {
+    return nullptr;
+  }
+
+  return expr_cast<symbol_expr>(list->get_exprs().front());
+}
+
+bool condition(eval_context& ctx, const expr* node, const char* form) {
+  auto value = get_value_from_expr(ctx, node);
+
+  if (!value.is_bool()) {
+    throw eval_error(std::string("'") + form +
+                     "' condition must evaluate to a boolean");
+  }
+
+  return value.as_bool();
+}
+
+// the branch of an if form to evaluate, nullptr when the condition is
+// false and there is no else branch
+const expr* select_branch(eval_context& ctx, const list_expr* list) {
+  if (list->get_exprs().size() < 3) {
+    throw eval_error(
+        "'if' expression requires at least a condition and a then clause");
+  }
+
+  if (condition(ctx, list->get_exprs()[1], "if")) {
+    return list->get_exprs()[2];
+  }
+
+  return list->get_exprs().size() > 3 ? list->get_exprs()[3] : nullptr;
+}
+
+// the function a call site goes to. the cache in the node is only used
+// while no definition has replaced a function since it was filled, so a
+// hot call is one compare
+callable* callee(eval_context& ctx, const call_expr* call) {
+  if (ctx.cache_calls && call->cached_epoch == ctx.epoch) {
+    ++ctx.call_hits;
+    return call->cached;
+  }
+
+  ++ctx.call_misses;
+  auto it = ctx.fmap.find(call->get_id());
+
+  if (it == ctx.fmap.end()) {
+    throw eval_error("function '" + call->get_name() + "' not found");
+  }
+
+  if (!it->second.is_callable()) {
+    throw eval_error("'" + call->get_name() + "' is not a callable function");
+  }
+
+  if (!ctx.cache_calls) {
+    return it->second.as_callable();
+  }
+
+  call->cached = it->second.as_callable();
+  call->cached_epoch = ctx.epoch;
+  return call->cached;
+}
+
+// a function defined with fun. owner keeps the tree (and so the arena
+// holding body) alive for as long as the function is defined
+class closure final : public callable {
+ public:
+  closure(symbol_id name, std::size_t arity, const list_expr* body,
+          std::shared_ptr<const ast> owner)
+      : name_(name), arity_(arity), body_(body), owner_(std::move(owner)) {}
+
+  expr_value operator()(eval_context& ctx, std::size_t argc) override;
+
+  // the same function, for another context
+  closure* clone() const { return new closure(name_, arity_, body_, owner_); }
+
+  const list_expr* body() const { return body_; }
+
+ private:
+  symbol_id name_;
+  std::size_t arity_;
+  const list_expr* body_;
+  std::shared_ptr<const ast> owner_;
+
+  // native code for the body (see jit.h), compiled once it has been
+  // entered hot_entries times. misses are entries with arguments of
+  // other kinds than it was compiled for, after as many of those it is
+  // compiled again for the new kinds. a body that can't be compiled, or
+  // whose code keeps bailing out, stays interpreted
+  std::unique_ptr<jit_function> native_;
+  uint32_t entries_ = 0;
+  uint32_t misses_ = 0;
+  uint32_t bails_ = 0;
+  bool interpreted_ = false;
+  uint64_t native_epoch_ = 0;  // when name_ was last seen naming this
+
+  bool run_native(eval_context& ctx, expr_value& result);
+
+  void check_arity(std::size_t argc) const {
+    if (argc != arity_) {
+      throw eval_error("argument count does not match parameter count");
+    }
+  }
+};
+
+// the kinds of the arguments in the running frame as jit_function takes
+// them, nothing unless they are all numbers
+std::optional<uint32_t> float_params(const eval_context& ctx,
+                                     std::size_t arity) {
+  uint32_t floats = 0;
+
+  for (std::size_t i = 0; i < arity; ++i) {
+    const expr_value& arg = ctx.stack[ctx.frame + i];
+
+    if (!arg.is_number()) {
+      return std::nullopt;
+    }
+
+    floats |= uint32_t(arg.is_float()) << i;
+  }
+
+  return floats;
+}
+
+// runs the native code for the arguments in the running frame, false
+// when there is none for them (yet) or it bailed out, in which case the
+// interpreter runs the body
+bool closure::run_native(eval_context& ctx, expr_value& result) {
+  if (!ctx.jit || interpreted_) {
+    return false;
+  }
+
+  if (!native_ && ++entries_ < hot_entries) {
+    return false;
+  }
+
+  auto kinds = float_params(ctx, arity_);
+
+  if (!kinds) {
+    return false;
+  }
+
+  if (native_ && native_->float_params() != *kinds) {
+    if (++misses_ < hot_entries) {
+      return false;
+    }
+
+    native_.reset();
+  }
+
+  if (!native_) {
+    native_ = jit_function::compile(name_, arity_, body_, *kinds);
+    misses_ = 0;
+
+    if (!native_) {
+      interpreted_ = true;
+      return false;
+    }
+
+    ++ctx.jit_compiled;
+  }
+
+  // self calls in the native code go to itself, which is only right
+  // while name_ still names this function
+  if (native_epoch_ != ctx.epoch) {
+    auto it = ctx.fmap.find(name_);
+
+    if (it == ctx.fmap.end() || !it->second.is_callable() ||
+        it->second.as_callable() != this) {
+      return false;
+    }
+
+    native_epoch_ = ctx.epoch;
+  }
+
+  uint64_t args[jit_function::max_params];
+
+  for (std::size_t i = 0; i < arity_; ++i) {
+    const expr_value& arg = ctx.stack[ctx.frame + i];
+
+    if (arg.is_float()) {
+      double d = arg.as_float();
+      std::memcpy(&args[i], &d, sizeof(d));
     } else {
-      std::cerr << "error: identifier '" << name << "' not found" << std::endl;
-      exit(1);
+      args[i] = static_cast<uint64_t>(arg.as_int());
     }
-  } else if (auto list_node = std::dynamic_pointer_cast<list_expr>(node)) {
-    auto fst_expr = list_node->get_exprs().front();
-    auto symbol = std::dynamic_pointer_cast<symbol_expr>(fst_expr);
+  }
 
-    if (symbol) {
-      const std::string& name = symbol->get_name();
+  uint64_t out;
 
-      if (name == "+") {
-        return eval_add(ctx, list_node);
-      } else if (name == "-") {
-        return eval_sub(ctx, list_node);
-      } else if (name == "*") {
-        return eval_mul(ctx, list_node);
-      } else if (name == "/") {
-        return eval_div(ctx, list_node);
-      } else if (name == "if") {
-        return eval_if(ctx, list_node);
-      } else if (ctx.fmap.find(name) != ctx.fmap.end()) {
-        std::vector<expr_value> args;
-
-        for (size_t i = 1; i < list_node->get_exprs().size(); ++i) {
-          args.push_back(get_value_from_expr(ctx, list_node->get_exprs()[i]));
-        }
-
-        auto& func_value = ctx.fmap.at(name);
-
-        if (auto* func_ptr =
-                std::get_if<std::unique_ptr<callable>>(&func_value)) {
-          if (func_ptr && *func_ptr) {
-            return (**func_ptr)(ctx, std::move(args));
-          } else {
-            std::cerr << "error: callable function is null" << std::endl;
-            exit(1);
-          }
-        } else {
-          std::cerr << "error: '" << name << "' is not a callable function"
-                    << std::endl;
-          exit(1);
-        }
-      } else {
-        std::cerr << "internal error: function '" << name
-                  << "' not found in fmap" << std::endl;
-        exit(1);
-      }
+  if (!native_->run(args, &out)) {
+    ++ctx.jit_bails;
+
+    if (++bails_ >= hot_entries) {
+      native_.reset();
+      interpreted_ = true;
     }
+
+    return false;
   }
 
-  std::cerr << "error: unknown expression type" << std::endl;
-  exit(1);
+  ++ctx.jit_runs;
+
+  if (native_->returns_float()) {
+    double d;
+    std::memcpy(&d, &out, sizeof(d));
+    result = d;
+  } else {
+    result = static_cast<int64_t>(out);
+  }
+
+  return true;
 }
 
-void interp::eval(eval_context& ctx, const std::shared_ptr<expr>& node) {
-  if (auto outer_lst = std::dynamic_pointer_cast<list_expr>(node)) {
-    // we need this check to ensure that adjacent
-    // nodes are not in conflict with nested nodes
-    for (auto&& inner_lst : outer_lst->get_exprs()) {
-      eval(ctx, inner_lst);
-      skip_initial_lst = false;
+// the function a form in tail position calls, nothing if it is not a
+// call. looked up once: a callee that isn't a closure is called with it
+// (see eval_call) rather than by evaluating the form again
+callable* tail_callee(eval_context& ctx, const expr* node) {
+  auto call = expr_cast<call_expr>(node);
+  return call ? callee(ctx, call) : nullptr;
+}
+
+// parameters are resolved to their position, so the arguments on the
+// stack are the callee's locals. a tail call evaluates its arguments
+// above them as usual, then moves them down over the frame and carries
+// on with the callee's body in the same loop
+expr_value closure::operator()(eval_context& ctx, std::size_t argc) {
+  check_arity(argc);
+
+  std::size_t caller_frame = ctx.frame;
+  ctx.frame = ctx.stack_top - argc;
+
+  closure* running = this;
+  expr_value callee;  // keeps running alive after a tail call to it
+  expr_value result;
+
+  while (!running->body_->get_exprs().empty()) {
+    safepoint(ctx);
+
+    if (running->run_native(ctx, result)) {
+      break;
     }
 
-    skip_initial_lst = true;
-
-    if (skip_initial_lst) {
-      auto fst_expr = outer_lst->get_exprs().front();
-      auto symbol = std::dynamic_pointer_cast<symbol_expr>(fst_expr);
-
-      if (symbol) {
-        const std::string& name = symbol->get_name();
-
-        if (name == "def") {
-          eval_def(ctx, outer_lst);
-        } else if (name == "debug") {
-          eval_debug(ctx, outer_lst);
-        } else if (name == "set") {
-          eval_set(ctx, outer_lst);
-        } else if (name == "fun") {
-          eval_fun(ctx, outer_lst);
-        } else if (name == "if") {
-          eval_if(ctx, outer_lst);
-        }
-      }
+    expr_span body = running->body_->get_exprs();
+
+    for (std::size_t i = 0; i + 1 < body.size(); ++i) {
+      get_value_from_expr(ctx, body[i]);
+    }
+
+    const expr* tail = body[body.size() - 1];
+
+    while (tail && head_of(tail) && head_of(tail)->get_id() == symbol_if) {
+      tail = select_branch(ctx, static_cast<const list_expr*>(tail));
+    }
+
+    if (!tail) {
+      break;
+    }
+
+    callable* function = tail_callee(ctx, tail);
+
+    // only a closure can carry on in this frame
+    if (!dynamic_cast<closure*>(function)) {
+      result = function ? eval_call(ctx, static_cast<const call_expr*>(tail),
+                                    function)
+                        : get_value_from_expr(ctx, tail);
+      break;
+    }
+
+    callee = function;
+
+    expr_span args = static_cast<const call_expr*>(tail)->get_args();
+
+    for (const expr* arg : args) {
+      push(ctx, get_value_from_expr(ctx, arg));
     }
+
+    running = static_cast<closure*>(callee.as_callable());
+    running->check_arity(args.size());
+
+    std::move(ctx.stack.begin() + (ctx.stack_top - args.size()),
+              ctx.stack.begin() + ctx.stack_top,
+              ctx.stack.begin() + ctx.frame);
+    ctx.stack_top = ctx.frame + args.size();
   }
+
+  ctx.frame = caller_frame;
+  return result;
 }
 
-// @todo: prevent redefinition & mutable-by-default
-void interp::eval_def(eval_context& ctx,
-                      const std::shared_ptr<list_expr>& lst) {
-  auto symbol = std::dynamic_pointer_cast<symbol_expr>(lst->get_exprs()[1]);
-  auto value_expr = get_value_from_expr(ctx, lst->get_exprs()[2]);
+// an operand of op, which has to be a number
+const expr_value& number(const expr_value& value, const char* op) {
+  if (!value.is_number()) {
+    throw eval_error(std::string("invalid type for ") + op);
+  }
 
-  if (symbol) {
-    ctx.vmap[symbol->get_name()] = std::move(value_expr);
+  return value;
+}
+
+template <typename Op>
+double fold_floats(eval_context& ctx, expr_span exprs, std::size_t first,
+                   double acc) {
+  for (std::size_t i = first; i < exprs.size(); ++i) {
+    auto operand = get_value_from_expr(ctx, exprs[i]);
+    acc = Op::floats(acc, number(operand, Op::name).as_number());
   }
+
+  return acc;
 }
 
-void interp::eval_set(eval_context& ctx,
-                      const std::shared_ptr<list_expr>& lst) {
-  auto symbol = std::dynamic_pointer_cast<symbol_expr>(lst->get_exprs()[1]);
-  auto value_expr = get_value_from_expr(ctx, lst->get_exprs()[2]);
+// folds the operands from first on into acc. the fold stays in int64
+// while every operand is an int and moves over to double for the rest
+// from the first float operand (or inexact quotient) on
+template <typename Op>
+expr_value fold(eval_context& ctx, const list_expr* list, std::size_t first,
+                const expr_value& acc) {
+  expr_span exprs = list->get_exprs();
 
-  if (symbol) {
-    vmap[symbol->get_name()] = std::move(value_expr);
+  if (acc.is_float()) {
+    return fold_floats<Op>(ctx, exprs, first, acc.as_float());
+  }
+
+  int64_t n = acc.as_int();
+
+  for (std::size_t i = first; i < exprs.size(); ++i) {
+    auto operand = get_value_from_expr(ctx, exprs[i]);
+
+    if (!operand.is_int()) {
+      double d = Op::floats(n, number(operand, Op::name).as_float());
+      return fold_floats<Op>(ctx, exprs, i + 1, d);
+    }
+
+    switch (Op::ints(n, operand.as_int(), &n)) {
+      case int_step::ok:
+        break;
+      case int_step::overflow:
+        throw eval_error(std::string("integer overflow in ") + Op::name);
+      case int_step::inexact:
+        return fold_floats<Op>(
+            ctx, exprs, i + 1,
+            Op::floats(n, static_cast<double>(operand.as_int())));
+    }
   }
+
+  return n;
 }
 
-void interp::eval_debug(eval_context& ctx,
-                        const std::shared_ptr<list_expr>& list) {
-  for (size_t i = 1; i < list->get_exprs().size(); ++i) {
-    auto value = get_value_from_expr(ctx, list->get_exprs()[i]);
+// the name def and set assign to, resolved to a slot (see resolver.h).
+// the resolver rejects anything else, which is checked again here for
+// trees that did not come through it
+const expr* assign_target(const list_expr* list, const char* form) {
+  expr_span exprs = list->get_exprs();
+  const expr* target = exprs.size() == 3 ? exprs[1] : nullptr;
+
+  if (!target || (target->kind() != expr_kind::local &&
+                  target->kind() != expr_kind::global)) {
+    throw eval_error(std::string("'") + form +
+                     "' expression requires a name and a value");
+  }
+
+  return target;
+}
 
-    std::visit(
-        [&](auto&& arg) {
-          using T = std::decay_t<decltype(arg)>;
+}  // namespace
+
+eval_context::eval_context() {
+  define_list_functions(*this);
+  define_persistent_functions(*this);
+  define_array_functions(*this);
+  define_parallel_functions(*this);
+}
+
+uint64_t next_epoch() {
+  static std::atomic<uint64_t> epochs{0};
+  return ++epochs;
+}
 
-          if constexpr (std::is_same_v<T, int>) {
-            std::cout << "int: " << arg << std::endl;
-          } else if constexpr (std::is_same_v<T, float>) {
-            std::cout << "float: " << arg << std::endl;
-          } else if constexpr (std::is_same_v<T, bool>) {
-            std::cout << "boolean: " << (arg ? "true" : "false") << std::endl;
-          } else if constexpr (std::is_same_v<T, std::string>) {
-            std::cout << "string: " << arg << std::endl;
-          }
-        },
-        value);
+bool is_portable(const expr_value& value) {
+  return value.is_number() || value.is_bool() || value.is_string();
+}
+
+// ints that don't fit inline and strings are refcounted, so they are
+// made again
+expr_value portable_copy(const expr_value& value) {
+  if (value.is_int()) {
+    return value.as_int();
+  }
+
+  if (value.is_string()) {
+    return value.as_string();
   }
+
+  return value;
 }
 
-expr_value eval_add(eval_context& ctx, const std::shared_ptr<list_expr>& list) {
-  float acc = 0;
+const list_expr* function_body(const expr_value& function) {
+  auto fun = function.is_callable()
+                 ? dynamic_cast<const closure*>(function.as_callable())
+                 : nullptr;
+  return fun ? fun->body() : nullptr;
+}
 
-  for (size_t i = 1; i < list->get_exprs().size(); ++i) {
-    auto value = get_value_from_expr(ctx, list->get_exprs()[i]);
+std::unique_ptr<eval_context> fork_context(const eval_context& parent) {
+  auto fork = std::make_unique<eval_context>();
+  fork->cache_calls = false;
+  fork->jit = parent.jit;
+  fork->pool = parent.pool;
+  fork->globals.reserve(parent.globals.size());
 
-    std::visit(
-        [&](auto&& arg) {
-          using T = std::decay_t<decltype(arg)>;
-          if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float>) {
-            acc += arg;
-          } else {
-            std::cerr << "error: invalid type for add" << std::endl;
-            exit(1);
-          }
-        },
-        value);
+  for (const expr_value& value : parent.globals) {
+    fork->globals.push_back(is_portable(value) ? portable_copy(value)
+                                               : expr_value::undefined());
   }
 
-  return acc;
+  for (const auto& [name, function] : parent.fmap) {
+    if (!function_body(function)) {
+      continue;
+    }
+
+    auto fun = static_cast<const closure*>(function.as_callable());
+    fork->fmap.insert_or_assign(name, expr_value(fun->clone()));
+  }
+
+  return fork;
 }
 
-expr_value eval_sub(eval_context& ctx, const std::shared_ptr<list_expr>& list) {
-  if (list->get_exprs().size() < 2) {
-    std::cerr << "error: at least one operand required for sub" << std::endl;
-    exit(1);
+expr_value eval_call(eval_context& ctx, const call_expr* call) {
+  return eval_call(ctx, call, callee(ctx, call));
+}
+
+expr_value eval_call(eval_context& ctx, const call_expr* call,
+                     callable* target) {
+  // held for the call, which may redefine the function
+  expr_value function(target);
+  std::size_t base = ctx.stack_top;
+
+  for (const expr* arg : call->get_args()) {
+    push(ctx, get_value_from_expr(ctx, arg));
   }
 
-  auto fst = get_value_from_expr(ctx, list->get_exprs()[1]);
-  float acc = 0;
-
-  std::visit(
-      [&](auto&& arg) {
-        using T = std::decay_t<decltype(arg)>;
-
-        if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float>) {
-          acc = arg;
-        } else {
-          std::cerr << "error: invalid type for sub" << std::endl;
-          exit(1);
-        }
-      },
-      fst);
-
-  for (size_t i = 2; i < list->get_exprs().size(); ++i) {
-    auto value = get_value_from_expr(ctx, list->get_exprs()[i]);
+  expr_value result = (*function.as_callable())(ctx, call->get_args().size());
+  ctx.stack_top = base;  // a tail call may have changed the count
+  return result;
+}
+
+expr_value call_function(eval_context& ctx, symbol_id name,
+                         const expr_value* args, std::size_t argc) {
+  auto it = ctx.fmap.find(name);
 
-    std::visit(
-        [&](auto&& arg) {
-          using T = std::decay_t<decltype(arg)>;
-          if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float>) {
-            acc -= arg;
-          } else {
-            std::cerr << "error: invalid type for sub" << std::endl;
-            exit(1);
-          }
-        },
-        value);
+  if (it == ctx.fmap.end() || !it->second.is_callable()) {
+    throw eval_error("function '" + symbol_name(name) + "' not found");
   }
 
-  return acc;
+  expr_value function = it->second;
+  std::size_t base = ctx.stack_top;
+
+  for (std::size_t i = 0; i < argc; ++i) {
+    push(ctx, args[i]);
+  }
+
+  expr_value result = (*function.as_callable())(ctx, argc);
+  ctx.stack_top = base;
+  return result;
 }
 
-expr_value eval_mul(eval_context& ctx, const std::shared_ptr<list_expr>& list) {
-  float acc = 1;
+expr_value get_value_from_expr(eval_context& ctx, const expr* node) {
+  switch (node->kind()) {
+    case expr_kind::integer:
+      return static_cast<const integer_expr*>(node)->get_value();
+    case expr_kind::floating:
+      return static_cast<const float_expr*>(node)->get_value();
+    case expr_kind::boolean:
+      return static_cast<const boolean_expr*>(node)->get_value();
+    case expr_kind::string:
+      return std::string(static_cast<const string_expr*>(node)->get_value());
+    case expr_kind::local:
+      return ctx.stack[ctx.frame +
+                       static_cast<const local_expr*>(node)->get_slot()];
+    case expr_kind::global: {
+      auto global_node = static_cast<const global_expr*>(node);
+      const expr_value& value = ctx.globals[global_node->get_slot()];
+
+      if (!value.is_undefined()) {
+        return value;
+      } else {
+        throw eval_error("identifier '" + symbol_name(global_node->get_id()) +
+                         "' not found");
+      }
+    }
+    case expr_kind::symbol: {
+      throw eval_error("identifier '" +
+                       static_cast<const symbol_expr*>(node)->get_name() +
+                       "' was not resolved");
+    }
+    case expr_kind::call:
+      return eval_call(ctx, static_cast<const call_expr*>(node));
+    case expr_kind::list:
+      break;
+  }
 
-  for (size_t i = 1; i < list->get_exprs().size(); ++i) {
-    auto value = get_value_from_expr(ctx, list->get_exprs()[i]);
+  auto list_node = static_cast<const list_expr*>(node);
+  auto symbol = list_node->get_exprs().empty()
+                    ? nullptr
+                    : expr_cast<symbol_expr>(list_node->get_exprs().front());
 
-    std::visit(
-        [&](auto&& arg) {
-          using T = std::decay_t<decltype(arg)>;
+  if (symbol) {
+    switch (symbol->get_id()) {
+      case symbol_add:
+        return eval_add(ctx, list_node);
+      case symbol_sub:
+        return eval_sub(ctx, list_node);
+      case symbol_mul:
+        return eval_mul(ctx, list_node);
+      case symbol_div:
+        return eval_div(ctx, list_node);
+      case symbol_if:
+        return eval_if(ctx, list_node);
+      case symbol_while:
+        return eval_while(ctx, list_node);
+      case symbol_def:
+        return eval_def(ctx, list_node);
+      case symbol_set:
+        return eval_set(ctx, list_node);
+      case symbol_debug:
+        return eval_debug(ctx, list_node);
+      case symbol_lt:
+      case symbol_gt:
+      case symbol_le:
+      case symbol_ge:
+      case symbol_eq:
+        return eval_compare(ctx, list_node, symbol->get_id());
+    }
 
-          if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float>) {
-            acc *= arg;
-          } else {
-            std::cerr << "error: invalid type for mul" << std::endl;
-            exit(1);
-          }
-        },
-        value);
+    // special forms that only make sense as statements (fun)
+    throw eval_error("'" + symbol->get_name() +
+                     "' cannot be used as an expression");
   }
 
-  return acc;
+  throw eval_error("unknown expression type");
 }
 
-expr_value eval_div(eval_context& ctx, const std::shared_ptr<list_expr>& list) {
-  if (list->get_exprs().size() < 2) {
-    std::cerr << "error: at least one operand required for div" << std::endl;
-    exit(1);
+void interp::eval(eval_context& ctx, const std::shared_ptr<const ast>& tree,
+                  bool whole_program) {
+  ctx.tree = ctx.names.resolve(tree, whole_program);
+
+  if (whole_program) {
+    ctx.names.finish();
   }
 
-  auto fst = get_value_from_expr(ctx, list->get_exprs()[1]);
-  float acc = 0;
-
-  std::visit(
-      [&](auto&& arg) {
-        using T = std::decay_t<decltype(arg)>;
-
-        if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float>) {
-          acc = arg;
-        } else {
-          std::cerr << "error: invalid type for div" << std::endl;
-          exit(1);
-        }
-      },
-      fst);
-
-  for (size_t i = 2; i < list->get_exprs().size(); ++i) {
+  ctx.globals.resize(ctx.names.global_count(), expr_value::undefined());
+
+  if (whole_program) {
+    for (const expr* form : expr_cast<list_expr>(ctx.tree->root)->get_exprs()) {
+      eval(ctx, form);
+    }
+  } else {
+    eval(ctx, ctx.tree->root);
+  }
+
+  ctx.tree = nullptr;
+}
+
+void interp::finish(eval_context& ctx) { ctx.names.finish(); }
+
+void interp::eval(eval_context& ctx, const expr* node) {
+  safepoint(ctx);
+
+  // a function body only runs when the function is called
+  if (auto head = head_of(node); head && head->get_id() == symbol_fun) {
+    eval_fun(ctx, static_cast<const list_expr*>(node));
+    return;
+  }
+
+  get_value_from_expr(ctx, node);
+}
+
+// @todo: prevent redefinition & mutable-by-default
+expr_value eval_def(eval_context& ctx, const list_expr* lst) {
+  auto global = static_cast<const global_expr*>(assign_target(lst, "def"));
+  auto value_expr = get_value_from_expr(ctx, lst->get_exprs()[2]);
+  ctx.globals[global->get_slot()] = value_expr;
+  return value_expr;
+}
+
+expr_value eval_set(eval_context& ctx, const list_expr* lst) {
+  const expr* target = assign_target(lst, "set");
+  auto value_expr = get_value_from_expr(ctx, lst->get_exprs()[2]);
+
+  if (auto local = expr_cast<local_expr>(target)) {
+    ctx.stack[ctx.frame + local->get_slot()] = value_expr;
+  } else {
+    auto global = static_cast<const global_expr*>(target);
+    ctx.globals[global->get_slot()] = value_expr;
+  }
+
+  return value_expr;
+}
+
+expr_value eval_debug(eval_context& ctx, const list_expr* list) {
+  for (size_t i = 1; i < list->get_exprs().size(); ++i) {
     auto value = get_value_from_expr(ctx, list->get_exprs()[i]);
 
-    std::visit(
-        [&](auto&& arg) {
-          using T = std::decay_t<decltype(arg)>;
+    if (value.is_int()) {
+      *ctx.out << "int: " << value.as_int() << std::endl;
+    } else if (value.is_float()) {
+      *ctx.out << "float: " << value.as_float() << std::endl;
+    } else if (value.is_bool()) {
+      *ctx.out << "boolean: " << (value.as_bool() ? "true" : "false")
+               << std::endl;
+    } else if (value.is_string()) {
+      *ctx.out << "string: " << value.as_string() << std::endl;
+    } else if (value.is_empty_list() || value.is_object()) {
+      *ctx.out << object_type(value) << ": ";
+      write_object(*ctx.out, value);
+      *ctx.out << std::endl;
+    }
+  }
 
-          if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float>) {
-            if (arg == 0) {
-              std::cerr << "error: div by zero" << std::endl;
-              exit(1);
-            }
+  return {};
+}
+
+expr_value eval_add(eval_context& ctx, const list_expr* list) {
+  return fold<add_op>(ctx, list, 1, 0);
+}
 
-            acc /= arg;
-          } else {
-            std::cerr << "error: invalid type for div" << std::endl;
-            exit(1);
-          }
-        },
-        value);
+expr_value eval_sub(eval_context& ctx, const list_expr* list) {
+  if (list->get_exprs().size() < 2) {
+    throw eval_error("at least one operand required for sub");
   }
 
-  return acc;
+  auto fst = get_value_from_expr(ctx, list->get_exprs()[1]);
+  return fold<sub_op>(ctx, list, 2, number(fst, "sub"));
 }
 
-expr_value eval_if(eval_context& ctx, const std::shared_ptr<list_expr>& list) {
+expr_value eval_mul(eval_context& ctx, const list_expr* list) {
+  return fold<mul_op>(ctx, list, 1, 1);
+}
+
+expr_value eval_div(eval_context& ctx, const list_expr* list) {
   if (list->get_exprs().size() < 2) {
-    std::cerr << "error: 'if' expression requires at least a condition and a "
-                 "then clause"
-              << std::endl;
-    exit(1);
+    throw eval_error("at least one operand required for div");
   }
 
-  auto condition_value = get_value_from_expr(ctx, list->get_exprs()[1]);
+  auto fst = get_value_from_expr(ctx, list->get_exprs()[1]);
+  return fold<div_op>(ctx, list, 2, number(fst, "div"));
+}
 
-  bool condition = false;
+expr_value eval_compare(eval_context& ctx, const list_expr* list,
+                        symbol_id op) {
+  // the name (which means locking the symbol table) is only looked up
+  // for an error
+  if (list->get_exprs().size() != 3) {
+    throw eval_error("'" + symbol_name(op) + "' requires two operands");
+  }
 
-  std::visit(
-      [&](auto&& arg) {
-        using T = std::decay_t<decltype(arg)>;
+  // lhs stays on the stack, where the collector sees it, while rhs is
+  // evaluated
+  std::size_t base = ctx.stack_top;
+  push(ctx, get_value_from_expr(ctx, list->get_exprs()[1]));
+  auto rhs = get_value_from_expr(ctx, list->get_exprs()[2]);
+  auto lhs = ctx.stack[base];
+  ctx.stack_top = base;
 
-        if constexpr (std::is_same_v<T, bool>) {
-          condition = arg;
-        } else {
-          std::cerr << "error: 'if' condition must evaluate to a boolean"
-                    << std::endl;
-          exit(1);
-        }
-      },
-      condition_value);
+  if (lhs.is_int() && rhs.is_int()) {
+    return compare(op, lhs.as_int(), rhs.as_int());
+  }
 
-  if (condition) {
-    return get_value_from_expr(ctx, list->get_exprs()[2]);
+  if (lhs.is_number() && rhs.is_number()) {
+    return compare(op, lhs.as_number(), rhs.as_number());
   }
 
-  if (list->get_exprs().size() > 3) {
-    return get_value_from_expr(ctx, list->get_exprs()[3]);
+  if (op == symbol_eq && lhs.is_bool() && rhs.is_bool()) {
+    return lhs.as_bool() == rhs.as_bool();
   }
 
-  return {};
-}
+  if (op == symbol_eq && lhs.is_string() && rhs.is_string()) {
+    return lhs.as_string() == rhs.as_string();
+  }
 
-expr_value eval_fun(eval_context& ctx, const std::shared_ptr<list_expr>& list) {
-  if (list->get_exprs().size() < 3) {
-    std::cerr
-        << "error: 'fun' expression requires a name, parameters, and a body"
-        << std::endl;
-    exit(1);
+  // lists, vectors and maps are the same when they are the same object
+  if (op == symbol_eq && lhs.is_object() && rhs.is_object()) {
+    return lhs.as_object() == rhs.as_object();
   }
 
-  auto name_expr = std::dynamic_pointer_cast<symbol_expr>(list->get_exprs()[1]);
-  auto params_expr = std::dynamic_pointer_cast<list_expr>(list->get_exprs()[2]);
-  auto body_expr = std::dynamic_pointer_cast<list_expr>(list->get_exprs()[3]);
+  if (op == symbol_eq && (lhs.is_empty_list() || rhs.is_empty_list()) &&
+      (lhs.is_empty_list() || lhs.is_object()) &&
+      (rhs.is_empty_list() || rhs.is_object())) {
+    return lhs.is_empty_list() && rhs.is_empty_list();
+  }
 
-  if (!name_expr || !params_expr || !body_expr) {
-    std::cerr << "error: invalid 'fun' expression structure" << std::endl;
-    exit(1);
+  throw eval_error("invalid type for " + symbol_name(op));
+}
+
+expr_value eval_if(eval_context& ctx, const list_expr* list) {
+  const expr* branch = select_branch(ctx, list);
+  return branch ? get_value_from_expr(ctx, branch) : expr_value();
+}
+
+expr_value eval_while(eval_context& ctx, const list_expr* list) {
+  if (list->get_exprs().size() < 2) {
+    throw eval_error("'while' expression requires a condition");
   }
 
-  std::string func_name = name_expr->get_name();
-  std::vector<std::string> func_params;
+  while (condition(ctx, list->get_exprs()[1], "while")) {
+    safepoint(ctx);
 
-  for (const auto& param : params_expr->get_exprs()) {
-    if (auto param_symbol = std::dynamic_pointer_cast<symbol_expr>(param)) {
-      func_params.push_back(param_symbol->get_name());
-    } else {
-      std::cerr << "error: 'fun' parameters must be symbols" << std::endl;
-      exit(1);
+    for (std::size_t i = 2; i < list->get_exprs().size(); ++i) {
+      get_value_from_expr(ctx, list->get_exprs()[i]);
     }
   }
 
-  auto func =
-      [params = std::move(func_params), body_expr = std::move(body_expr)](
-          eval_context& ctx, std::vector<expr_value> args) -> expr_value {
-    if (args.size() != params.size()) {
-      std::cerr << "error: argument count does not match parameter count"
-                << std::endl;
-      exit(1);
-    }
+  return {};
+}
 
-    eval_context& local_ctx = ctx;
+expr_value eval_fun(eval_context& ctx, const list_expr* list) {
+  if (list->get_exprs().size() < 4) {
+    throw eval_error(
+        "'fun' expression requires a name, parameters, and a body");
+  }
 
-    for (size_t i = 0; i < params.size(); ++i) {
-      local_ctx.vmap[params[i]] = std::move(args[i]);
-    }
+  auto name_expr = expr_cast<symbol_expr>(list->get_exprs()[1]);
+  auto params_expr = expr_cast<list_expr>(list->get_exprs()[2]);
+  auto body_expr = expr_cast<list_expr>(list->get_exprs()[3]);
 
-    expr_value func_ret_value;
+  if (!name_expr || !params_expr || !body_expr) {
+    throw eval_error("invalid 'fun' expression structure");
+  }
 
-    for (const auto& expr : body_expr->get_exprs()) {
-      func_ret_value = get_value_from_expr(local_ctx, expr);
-    }
+  symbol_id func_name = name_expr->get_id();
 
-    return func_ret_value;
-  };
+  for (const auto& param : params_expr->get_exprs()) {
+    if (!expr_cast<symbol_expr>(param)) {
+      throw eval_error("'fun' parameters must be symbols");
+    }
+  }
 
-  ctx.fmap.insert_or_assign(
-      std::move(func_name),
-      std::make_unique<callable_impl<decltype(func)>>(std::move(func)));
+  expr_value function(new closure(
+      func_name, params_expr->get_exprs().size(), body_expr, ctx.tree));
+  if (!ctx.fmap.insert_or_assign(func_name, function).second) {
+    ctx.epoch = next_epoch();  // call sites may have cached the old one
+  }
 
-  return expr_value(
-      std::make_unique<callable_impl<decltype(func)>>(std::move(func)));
+  return function;
 }
@@ -3,28 +3,21 @@
 #ifndef INTERP_H
 #define INTERP_H
 
+#include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
+#include "binding.h"
+#include "gc.h"
 #include "parser.h"
+#include "resolver.h"
+#include "value.h"
 
-class callable;
-class eval_context;
-
-using expr_value =
-    std::variant<int, float, bool, std::string, std::unique_ptr<callable>>;
-
-// we do this to avoid template overloading which requires specific
-// instantiations of flisp functions in lieu of using std::unique_ptr
-// on a callable interface which is actually realistic
-
-class callable {
- public:
-  virtual ~callable() = default;
-  virtual expr_value operator()(eval_context& ctx,
-                                std::vector<expr_value> args) = 0;
-};
+// functions defined with fun are closures wrapped in a callable (see
+// value.h), so they can be held by values like any other heap object
 
 template <typename F>
 class callable_impl : public callable {
@@ -33,48 +26,185 @@ class callable_impl : public callable {
  public:
   callable_impl(F&& f) : func(std::forward<F>(f)) {}
 
-  expr_value operator()(eval_context& ctx,
-                        std::vector<expr_value> args) override {
-    return func(ctx, std::move(args));
+  expr_value operator()(eval_context& ctx, std::size_t argc) override {
+    return func(ctx, argc);
   }
 };
 
+// variables are addressed as resolved by names (see resolver.h):
+// globals by slot, parameters by position in the arguments of the
+// running call. functions are keyed by interned symbol ids
+//
+// calls don't allocate: the caller evaluates the arguments straight onto
+// the value stack, the callee's frame starts at the first of them so its
+// parameters are read in place, and the caller drops them by moving
+// stack_top back down. the stack is preallocated and only grows (by
+// doubling) when recursion goes deeper than it has before
+
+class thread_pool;
+
+// a value no eval_context has had as its epoch yet
+uint64_t next_epoch();
+
 class eval_context {
  public:
-  std::unordered_map<std::string, expr_value> vmap;
-  std::unordered_map<std::string, expr_value> fmap;
-  // std::unordered_map<std::string, std::unique_ptr<callable>> fmap;
+  // with the functions of lists.h, persistent.h, arrays.h and parallel.h
+  eval_context();
+
+  resolver names;
+  std::vector<expr_value> globals;  // undefined until defined
+
+  static constexpr std::size_t initial_stack_size = 1 << 12;
+  std::vector<expr_value> stack = std::vector<expr_value>(initial_stack_size);
+  std::size_t stack_top = 0;  // first free value
+  std::size_t frame = 0;      // parameters of the running call
+
+  std::unordered_map<symbol_id, expr_value> fmap;
+
+  // lists and vectors, the globals and stack are its roots
+  gc_heap heap;
+
+  // call sites cache the function they found for the current epoch (see
+  // call_expr), redefining a function starts a new one. epochs are unique
+  // across contexts, a tree evaluated in one never hits in another
+  uint64_t epoch = next_epoch();
+  uint64_t call_hits = 0;
+  uint64_t call_misses = 0;
+
+  // off for contexts that run a tree other threads are running too (see
+  // fork_context), the cache in its call sites is not theirs to fill
+  bool cache_calls = true;
+
+  // hot functions run as native code where they can (see jit.h)
+  bool jit = true;
+  uint64_t jit_compiled = 0;
+  uint64_t jit_runs = 0;
+  uint64_t jit_bails = 0;
+
+  // where debug writes to
+  std::ostream* out = &std::cout;
+
+  // where pmap, pfilter and preduce run (see parallel.h), the
+  // process-wide pool when null
+  thread_pool* pool = nullptr;
+
+  // tree currently being evaluated, functions defined from it hold on
+  // to it so their bodies outlive the caller dropping the tree
+  std::shared_ptr<const ast> tree;
+
+  // defines the function name as function, a function pointer or a
+  // function object with a single call operator, called with the
+  // arguments converted as described in binding.h. like a fun, it
+  // replaces a function of the same name
+  template <typename F>
+  void bind(std::string_view name, F function);
 };
 
+// a c++ function bound with eval_context::bind
+template <typename F>
+class host_function final : public callable {
+ public:
+  host_function(symbol_id name, F function)
+      : name_(name), function_(std::move(function)) {}
+
+  expr_value operator()(eval_context& ctx, std::size_t argc) override {
+    return host_invoke(
+        name_, function_, ctx.stack.data() + (ctx.stack_top - argc), argc,
+        std::make_index_sequence<host_signature<F>::arity>());
+  }
+
+ private:
+  symbol_id name_;
+  F function_;
+};
+
+template <typename F>
+void eval_context::bind(std::string_view name, F function) {
+  symbol_id id = intern(name);
+  expr_value value(new host_function<F>(id, std::move(function)));
+
+  if (!fmap.insert_or_assign(id, std::move(value)).second) {
+    epoch = next_epoch();  // call sites may have cached the old one
+  }
+}
+
+// calls the function name is defined as (by fun, bind or the runtime)
+// with argc arguments, as a call in a script would. args must not point
+// into ctx.stack, which the call may grow
+expr_value call_function(eval_context& ctx, symbol_id name,
+                         const expr_value* args, std::size_t argc);
+
+// values that can be handed to another thread are numbers, bools and
+// strings. the copy shares no refcounted object with value
+bool is_portable(const expr_value& value);
+expr_value portable_copy(const expr_value& value);
+
+// the body of a function defined with fun, nullptr for other functions
+const list_expr* function_body(const expr_value& function);
+
+// a context for running the functions of parent on another thread while
+// parent waits. it has parent's functions defined with fun (sharing
+// their bodies, but not their jit code), the functions of the runtime,
+// and portable copies of the globals that are portable (the others are
+// undefined). call sites are not cached, the tree is parent's
+std::unique_ptr<eval_context> fork_context(const eval_context& parent);
+
 class interp {
  public:
   interp() : ctx() {}
 
-  void eval(eval_context& ctx, const std::shared_ptr<expr>& node);
+  // resolves tree and evaluates it, either a whole program (the list of
+  // top-level forms parse_source gives) or a single form. a whole program
+  // is checked for undefined names before it runs, when a program is
+  // evaluated one form at a time finish() checks the names left over at
+  // the end
+  void eval(eval_context& ctx, const std::shared_ptr<const ast>& tree,
+            bool whole_program = false);
+  void finish(eval_context& ctx);
+
+  // evaluates a top-level form that has already been resolved: fun
+  // defines a function, anything else runs as an expression (a call, an
+  // if, a loop..) whose value is dropped
+  void eval(eval_context& ctx, const expr* node);
 
  private:
   eval_context ctx;
-  std::unordered_map<std::string, expr_value> vmap;
-  bool skip_initial_lst;
-
-  void eval_def(eval_context& ctx, const std::shared_ptr<list_expr>& list);
-  void eval_set(eval_context& ctx, const std::shared_ptr<list_expr>& list);
-  void eval_debug(eval_context& ctx, const std::shared_ptr<list_expr>& list);
 };
 
 // the definitions below should remain recursive with regards
 // to get_value_from_expr, binary operations accumulate based
 // on their corresponding identity elements (e.g. 0 for additive
-// identity or 1 for multiplicative identity)
-
-expr_value eval_fun(eval_context& ctx, const std::shared_ptr<list_expr>& list);
-expr_value eval_if(eval_context& ctx, const std::shared_ptr<list_expr>& list);
-expr_value eval_add(eval_context& ctx, const std::shared_ptr<list_expr>& list);
-expr_value eval_sub(eval_context& ctx, const std::shared_ptr<list_expr>& list);
-expr_value eval_mul(eval_context& ctx, const std::shared_ptr<list_expr>& list);
-expr_value eval_div(eval_context& ctx, const std::shared_ptr<list_expr>& list);
+// identity or 1 for multiplicative identity) and follow the
+// numeric tower in arith.h
+
+// def and set give the value assigned, debug and while give nothing (the
+// same as an if without an else branch). a call in tail position of a
+// function body, the last form or a branch of an if there, reuses the
+// caller's frame, so tail recursion runs in constant stack
+
+expr_value eval_def(eval_context& ctx, const list_expr* list);
+expr_value eval_set(eval_context& ctx, const list_expr* list);
+expr_value eval_debug(eval_context& ctx, const list_expr* list);
+expr_value eval_fun(eval_context& ctx, const list_expr* list);
+expr_value eval_call(eval_context& ctx, const call_expr* call);
+expr_value eval_if(eval_context& ctx, const list_expr* list);
+expr_value eval_while(eval_context& ctx, const list_expr* list);
+expr_value eval_add(eval_context& ctx, const list_expr* list);
+expr_value eval_sub(eval_context& ctx, const list_expr* list);
+expr_value eval_mul(eval_context& ctx, const list_expr* list);
+expr_value eval_div(eval_context& ctx, const list_expr* list);
+
+// call with target, the function it goes to, already looked up
+expr_value eval_call(eval_context& ctx, const call_expr* call,
+                     callable* target);
+
+// comparisons take two operands, numbers compare by value (as floats
+// unless both are ints), = also compares two booleans or two strings,
+// and lists or vectors by identity
+expr_value eval_compare(eval_context& ctx, const list_expr* list,
+                        symbol_id op);
 
 expr_value get_value_from_expr(eval_context& ctx,
-                               const std::shared_ptr<expr>& node);
+                               const expr* node);
 
 #endif  // INTERP_H
@@ -0,0 +1,43 @@
+#include "./isolate.h"
+
+#include <stdexcept>
+
+#include "./optimizer.h"
+
+script::script(std::string_view source)
+    : tree_(optimize(parse_source(source), true)) {}
+
+void isolate::run(const script& code) {
+  try {
+    interp_.eval(ctx_, code.tree(), true);
+  } catch (...) {
+    // the calls the error unwound from are gone
+    ctx_.stack_top = 0;
+    ctx_.frame = 0;
+    ctx_.tree = nullptr;
+    throw;
+  }
+}
+
+std::vector<std::string> run_isolated(
+    const std::vector<std::shared_ptr<const script>>& scripts,
+    const std::function<void(isolate&)>& setup, thread_pool& pool) {
+  std::vector<std::string> outputs(scripts.size());
+
+  pool.parallel_for(scripts.size(), [&](std::size_t i) {
+    isolate context;
+
+    if (setup) {
+      setup(context);
+    }
+
+    try {
+      context.run(*scripts[i]);
+      outputs[i] = context.output();
+    } catch (const std::runtime_error& error) {  // resolving or running it
+      outputs[i] = context.output() + "error: " + error.what() + "\n";
+    }
+  });
+
+  return outputs;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#ifndef ISOLATE_H
+#define ISOLATE_H
+
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "interp.h"
+#include "parser.h"
+#include "thread_pool.h"
+
+// running many independent programs at once, each on whichever thread
+// is free.
+//
+// a script is a program parsed and optimized once and never changed
+// after, so a single script can be run by any number of threads at the
+// same time. an isolate holds everything evaluation changes: globals,
+// functions, the value stack, the resolved tree (whose call sites cache
+// what they call, see call_expr), jit code and the output of debug. an
+// isolate is used by one thread at a time, and since heap values are
+// refcounted without atomics (see value.h) no value may be handed from
+// one isolate to another.
+//
+// what isolates share is only ever read (scripts, the parsed trees they
+// point into) or is locked (the symbol table, see symbol.h). an error in
+// a script (see error.h) ends that script, the others carry on
+
+class script {
+ public:
+  // syntax errors are thrown as from parse_source
+  explicit script(std::string_view source);
+
+  const std::shared_ptr<const ast>& tree() const { return tree_; }
+
+ private:
+  std::shared_ptr<const ast> tree_;
+};
+
+class isolate {
+ public:
+  isolate() { ctx_.out = &output_; }
+
+  isolate(const isolate&) = delete;
+  isolate& operator=(const isolate&) = delete;
+
+  // evaluates code as a whole program, after whatever ran here before.
+  // an error in code is thrown on, what code defined before it stays
+  // defined and the isolate can run another script
+  void run(const script& code);
+
+  // everything debug has written so far
+  std::string output() const { return output_.str(); }
+
+  // e.g. to bind host functions before running anything
+  eval_context& context() { return ctx_; }
+
+ private:
+  eval_context ctx_;
+  interp interp_;
+  std::ostringstream output_;
+};
+
+// runs each script in a fresh isolate of its own, on the workers of pool
+// and the calling thread, and returns their outputs in the order of
+// scripts. the output of a script ending in an error ends with the error
+// as the command line prints it. setup, if given, is called on each
+// isolate first
+std::vector<std::string> run_isolated(
+    const std::vector<std::shared_ptr<const script>>& scripts,
+    const std::function<void(isolate&)>& setup = nullptr,
+    thread_pool& pool = thread_pool::shared());
+
+#endif  // ISOLATE_H
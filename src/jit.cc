@@ -0,0 +1,603 @@
+#include "./jit.h"
+
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define FLISP_JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef FLISP_JIT_X86_64
+
+namespace {
+
+// the code is a plain stack machine: every expression leaves its value
+// in rax (an int, or the bits of a double), operands waiting for the
+// rest of an expression are pushed on the native stack and doubles only
+// visit xmm0/xmm1 for the instruction working on them. parameters live
+// in the frame, copied there from the args array on entry:
+//
+//   [rbp - 8]             the result pointer
+//   [rbp - 16 - 8 * i]    parameter i
+//
+// functions follow the system v abi: bool f(const uint64_t* args (rdi),
+// uint64_t* result (rsi)), a self call passes the args and result slot
+// on its own stack
+
+enum class kind { int64, float64 };
+
+struct unsupported {};  // gives up on the body
+
+class codegen {
+ public:
+  codegen(symbol_id name, std::size_t arity, uint32_t float_params,
+          kind returns)
+      : name_(name),
+        arity_(arity),
+        float_params_(float_params),
+        returns_(returns) {}
+
+  // the whole function for a body expression of kind returns
+  std::vector<uint8_t> function(const expr* body);
+
+ private:
+  using label = std::size_t;
+
+  symbol_id name_;
+  std::size_t arity_;
+  uint32_t float_params_;
+  kind returns_;
+
+  std::vector<uint8_t> code_;
+  std::vector<std::ptrdiff_t> labels_;  // offsets, -1 until bound
+  std::vector<std::pair<std::size_t, label>> fixups_;  // rel32 to patch
+  std::size_t depth_ = 0;  // bytes pushed below the frame
+  label body_ = 0;
+  label bail_ = 0;
+
+  kind infer(const expr* node) const;
+  kind expression(const expr* node, bool tail);
+  kind arith(symbol_id op, expr_span operands);
+  void binary(symbol_id op, kind lhs, kind rhs);
+  kind branch(const list_expr* list, bool tail);
+  void branch_unless(const expr* condition, label otherwise);
+  kind self_call(const call_expr* call, bool tail);
+  void self_call_args(const call_expr* call);
+
+  static int32_t param(std::size_t i) {
+    return -16 - 8 * static_cast<int32_t>(i);
+  }
+
+  kind param_kind(std::size_t i) const {
+    return float_params_ >> i & 1 ? kind::float64 : kind::int64;
+  }
+
+  void emit(std::initializer_list<uint8_t> bytes) {
+    code_.insert(code_.end(), bytes);
+  }
+
+  void imm32(int32_t value) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, &value, sizeof(bytes));
+    code_.insert(code_.end(), bytes, bytes + sizeof(bytes));
+  }
+
+  void imm64(uint64_t value) {
+    uint8_t bytes[8];
+    std::memcpy(bytes, &value, sizeof(bytes));
+    code_.insert(code_.end(), bytes, bytes + sizeof(bytes));
+  }
+
+  label new_label() {
+    labels_.push_back(-1);
+    return labels_.size() - 1;
+  }
+
+  void bind(label l) { labels_[l] = code_.size(); }
+
+  // opcode followed by a rel32 to target
+  void jump(std::initializer_list<uint8_t> opcode, label target) {
+    emit(opcode);
+    fixups_.emplace_back(code_.size(), target);
+    imm32(0);
+  }
+
+  void push_rax() {
+    emit({0x50});  // push rax
+    depth_ += 8;
+  }
+
+  // rax = the pushed lhs, rcx = rhs (which was in rax)
+  void pop_operands() {
+    emit({0x48, 0x89, 0xc1});  // mov rcx, rax
+    emit({0x58});              // pop rax
+    depth_ -= 8;
+  }
+
+  // xmm0 = rax, xmm1 = rcx, converting ints
+  void float_operands(kind lhs, kind rhs) {
+    if (lhs == kind::int64) {
+      emit({0xf2, 0x48, 0x0f, 0x2a, 0xc0});  // cvtsi2sd xmm0, rax
+    } else {
+      emit({0x66, 0x48, 0x0f, 0x6e, 0xc0});  // movq xmm0, rax
+    }
+
+    if (rhs == kind::int64) {
+      emit({0xf2, 0x48, 0x0f, 0x2a, 0xc9});  // cvtsi2sd xmm1, rcx
+    } else {
+      emit({0x66, 0x48, 0x0f, 0x6e, 0xc9});  // movq xmm1, rcx
+    }
+  }
+};
+
+// the kind of value node evaluates to, without emitting anything
+kind codegen::infer(const expr* node) const {
+  switch (node->kind()) {
+    case expr_kind::integer:
+      return kind::int64;
+    case expr_kind::floating:
+      return kind::float64;
+    case expr_kind::local:
+      return param_kind(static_cast<const local_expr*>(node)->get_slot());
+    case expr_kind::call:
+      return returns_;
+    case expr_kind::list:
+      break;
+    default:
+      throw unsupported();
+  }
+
+  expr_span exprs = static_cast<const list_expr*>(node)->get_exprs();
+  auto head = exprs.empty() ? nullptr : expr_cast<symbol_expr>(exprs[0]);
+
+  if (!head) {
+    throw unsupported();
+  }
+
+  switch (head->get_id()) {
+    case symbol_if:
+      if (exprs.size() < 3) {
+        throw unsupported();
+      }
+      return infer(exprs[2]);
+    case symbol_add:
+    case symbol_sub:
+    case symbol_mul:
+    case symbol_div: {
+      // an inexact quotient bails, so a fold of ints stays an int
+      kind acc = kind::int64;
+
+      for (std::size_t i = 1; i < exprs.size(); ++i) {
+        if (infer(exprs[i]) == kind::float64) {
+          acc = kind::float64;
+        }
+      }
+
+      return acc;
+    }
+    default:
+      throw unsupported();
+  }
+}
+
+std::vector<uint8_t> codegen::function(const expr* body) {
+  body_ = new_label();
+  bail_ = new_label();
+
+  // frame for the result pointer and the parameters, 16-byte aligned
+  int32_t frame = static_cast<int32_t>((8 + 8 * arity_ + 15) / 16 * 16);
+
+  emit({0x55});              // push rbp
+  emit({0x48, 0x89, 0xe5});  // mov rbp, rsp
+  emit({0x48, 0x81, 0xec});  // sub rsp, frame
+  imm32(frame);
+  emit({0x48, 0x89, 0xb5});  // mov [rbp - 8], rsi
+  imm32(-8);
+
+  for (std::size_t i = 0; i < arity_; ++i) {
+    emit({0x48, 0x8b, 0x87});  // mov rax, [rdi + 8 * i]
+    imm32(static_cast<int32_t>(8 * i));
+    emit({0x48, 0x89, 0x85});  // mov [rbp + param(i)], rax
+    imm32(param(i));
+  }
+
+  bind(body_);
+
+  if (expression(body, true) != returns_) {
+    throw unsupported();
+  }
+
+  emit({0x48, 0x8b, 0x95});  // mov rdx, [rbp - 8]
+  imm32(-8);
+  emit({0x48, 0x89, 0x02});              // mov [rdx], rax
+  emit({0xb8, 0x01, 0x00, 0x00, 0x00});  // mov eax, 1
+  emit({0xc9, 0xc3});                    // leave, ret
+
+  bind(bail_);
+  emit({0x31, 0xc0});  // xor eax, eax
+  emit({0xc9, 0xc3});  // leave, ret
+
+  for (auto [at, target] : fixups_) {
+    int32_t rel = static_cast<int32_t>(labels_[target] -
+                                       static_cast<std::ptrdiff_t>(at + 4));
+    std::memcpy(&code_[at], &rel, sizeof(rel));
+  }
+
+  return std::move(code_);
+}
+
+kind codegen::expression(const expr* node, bool tail) {
+  switch (node->kind()) {
+    case expr_kind::integer:
+      emit({0x48, 0xb8});  // mov rax, imm64
+      imm64(static_cast<uint64_t>(
+          static_cast<const integer_expr*>(node)->get_value()));
+      return kind::int64;
+    case expr_kind::floating: {
+      double d = static_cast<const float_expr*>(node)->get_value();
+      uint64_t bits;
+      std::memcpy(&bits, &d, sizeof(bits));
+      emit({0x48, 0xb8});  // mov rax, imm64
+      imm64(bits);
+      return kind::float64;
+    }
+    case expr_kind::local: {
+      std::size_t slot = static_cast<const local_expr*>(node)->get_slot();
+      emit({0x48, 0x8b, 0x85});  // mov rax, [rbp + param(slot)]
+      imm32(param(slot));
+      return param_kind(slot);
+    }
+    case expr_kind::call:
+      return self_call(static_cast<const call_expr*>(node), tail);
+    case expr_kind::list:
+      break;
+    default:
+      throw unsupported();
+  }
+
+  auto list = static_cast<const list_expr*>(node);
+  expr_span exprs = list->get_exprs();
+  auto head = exprs.empty() ? nullptr : expr_cast<symbol_expr>(exprs[0]);
+
+  if (!head) {
+    throw unsupported();
+  }
+
+  switch (head->get_id()) {
+    case symbol_if:
+      return branch(list, tail);
+    case symbol_add:
+    case symbol_sub:
+    case symbol_mul:
+    case symbol_div:
+      return arith(head->get_id(),
+                   expr_span(exprs.begin() + 1, exprs.size() - 1));
+    default:
+      throw unsupported();
+  }
+}
+
+// the same fold as the interpreter's: (+) and (*) are their identities,
+// - and / start from their first operand. starting + from its first
+// operand too is the same unless that's a float (0 + -0.0 is 0.0)
+kind codegen::arith(symbol_id op, expr_span operands) {
+  std::size_t first = 1;
+  kind acc;
+
+  if (operands.empty()) {
+    if (op != symbol_add && op != symbol_mul) {
+      throw unsupported();
+    }
+
+    emit({0x48, 0xb8});  // mov rax, imm64
+    imm64(op == symbol_add ? 0 : 1);
+    return kind::int64;
+  }
+
+  if (op == symbol_add && infer(operands[0]) == kind::float64) {
+    emit({0x48, 0xb8});  // mov rax, 0
+    imm64(0);
+    acc = kind::int64;
+    first = 0;
+  } else {
+    acc = expression(operands[0], false);
+  }
+
+  for (std::size_t i = first; i < operands.size(); ++i) {
+    push_rax();
+    kind rhs = expression(operands[i], false);
+    binary(op, acc, rhs);
+    acc = acc == kind::int64 && rhs == kind::int64 ? kind::int64
+                                                   : kind::float64;
+  }
+
+  return acc;
+}
+
+// rax = pushed lhs op rax
+void codegen::binary(symbol_id op, kind lhs, kind rhs) {
+  pop_operands();
+
+  if (lhs == kind::int64 && rhs == kind::int64) {
+    switch (op) {
+      case symbol_add:
+        emit({0x48, 0x01, 0xc8});  // add rax, rcx
+        jump({0x0f, 0x80}, bail_);  // jo
+        return;
+      case symbol_sub:
+        emit({0x48, 0x29, 0xc8});  // sub rax, rcx
+        jump({0x0f, 0x80}, bail_);  // jo
+        return;
+      case symbol_mul:
+        emit({0x48, 0x0f, 0xaf, 0xc1});  // imul rax, rcx
+        jump({0x0f, 0x80}, bail_);       // jo
+        return;
+      default: {
+        // div by zero, INT64_MIN / -1 and inexact quotients bail
+        label divide = new_label();
+        label done = new_label();
+        emit({0x48, 0x85, 0xc9});  // test rcx, rcx
+        jump({0x0f, 0x84}, bail_);  // jz
+        emit({0x48, 0x83, 0xf9, 0xff});  // cmp rcx, -1
+        jump({0x0f, 0x85}, divide);      // jne
+        emit({0x48, 0xf7, 0xd8});        // neg rax
+        jump({0x0f, 0x80}, bail_);       // jo
+        jump({0xe9}, done);              // jmp
+        bind(divide);
+        emit({0x48, 0x99});         // cqo
+        emit({0x48, 0xf7, 0xf9});   // idiv rcx
+        emit({0x48, 0x85, 0xd2});   // test rdx, rdx
+        jump({0x0f, 0x85}, bail_);  // jnz
+        bind(done);
+        return;
+      }
+    }
+  }
+
+  float_operands(lhs, rhs);
+
+  switch (op) {
+    case symbol_add:
+      emit({0xf2, 0x0f, 0x58, 0xc1});  // addsd xmm0, xmm1
+      break;
+    case symbol_sub:
+      emit({0xf2, 0x0f, 0x5c, 0xc1});  // subsd xmm0, xmm1
+      break;
+    case symbol_mul:
+      emit({0xf2, 0x0f, 0x59, 0xc1});  // mulsd xmm0, xmm1
+      break;
+    default:
+      // a zero (or nan) divisor bails, the interpreter reports the former
+      emit({0x66, 0x0f, 0x57, 0xd2});  // xorpd xmm2, xmm2
+      emit({0x66, 0x0f, 0x2e, 0xca});  // ucomisd xmm1, xmm2
+      jump({0x0f, 0x84}, bail_);       // je
+      emit({0xf2, 0x0f, 0x5e, 0xc1});  // divsd xmm0, xmm1
+      break;
+  }
+
+  emit({0x66, 0x48, 0x0f, 0x7e, 0xc0});  // movq rax, xmm0
+}
+
+kind codegen::branch(const list_expr* list, bool tail) {
+  expr_span exprs = list->get_exprs();
+
+  if (exprs.size() < 3) {
+    throw unsupported();
+  }
+
+  label otherwise = new_label();
+  label done = new_label();
+
+  branch_unless(exprs[1], otherwise);
+  kind then_kind = expression(exprs[2], tail);
+  jump({0xe9}, done);  // jmp
+  bind(otherwise);
+
+  // no else branch is 0, as in the interpreter
+  kind else_kind = kind::int64;
+
+  if (exprs.size() > 3) {
+    else_kind = expression(exprs[3], tail);
+  } else {
+    emit({0x48, 0xb8});  // mov rax, 0
+    imm64(0);
+  }
+
+  bind(done);
+
+  if (then_kind != else_kind) {
+    throw unsupported();
+  }
+
+  return then_kind;
+}
+
+// comparisons are the only conditions, ints compare as ints and
+// anything else as doubles. ucomisd sets the flags like an unsigned
+// compare and unordered (a nan) as below and equal, which the jumps
+// chosen here all take to otherwise, so a comparison with nan is false
+void codegen::branch_unless(const expr* condition, label otherwise) {
+  auto list = expr_cast<list_expr>(condition);
+  expr_span exprs = list ? list->get_exprs() : expr_span();
+  auto head = exprs.empty() ? nullptr : expr_cast<symbol_expr>(exprs[0]);
+
+  if (!head || exprs.size() != 3) {
+    throw unsupported();
+  }
+
+  symbol_id op = head->get_id();
+
+  if (op != symbol_lt && op != symbol_gt && op != symbol_le &&
+      op != symbol_ge && op != symbol_eq) {
+    throw unsupported();
+  }
+
+  kind lhs = expression(exprs[1], false);
+  push_rax();
+  kind rhs = expression(exprs[2], false);
+  pop_operands();
+
+  if (lhs == kind::int64 && rhs == kind::int64) {
+    emit({0x48, 0x39, 0xc8});  // cmp rax, rcx
+
+    switch (op) {
+      case symbol_lt:
+        return jump({0x0f, 0x8d}, otherwise);  // jge
+      case symbol_gt:
+        return jump({0x0f, 0x8e}, otherwise);  // jle
+      case symbol_le:
+        return jump({0x0f, 0x8f}, otherwise);  // jg
+      case symbol_ge:
+        return jump({0x0f, 0x8c}, otherwise);  // jl
+      default:
+        return jump({0x0f, 0x85}, otherwise);  // jne
+    }
+  }
+
+  float_operands(lhs, rhs);
+
+  switch (op) {
+    case symbol_lt:                            // xmm1 above xmm0
+      emit({0x66, 0x0f, 0x2e, 0xc8});          // ucomisd xmm1, xmm0
+      return jump({0x0f, 0x86}, otherwise);    // jbe
+    case symbol_le:                            // xmm1 above or equal
+      emit({0x66, 0x0f, 0x2e, 0xc8});          // ucomisd xmm1, xmm0
+      return jump({0x0f, 0x82}, otherwise);    // jb
+    case symbol_gt:                            // xmm0 above xmm1
+      emit({0x66, 0x0f, 0x2e, 0xc1});          // ucomisd xmm0, xmm1
+      return jump({0x0f, 0x86}, otherwise);    // jbe
+    case symbol_ge:                            // xmm0 above or equal
+      emit({0x66, 0x0f, 0x2e, 0xc1});          // ucomisd xmm0, xmm1
+      return jump({0x0f, 0x82}, otherwise);    // jb
+    default:
+      emit({0x66, 0x0f, 0x2e, 0xc1});      // ucomisd xmm0, xmm1
+      jump({0x0f, 0x8a}, otherwise);       // jp
+      return jump({0x0f, 0x85}, otherwise);  // jne
+  }
+}
+
+// evaluates the arguments last to first onto the stack, so they end up
+// in order from rsp up. they have to be of the kinds compiled for
+void codegen::self_call_args(const call_expr* call) {
+  expr_span args = call->get_args();
+
+  if (call->get_id() != name_ || args.size() != arity_) {
+    throw unsupported();
+  }
+
+  for (std::size_t i = args.size(); i-- > 0;) {
+    if (expression(args[i], false) != param_kind(i)) {
+      throw unsupported();
+    }
+
+    push_rax();
+  }
+}
+
+// a tail call overwrites the parameters and jumps back to the body, any
+// other call passes the args and a result slot above them on the stack,
+// padded so that rsp is 16-byte aligned at the call
+kind codegen::self_call(const call_expr* call, bool tail) {
+  if (tail) {
+    self_call_args(call);
+
+    for (std::size_t i = 0; i < arity_; ++i) {
+      emit({0x58});              // pop rax
+      emit({0x48, 0x89, 0x85});  // mov [rbp + param(i)], rax
+      imm32(param(i));
+      depth_ -= 8;
+    }
+
+    jump({0xe9}, body_);  // jmp
+    return returns_;
+  }
+
+  std::size_t args_size = 8 * arity_;
+  std::size_t pad = (depth_ + 8 + args_size) % 16;
+  int32_t reserve = static_cast<int32_t>(pad + 8);
+
+  emit({0x48, 0x81, 0xec});  // sub rsp, pad + 8
+  imm32(reserve);
+  depth_ += reserve;
+
+  self_call_args(call);
+
+  emit({0x48, 0x8d, 0x3c, 0x24});  // lea rdi, [rsp]
+  emit({0x48, 0x8d, 0xb4, 0x24});  // lea rsi, [rsp + args_size]
+  imm32(static_cast<int32_t>(args_size));
+  emit({0xe8});  // call the function's own entry
+  imm32(-static_cast<int32_t>(code_.size() + 4));
+  emit({0x84, 0xc0});         // test al, al
+  jump({0x0f, 0x84}, bail_);  // jz
+  emit({0x48, 0x8b, 0x84, 0x24});  // mov rax, [rsp + args_size]
+  imm32(static_cast<int32_t>(args_size));
+  emit({0x48, 0x81, 0xc4});  // add rsp, everything pushed for the call
+  imm32(static_cast<int32_t>(args_size) + reserve);
+  depth_ -= args_size + reserve;
+
+  return returns_;
+}
+
+}  // namespace
+
+// the body is tried as returning the kind of its first parameter and
+// then the other kind, a self call's value being of the kind returned
+std::unique_ptr<jit_function> jit_function::compile(symbol_id name,
+                                                    std::size_t arity,
+                                                    const list_expr* body,
+                                                    uint32_t float_params) {
+  if (arity > max_params || body->get_exprs().size() != 1) {
+    return nullptr;
+  }
+
+  kind first = arity > 0 && float_params & 1 ? kind::float64 : kind::int64;
+  kind other = first == kind::int64 ? kind::float64 : kind::int64;
+  std::vector<uint8_t> code;
+
+  for (kind returns : {first, other}) {
+    try {
+      code = codegen(name, arity, float_params, returns)
+                 .function(body->get_exprs()[0]);
+    } catch (const unsupported&) {
+      continue;
+    }
+
+    std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::size_t size = (code.size() + page - 1) / page * page;
+    void* pages = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (pages == MAP_FAILED) {
+      return nullptr;
+    }
+
+    std::memcpy(pages, code.data(), code.size());
+
+    if (mprotect(pages, size, PROT_READ | PROT_EXEC) != 0) {
+      munmap(pages, size);
+      return nullptr;
+    }
+
+    return std::unique_ptr<jit_function>(new jit_function(
+        pages, size, float_params, returns == kind::float64));
+  }
+
+  return nullptr;
+}
+
+jit_function::~jit_function() { munmap(pages_, size_); }
+
+#else
+
+std::unique_ptr<jit_function> jit_function::compile(symbol_id, std::size_t,
+                                                    const list_expr*,
+                                                    uint32_t) {
+  return nullptr;
+}
+
+jit_function::~jit_function() {}
+
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "parser.h"
+
+// native x86-64 code for hot numeric functions of the interpreter. a
+// closure counts the times its body is entered, once it is hot it is
+// compiled for the kinds (int or float) of the arguments it was called
+// with and later calls with arguments of the same kinds run the native
+// code instead of walking the body.
+//
+// only bodies of a single expression built from parameters, number
+// literals, + - * /, ifs on comparisons and calls to the function itself
+// are compiled, anything else stays interpreted. such a body has no side
+// effects, so whenever the native code meets something it doesn't handle
+// the way the interpreter would (an int overflow or inexact quotient, a
+// div by zero, ...) it bails out and the whole call is simply rerun by
+// the interpreter, which then does whatever it does for that case.
+//
+// a self call in tail position is a jump, so tail recursion runs in
+// constant native stack as well. on other targets nothing is compiled
+
+class jit_function {
+ public:
+  static constexpr std::size_t max_params = 16;
+
+  // nullptr when the body can't be compiled. bit i of float_params is
+  // set when parameter i is a float, clear when it's an int. self calls
+  // are those to name, which the caller has to check still names this
+  // function whenever it runs the code
+  static std::unique_ptr<jit_function> compile(symbol_id name,
+                                               std::size_t arity,
+                                               const list_expr* body,
+                                               uint32_t float_params);
+
+  jit_function(const jit_function&) = delete;
+  jit_function& operator=(const jit_function&) = delete;
+  ~jit_function();
+
+  uint32_t float_params() const { return float_params_; }
+  bool returns_float() const { return returns_float_; }
+
+  // args are ints or the bits of doubles as given by float_params, the
+  // result is stored likewise. false when the code bailed out
+  bool run(const uint64_t* args, uint64_t* result) const {
+    return entry_(args, result);
+  }
+
+ private:
+  using entry = bool (*)(const uint64_t* args, uint64_t* result);
+
+  jit_function(void* pages, std::size_t size, uint32_t float_params,
+               bool returns_float)
+      : pages_(pages),
+        size_(size),
+        entry_(reinterpret_cast<entry>(pages)),
+        float_params_(float_params),
+        returns_float_(returns_float) {}
+
+  void* pages_;  // executable, unmapped with the function
+  std::size_t size_;
+  entry entry_;
+  uint32_t float_params_;
+  bool returns_float_;
+};
+
+#endif  // JIT_H
@@ -1,6 +1,8 @@
 #include "./lexer.h"
 
-std::vector<token> tokenize(const std::string& source) {
+#include "./scan.h"
+
+std::vector<token> tokenize(std::string_view source) {
   lexer lex(source);
   std::vector<token> tokens;
 
@@ -11,19 +13,17 @@ std::vector<token> tokenize(const std::string& source) {
     tok = lex.next_token();
   }
 
-  // @todo: fix this insertion issue
-  tokens.insert(tokens.begin(), token{token_type::token_left_paren, "("});
-
   return tokens;
 }
 
 token_type token::get_type() const { return type_; }
 
-std::string token::get_value() const { return value_; }
+std::string_view token::get_value() const { return value_; }
 
-lexer::lexer(const std::string& source) : source_(source), current_pos_(0) {
-  eat();
-}
+symbol_id token::get_symbol() const { return symbol_; }
+
+lexer::lexer(std::string_view source, bool partial)
+    : source_(source), current_pos_(0), partial_(partial) {}
 
 token lexer::next_token() {
   skip_whitespace();
@@ -33,52 +33,50 @@ token lexer::next_token() {
   }
 
   char current = current_char();
+  std::size_t start_pos = current_pos_;
 
   if (current == '(') {
     eat();
-    return token(token_type::token_left_paren, "(");
+    return token(token_type::token_left_paren, source_.substr(start_pos, 1));
   } else if (current == ')') {
     eat();
-    return token(token_type::token_right_paren, ")");
-  } else if (std::isdigit(current) ||
-             (current == '.' && std::isdigit(peek_char()))) {
+    return token(token_type::token_right_paren, source_.substr(start_pos, 1));
+  } else if (truncated(start_pos + 1) && (current == '.' || current == '#')) {
+    return incomplete(start_pos);  // can't tell what follows yet
+  } else if (is_char_class(current, char_digit) ||
+             (current == '.' && is_char_class(peek_char(), char_digit))) {
     return number();
-  } else if (std::isalpha(current) || current == '_' || current_char() == '_' ||
-             current_char() == '+' || current_char() == '-' ||
-             current_char() == '*' || current_char() == '/' ||
-             current_char() == '=') {
+  } else if (is_char_class(current, char_symbol_start)) {
     return symbol();
   } else if (current == '#' && (peek_char() == 't' || peek_char() == 'f')) {
     return boolean();
   } else if (current == '"') {
     return string_literal();
   } else {
-    throw std::runtime_error("Unexpected character: " +
-                             std::string(1, current));
+    throw syntax_error("Unexpected character: " + std::string(1, current),
+                       source_.data() + start_pos);
   }
 }
 
 token lexer::number() {
-  std::string value;
-  bool is_float = false;
-
-  while (current_pos_ < source_.size() &&
-         (std::isdigit(current_char()) || current_char() == '.')) {
-    if (current_char() == '.') {
-      if (is_float) {  // ensure there's only one decimal point
-        throw std::runtime_error("Multiple decimal points found in a number.");
-      }
+  std::size_t start_pos = current_pos_;
+  std::string_view value = source_.substr(start_pos, advance(scan_number));
 
-      is_float = true;
-    }
+  if (truncated(current_pos_)) {
+    return incomplete(start_pos);
+  }
 
-    value += current_char();
+  std::size_t dot = value.find('.');
+  bool is_float = dot != std::string_view::npos;
 
-    eat();
+  // ensure there's only one decimal point
+  if (is_float && value.find('.', dot + 1) != std::string_view::npos) {
+    throw syntax_error("Multiple decimal points found in a number.",
+                       value.data());
   }
 
-  if (value == "." || (value.find('.') == 0 && value.length() == 1)) {
-    throw std::runtime_error("Invalid numeric format.");
+  if (value == ".") {
+    throw syntax_error("Invalid numeric format.", value.data());
   }
 
   return is_float ? token(token_type::token_float, value)
@@ -86,42 +84,41 @@ token lexer::number() {
 }
 
 token lexer::boolean() {
-  std::string value;
+  std::size_t start_pos = current_pos_;
 
   eat();  // skip the '#'
 
-  if (current_char() == 't') {
-    value = "#t";
-  } else if (current_char() == 'f') {
-    value = "#f";
-  } else {
-    throw std::runtime_error("unexpected boolean value");
+  if (current_char() != 't' && current_char() != 'f') {
+    throw syntax_error("unexpected boolean value", source_.data() + start_pos);
   }
 
   eat();  // skip the 't' or 'f'
 
-  return token(token_type::token_boolean, value);
+  return token(token_type::token_boolean, source_.substr(start_pos, 2));
 }
 
 token lexer::string_literal() {
-  std::string value;
   eat();  // skip the opening '"'
+  std::size_t start_pos = current_pos_;
+  std::string_view value = source_.substr(start_pos, advance(scan_string));
 
-  while (current_pos_ < source_.size() && current_char() != '"') {
-    value += current_char();
-    eat();
+  if (truncated(current_pos_)) {
+    return incomplete(start_pos - 1);
   }
 
-  if (current_char() == '"') {
-    eat();  // skip the closing '"'
-  } else {
-    throw std::runtime_error("unclosed string literal");
+  if (current_pos_ >= source_.size()) {
+    throw syntax_error("unclosed string literal", value.data() - 1);
   }
 
+  eat();  // skip the closing '"'
+
   return token(token_type::token_string_literal, value);
 }
 
-char lexer::current_char() const { return source_[current_pos_]; }
+char lexer::current_char() const {
+  // unlike std::string, a view has no terminating null to fall back on
+  return current_pos_ < source_.size() ? source_[current_pos_] : '\0';
+}
 
 char lexer::peek_char() const {
   if (current_pos_ + 1 < source_.size()) {
@@ -137,12 +134,15 @@ void lexer::eat() {
   }
 }
 
-void lexer::skip_whitespace() {
-  while (current_pos_ < source_.size() && std::isspace(current_char())) {
-    eat();
-  }
+std::size_t lexer::advance(std::size_t (*scanner)(const char*, std::size_t)) {
+  std::size_t length =
+      scanner(source_.data() + current_pos_, source_.size() - current_pos_);
+  current_pos_ += length;
+  return length;
 }
 
+void lexer::skip_whitespace() { advance(scan_whitespace); }
+
 // token lexer::number() {
 //   std::size_t start_pos = current_pos_;
 
@@ -156,26 +156,81 @@ void lexer::skip_whitespace() {
 
 token lexer::symbol() {
   std::size_t start_pos = current_pos_;
-  std::string value;
-
-  while (current_pos_ < source_.size() &&
-         (std::isalnum(current_char()) || current_char() == '_' ||
-          current_char() == '+' || current_char() == '-' ||
-          current_char() == '*' || current_char() == '/' ||
-          current_char() == '=')) {
-    value += current_char();
-    eat();
+  std::string_view value = source_.substr(start_pos, advance(scan_symbol));
+
+  if (truncated(current_pos_)) {
+    return incomplete(start_pos);
   }
 
-  while (current_pos_ < source_.size() &&
-         (std::isalnum(current_char()) || current_char() == '_')) {
-    eat();
+  return token(token_type::token_symbol, value, intern(value));
+}
+
+// a run that reaches the end of a partial window may continue in the
+// next one, even when it happens to end exactly on the boundary
+
+bool lexer::truncated(std::size_t end) const {
+  return partial_ && end >= source_.size();
+}
+
+token lexer::incomplete(std::size_t start_pos) {
+  current_pos_ = start_pos;
+  return token(token_type::token_end_of_file, "");
+}
+
+chunked_lexer::chunked_lexer(const std::string& file_path,
+                             std::size_t chunk_size)
+    : file_(file_path, std::ios::binary),
+      chunk_size_(chunk_size),
+      consumed_(0),
+      eof_(false) {
+  if (!file_) {
+    throw std::runtime_error("file not found: " + file_path);
+  }
+
+  refill();
+}
+
+token chunked_lexer::next() {
+  for (;;) {
+    std::string_view window = std::string_view(buffer_).substr(consumed_);
+    lexer lex(window, !eof_);
+    token tok = lex.next_token();
+
+    consumed_ += lex.position();
+
+    if (tok.get_type() != token_type::token_end_of_file || eof_) {
+      return tok;
+    }
+
+    refill();
+  }
+}
+
+// drops everything already lexed and appends the next chunk after the
+// unconsumed tail, which is at most one partially read token
+
+void chunked_lexer::refill() {
+  buffer_.erase(0, consumed_);
+  consumed_ = 0;
+
+  std::size_t tail = buffer_.size();
+  buffer_.resize(tail + chunk_size_);
+  file_.read(buffer_.data() + tail, chunk_size_);
+
+  std::size_t read = static_cast<std::size_t>(file_.gcount());
+  buffer_.resize(tail + read);
+
+  if (read == 0) {
+    eof_ = true;
+  }
+}
+
+token vector_token_stream::next() {
+  if (current_pos_ < tokens_.size()) {
+    return tokens_[current_pos_++];
   }
 
-  return value.length()
-             ? token(token_type::token_symbol, value)
-             : token(token_type::token_symbol,
-                     source_.substr(start_pos, current_pos_ - start_pos));
+  return token(token_type::token_end_of_file, "");
 }
 
 std::ostream& operator<<(std::ostream& os, token_type type) {
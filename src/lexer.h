@@ -3,11 +3,15 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "symbol.h"
+
 enum class token_type {
   token_integer,
   token_float,
@@ -19,39 +23,115 @@ enum class token_type {
   token_end_of_file
 };
 
+// raised by the lexer and parser, where() points at the offending text
+// in the source that was being lexed (or is null if there is none)
+
+class syntax_error : public std::runtime_error {
+ public:
+  syntax_error(const std::string& message, const char* where)
+      : std::runtime_error(message), where_(where) {}
+  const char* where() const { return where_; }
+
+ private:
+  const char* where_;
+};
+
+// tokens do not own their text, the value is a slice of the source
+// handed to the lexer (or a static literal), so the source must stay
+// alive for as long as its tokens are in use. symbols are interned as
+// they are lexed and carry their id alongside the text
+
 class token {
  public:
-  token(token_type type, const std::string& value)
-      : type_(type), value_(value) {}
+  token(token_type type, std::string_view value, symbol_id symbol = 0)
+      : type_(type), symbol_(symbol), value_(value) {}
   token_type get_type() const;
-  std::string get_value() const;
+  std::string_view get_value() const;
+  symbol_id get_symbol() const;
 
  private:
   token_type type_;
-  std::string value_;
+  symbol_id symbol_;
+  std::string_view value_;
 };
 
-class lexer {
+// pull-based source of tokens for the parser, next() keeps returning
+// token_end_of_file once the input is exhausted. a returned token is
+// only guaranteed to stay valid until the following call to next()
+
+class token_stream {
  public:
-  explicit lexer(const std::string& source);
+  virtual ~token_stream() = default;
+  virtual token next() = 0;
+};
+
+// a partial lexer works over a window that more input may follow, so
+// instead of failing on a token that runs into the end of the window
+// it rewinds to the start of that token and reports end_of_file
+
+class lexer : public token_stream {
+ public:
+  explicit lexer(std::string_view source, bool partial = false);
   token next_token();
+  token next() override { return next_token(); }
+
+  std::size_t position() const { return current_pos_; }
 
  private:
-  std::string source_;
+  std::string_view source_;
   std::size_t current_pos_;
+  bool partial_;
+
+  bool truncated(std::size_t end) const;
+  token incomplete(std::size_t start_pos);
 
   void eat();
   char peek_char() const;
   char current_char() const;
   void skip_whitespace();
 
+  // consumes the run matched by one of the scanners in scan.h and
+  // returns its length
+  std::size_t advance(std::size_t (*scanner)(const char*, std::size_t));
+
   token symbol();
   token string_literal();
   token boolean();
   token number();
 };
 
-std::vector<token> tokenize(const std::string& source);
+// reads a file in fixed-size chunks so memory is bounded by the chunk
+// size (or the longest single token) rather than the file, tokens that
+// straddle a chunk boundary are carried over into the next window
+
+class chunked_lexer : public token_stream {
+ public:
+  explicit chunked_lexer(const std::string& file_path,
+                         std::size_t chunk_size = 1 << 16);
+  token next() override;
+
+ private:
+  std::ifstream file_;
+  std::string buffer_;
+  std::size_t chunk_size_;
+  std::size_t consumed_;
+  bool eof_;
+
+  void refill();
+};
+
+class vector_token_stream : public token_stream {
+ public:
+  explicit vector_token_stream(const std::vector<token>& tokens)
+      : tokens_(tokens), current_pos_(0) {}
+  token next() override;
+
+ private:
+  const std::vector<token>& tokens_;
+  std::size_t current_pos_;
+};
+
+std::vector<token> tokenize(std::string_view source);
 std::ostream& operator<<(std::ostream& os, token_type type);
 
 #endif  // LEXER_H
@@ -0,0 +1,198 @@
+#include "./lists.h"
+
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "./arrays.h"
+#include "./error.h"
+#include "./gc.h"
+#include "./persistent.h"
+
+namespace {
+
+// a function of the runtime, taking its arguments as they are on the
+// value stack
+class primitive final : public callable {
+ public:
+  explicit primitive(const primitive_def& def) : def_(def) {}
+
+  expr_value operator()(eval_context& ctx, std::size_t argc) override {
+    if (argc < def_.min_args || argc > def_.max_args) {
+      throw eval_error("argument count does not match parameter count");
+    }
+
+    return def_.function(ctx, ctx.stack.data() + (ctx.stack_top - argc),
+                         argc);
+  }
+
+ private:
+  primitive_def def_;
+};
+
+const gc_pair* pair_of(const expr_value& value, const char* op) {
+  auto pair =
+      value.is_object() ? dynamic_cast<gc_pair*>(value.as_object()) : nullptr;
+
+  if (!pair) {
+    invalid_type(op);
+  }
+
+  return pair;
+}
+
+gc_vector* vector_of(const expr_value& value, const char* op) {
+  auto vector =
+      value.is_object() ? dynamic_cast<gc_vector*>(value.as_object()) : nullptr;
+
+  if (!vector) {
+    invalid_type(op);
+  }
+
+  return vector;
+}
+
+std::size_t index_of(const gc_vector* vector, const expr_value& value,
+                     const char* op) {
+  if (!value.is_int()) {
+    invalid_type(op);
+  }
+
+  int64_t i = value.as_int();
+
+  if (i < 0 || static_cast<uint64_t>(i) >= vector->length()) {
+    throw eval_error(std::string("index out of range for ") + op);
+  }
+
+  return static_cast<std::size_t>(i);
+}
+
+bool is_list(const expr_value& value) {
+  return value.is_empty_list() ||
+         (value.is_object() && dynamic_cast<gc_pair*>(value.as_object()));
+}
+
+expr_value list(eval_context& ctx, const expr_value* args, std::size_t argc) {
+  expr_value result = expr_value::empty_list();
+
+  for (std::size_t i = argc; i-- > 0;) {
+    result = ctx.heap.make<gc_pair>(args[i], result);
+  }
+
+  return result;
+}
+
+expr_value cons(eval_context& ctx, const expr_value* args, std::size_t) {
+  if (!is_list(args[1])) {
+    invalid_type("cons");
+  }
+
+  return ctx.heap.make<gc_pair>(args[0], args[1]);
+}
+
+expr_value car(eval_context&, const expr_value* args, std::size_t) {
+  return pair_of(args[0], "car")->head;
+}
+
+expr_value cdr(eval_context&, const expr_value* args, std::size_t) {
+  return pair_of(args[0], "cdr")->tail;
+}
+
+expr_value is_empty(eval_context&, const expr_value* args, std::size_t) {
+  if (!is_list(args[0])) {
+    invalid_type("is_empty");
+  }
+
+  return args[0].is_empty_list();
+}
+
+expr_value vec(eval_context& ctx, const expr_value* args, std::size_t argc) {
+  return ctx.heap.make<gc_vector>(std::vector<expr_value>(args, args + argc));
+}
+
+expr_value vec_get(eval_context&, const expr_value* args, std::size_t) {
+  const gc_vector* vector = vector_of(args[0], "vec_get");
+  return (*vector)[index_of(vector, args[1], "vec_get")];
+}
+
+expr_value vec_set(eval_context& ctx, const expr_value* args, std::size_t) {
+  gc_vector* vector = vector_of(args[0], "vec_set");
+  ctx.heap.store(vector, index_of(vector, args[1], "vec_set"), args[2]);
+  return args[2];
+}
+
+expr_value vec_push(eval_context& ctx, const expr_value* args, std::size_t) {
+  ctx.heap.append(vector_of(args[0], "vec_push"), args[1]);
+  return args[1];
+}
+
+expr_value length(eval_context&, const expr_value* args, std::size_t) {
+  if (args[0].is_object()) {
+    gc_object* object = args[0].as_object();
+
+    if (auto vector = dynamic_cast<gc_vector*>(object)) {
+      return static_cast<int64_t>(vector->length());
+    }
+
+    if (auto map = dynamic_cast<gc_map*>(object)) {
+      return static_cast<int64_t>(map->count());
+    }
+
+    if (auto vector = dynamic_cast<gc_pvec*>(object)) {
+      return static_cast<int64_t>(vector->count());
+    }
+
+    if (auto array = dynamic_cast<gc_array*>(object)) {
+      return static_cast<int64_t>(array->length());
+    }
+  }
+
+  if (!is_list(args[0])) {
+    invalid_type("length");
+  }
+
+  int64_t count = 0;
+
+  for (expr_value rest = args[0]; !rest.is_empty_list(); ++count) {
+    rest = static_cast<const gc_pair*>(rest.as_object())->tail;
+  }
+
+  return count;
+}
+
+expr_value gc(eval_context& ctx, const expr_value*, std::size_t) {
+  ctx.heap.collect(ctx.globals, ctx.stack, ctx.stack_top, true);
+  return {};
+}
+
+}  // namespace
+
+void invalid_type(const char* op) {
+  throw eval_error(std::string("invalid type for ") + op);
+}
+
+bool is_primitive(const expr_value& function) {
+  return function.is_callable() &&
+         dynamic_cast<const primitive*>(function.as_callable());
+}
+
+void define_primitives(eval_context& ctx, const primitive_def* defs,
+                       std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    ctx.fmap.insert_or_assign(intern(defs[i].name),
+                              expr_value(new primitive(defs[i])));
+  }
+}
+
+void define_list_functions(eval_context& ctx) {
+  static const primitive_def functions[] = {
+      {"list", 0, any_args, list},      {"cons", 2, 2, cons},
+      {"car", 1, 1, car},               {"cdr", 1, 1, cdr},
+      {"is_empty", 1, 1, is_empty},     {"vec", 0, any_args, vec},
+      {"vec_get", 2, 2, vec_get},       {"vec_set", 3, 3, vec_set},
+      {"vec_push", 2, 2, vec_push},     {"length", 1, 1, length},
+      {"gc", 0, 0, gc},
+  };
+
+  define_primitives(ctx, functions, std::size(functions));
+}
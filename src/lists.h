@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef LISTS_H
+#define LISTS_H
+
+#include <cstddef>
+
+#include "interp.h"
+
+// the functions on lists and vectors (see gc.h) every eval_context
+// starts out with. like any function they can be redefined by fun
+//
+//   (list a ..)       a list of the arguments, (list) is the empty list
+//   (cons x l)        the list of x followed by the elements of l
+//   (car l)           the first element of a non-empty list
+//   (cdr l)           the rest of a non-empty list
+//   (is_empty l)      whether l is the empty list
+//   (vec a ..)        a vector of the arguments
+//   (vec_get v i)     element i of a vector
+//   (vec_set v i x)   replaces element i with x, gives x
+//   (vec_push v x)    appends x, gives x
+//   (length x)        of a list or a vector (or see persistent.h, arrays.h)
+//   (gc)              runs a full collection
+
+void define_list_functions(eval_context& ctx);
+
+// functions of the runtime (like the ones above) take their arguments
+// as they are on the value stack, after the count has been checked
+
+using primitive_fn = expr_value (*)(eval_context& ctx,
+                                    const expr_value* args,
+                                    std::size_t argc);
+
+constexpr std::size_t any_args = ~std::size_t(0);
+
+struct primitive_def {
+  const char* name;
+  std::size_t min_args;
+  std::size_t max_args;  // any_args for no limit
+  primitive_fn function;
+};
+
+void define_primitives(eval_context& ctx, const primitive_def* defs,
+                       std::size_t count);
+
+[[noreturn]] void invalid_type(const char* op);
+
+// whether function is one defined by define_primitives
+bool is_primitive(const expr_value& function);
+
+#endif  // LISTS_H
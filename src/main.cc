@@ -1,50 +1,244 @@
-#include <fstream>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "./ast_cache.h"
 #include "./emit.h"
 #include "./interp.h"
 #include "./lexer.h"
+#include "./optimizer.h"
 #include "./parser.h"
+#include "./source.h"
+#include "./vm.h"
 
-void compile(const std::string& source);
+// programs run on the tree-walking interpreter unless --vm is given, in
+// which case each top-level form is compiled to bytecode and run instead
 
-std::string read_file(const std::string& file_path) {
-  std::ifstream file(file_path);
+bool use_vm = false;
 
-  if (!file) {
-    throw std::runtime_error("file not found: " + file_path);
-  }
+// trees are optimized (see optimizer.h) before they run, --dump writes
+// the optimized forms to stdout instead of running them
+bool dump_tree = false;
 
-  return std::string((std::istreambuf_iterator<char>(file)),
-                     std::istreambuf_iterator<char>());
-}
+// --stats reports the interpreter's call site cache hits and misses,
+// what the jit did and the collector's pauses and heap size on stderr
+// once the program has run
+bool show_stats = false;
+
+// --no-jit keeps the interpreter from compiling hot functions to native
+// code (see jit.h)
+bool use_jit = true;
+
+class engine {
+ public:
+  engine() { ctx_.jit = use_jit; }
+  ~engine();
+
+  void eval_form(const std::shared_ptr<const ast>& parsed);
+  void eval_program(const std::shared_ptr<const ast>& parsed);
+  void finish();
+
+ private:
+  eval_context ctx_;
+  interp interp_;
+  vm vm_;
+
+  // the vm binds names itself, they are resolved all the same so that
+  // either engine rejects the same names at the same point
+  resolver vm_names_;
+
+  void run(const std::shared_ptr<const ast>& form);  // optimized
+};
+
+// on a cache miss the forms of a file up to this size are kept as they
+// run and stored once all of them have, larger files stream as they do
+// with the cache off so memory stays bounded by the largest form
+constexpr std::size_t max_cached_source = 64 << 20;
+
+void compile(token_stream& tokens,
+             std::vector<std::shared_ptr<const ast>>* kept = nullptr);
+void compile_cached(std::string_view source, const std::string& cache_path);
 
 void argparse(int argc, char const* argv[]) {
   std::unordered_map<std::string, std::function<void(const std::string&)>>
-      actions = {{"-c", [](const std::string& file_path) {
-                    compile(read_file(file_path));
+      actions = {{"-c",
+                  [](const std::string& file_path) {
+                    // the mapping has to outlive the tokens sliced from it
+                    source_buffer source = source_buffer::map_file(file_path);
+                    std::string cache_path = ast_cache_path(source.view());
+
+                    if (cache_path.empty()) {
+                      lexer tokens(source.view());
+                      compile(tokens);
+                      return;
+                    }
+
+                    compile_cached(source.view(), cache_path);
+                  }},
+                 {"-s",
+                  [](const std::string& file_path) {
+                    // for pipes and inputs too large to map, reads the
+                    // file in fixed-size chunks instead
+                    chunked_lexer tokens(file_path);
+                    compile(tokens);
+                  }},
+                 {"-p", [](const std::string& file_path) {
+                    // lexes and parses the whole file on all cores first,
+                    // then evaluates the forms in order
+                    source_buffer source = source_buffer::map_file(file_path);
+                    engine().eval_program(parse_parallel(source.view()));
                   }}};
 
   for (int i = 1; i < argc; ++i) {
     std::string arg = argv[i];
 
-    if (actions.find(arg) != actions.end() && i + 1 < argc) {
+    if (arg == "--vm") {
+      use_vm = true;
+    } else if (arg == "--stats") {
+      show_stats = true;
+    } else if (arg == "--no-jit") {
+      use_jit = false;
+    } else if (arg == "--dump") {
+      dump_tree = true;
+    } else if (actions.find(arg) != actions.end() && i + 1 < argc) {
       actions[arg](argv[++i]);
     }
   }
 }
 
-void compile(const std::string& source) {
-  std::vector<token> tokens = tokenize(source);
-  const std::shared_ptr<expr>& expr_tree = parser(tokens).parse();
-  eval_context ctx;
-  interp().eval(ctx, expr_tree);
+// each top-level form is evaluated as soon as it is parsed and then
+// released, so peak memory follows the largest form and not the file
+
+void compile(token_stream& tokens,
+             std::vector<std::shared_ptr<const ast>>* kept) {
+  parser forms(tokens);
+  engine program;
+
+  while (auto form = forms.parse_next()) {
+    program.eval_form(form);
+
+    if (kept) {
+      kept->push_back(std::move(form));
+    }
+  }
+
+  program.finish();
+}
+
+// a cached tree skips lexing and parsing altogether, its forms are then
+// evaluated one at a time as compile() does. a miss compiles the file
+// as usual, so a syntax error is reported (and the forms before it run)
+// the same way with the cache on or off, and only a file that parsed
+// and ran to the end is stored
+
+void compile_cached(std::string_view source, const std::string& cache_path) {
+  if (std::shared_ptr<const ast> tree = load_ast_cache(cache_path, source)) {
+    engine program;
+
+    for (const expr* form : expr_cast<list_expr>(tree->root)->get_exprs()) {
+      auto single = std::make_shared<ast>();
+      single->root = form;
+      single->depends_on.push_back(tree);
+      program.eval_form(single);
+    }
+
+    program.finish();
+    return;
+  }
+
+  lexer tokens(source);
+
+  if (source.size() > max_cached_source) {
+    compile(tokens);
+    return;
+  }
+
+  std::vector<std::shared_ptr<const ast>> kept;
+  compile(tokens, &kept);
+
+  // the program only holds the list of forms, which stay in their trees
+  ast program;
+  std::vector<const expr*> forms;
+
+  for (const auto& form : kept) {
+    forms.push_back(form->root);
+  }
+
+  const expr* const* children =
+      program.arena.copy_array(forms.data(), forms.size());
+  program.root =
+      program.arena.make<list_expr>(expr_span(children, forms.size()));
+  store_ast_cache(cache_path, source, program);
+}
+
+engine::~engine() {
+  if (show_stats && !use_vm) {
+    std::cerr << "call cache: " << ctx_.call_hits << " hits, "
+              << ctx_.call_misses << " misses" << std::endl;
+    std::cerr << "jit: " << ctx_.jit_compiled << " compiled, "
+              << ctx_.jit_runs << " native calls, " << ctx_.jit_bails
+              << " bailouts" << std::endl;
+
+    const gc_stats& gc = ctx_.heap.stats();
+    std::cerr << "gc: " << gc.minor_collections << " minor, "
+              << gc.major_collections << " major collections, pauses "
+              << gc.max_pause * 1e3 << " ms max, " << gc.total_pause * 1e3
+              << " ms total, heap " << gc.heap_bytes << " bytes in "
+              << gc.objects << " objects" << std::endl;
+  }
+}
+
+void engine::eval_form(const std::shared_ptr<const ast>& parsed) {
+  run(optimize(parsed, false));
+}
+
+void engine::run(const std::shared_ptr<const ast>& form) {
+  if (dump_tree) {
+    write_source(std::cout, form->root);
+    std::cout << std::endl;
+  } else if (use_vm) {
+    vm_names_.resolve(form);
+    vm_.eval(form->root);
+  } else {
+    interp_.eval(ctx_, form);
+  }
+}
+
+void engine::finish() {
+  if (use_vm) {
+    vm_names_.finish();
+  } else {
+    interp_.finish(ctx_);
+  }
+}
+
+// the program is optimized as a whole, then its forms run one at a time
+// as with -c: a name is resolved when the form using it runs, and the
+// forms before an error have run
+
+void engine::eval_program(const std::shared_ptr<const ast>& parsed) {
+  std::shared_ptr<const ast> program = optimize(parsed, true);
+
+  for (const expr* form : expr_cast<list_expr>(program->root)->get_exprs()) {
+    auto single = std::make_shared<ast>();
+    single->root = form;
+    single->depends_on.push_back(program);
+    run(single);
+  }
+
+  finish();
 }
 
 int main(int argc, char const* argv[]) {
-  argparse(argc, argv);
+  try {
+    argparse(argc, argv);
+  } catch (const std::exception& error) {
+    std::cerr << "error: " << error.what() << std::endl;
+    return 1;
+  }
+
   return 0;
 }
@@ -0,0 +1,430 @@
+#include "./optimizer.h"
+
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "./arith.h"
+
+namespace {
+
+bool is_literal(const expr* node) {
+  switch (node->kind()) {
+    case expr_kind::integer:
+    case expr_kind::floating:
+    case expr_kind::boolean:
+    case expr_kind::string:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// a literal number as evaluation holds it
+struct number {
+  bool is_int;
+  int64_t i;
+  double d;
+
+  double as_double() const { return is_int ? static_cast<double>(i) : d; }
+};
+
+std::optional<number> literal_number(const expr* node) {
+  if (auto integer = expr_cast<integer_expr>(node)) {
+    return number{true, integer->get_value(), 0};
+  }
+
+  if (auto floating = expr_cast<float_expr>(node)) {
+    return number{false, 0, floating->get_value()};
+  }
+
+  return std::nullopt;
+}
+
+// the fold of the interpreter's accumulators, nothing when evaluating it
+// would be an error
+template <typename Op>
+std::optional<number> fold(number acc, const std::vector<number>& operands,
+                           bool divides) {
+  for (const number& operand : operands) {
+    if (divides && operand.as_double() == 0) {
+      return std::nullopt;
+    }
+
+    if (acc.is_int && operand.is_int) {
+      int64_t out;
+
+      switch (Op::ints(acc.i, operand.i, &out)) {
+        case int_step::ok:
+          acc.i = out;
+          continue;
+        case int_step::overflow:
+          return std::nullopt;
+        case int_step::inexact:
+          break;
+      }
+    }
+
+    acc = number{false, 0, Op::floats(acc.as_double(), operand.as_double())};
+  }
+
+  return acc;
+}
+
+template <typename T>
+bool compare(symbol_id op, T a, T b) {
+  switch (op) {
+    case symbol_lt:
+      return a < b;
+    case symbol_gt:
+      return a > b;
+    case symbol_le:
+      return a <= b;
+    case symbol_ge:
+      return a >= b;
+    default:
+      return a == b;
+  }
+}
+
+class tree_optimizer {
+ public:
+  explicit tree_optimizer(ast_arena& arena) : arena_(arena) {}
+
+  // notes the defs and sets in a top-level form of a whole program,
+  // before any form is rewritten
+  void scan(const expr* node, bool top_level);
+
+  // rewrites a top-level form of a whole program, a def in it may make
+  // its global a constant for the forms after it
+  const expr* rewrite_form(const expr* node);
+
+  const expr* rewrite(const expr* node);
+
+ private:
+  ast_arena& arena_;
+
+  std::unordered_map<symbol_id, int> defs_;  // top-level defs of each name
+  std::unordered_set<symbol_id> assigned_;   // set, or def'd in a form
+  std::unordered_map<symbol_id, const expr*> constants_;
+
+  // parameters of the functions being rewritten, which shadow globals
+  std::vector<std::vector<symbol_id>> scopes_;
+
+  bool shadowed(symbol_id name) const;
+  const expr* rewrite_fun(const list_expr* list);
+  const expr* rewrite_if(const list_expr* list,
+                         std::vector<const expr*>& children);
+  const expr* fold_arith(symbol_id op, const std::vector<const expr*>& args);
+  const expr* fold_compare(symbol_id op,
+                           const std::vector<const expr*>& args);
+  const expr* rebuild(const list_expr* list,
+                      const std::vector<const expr*>& children);
+};
+
+void tree_optimizer::scan(const expr* node, bool top_level) {
+  auto list = expr_cast<list_expr>(node);
+
+  if (!list || list->get_exprs().empty()) {
+    return;
+  }
+
+  expr_span exprs = list->get_exprs();
+  auto head = expr_cast<symbol_expr>(exprs[0]);
+  auto name = exprs.size() > 1 ? expr_cast<symbol_expr>(exprs[1]) : nullptr;
+
+  if (head && name && head->get_id() == symbol_def) {
+    if (top_level) {
+      ++defs_[name->get_id()];
+    } else {
+      assigned_.insert(name->get_id());
+    }
+  }
+
+  if (head && name && head->get_id() == symbol_set) {
+    assigned_.insert(name->get_id());
+  }
+
+  for (const expr* child : exprs) {
+    scan(child, false);
+  }
+}
+
+const expr* tree_optimizer::rewrite_form(const expr* node) {
+  const expr* rewritten = rewrite(node);
+  auto list = expr_cast<list_expr>(rewritten);
+
+  if (!list || list->get_exprs().size() != 3) {
+    return rewritten;
+  }
+
+  expr_span exprs = list->get_exprs();
+  auto head = expr_cast<symbol_expr>(exprs[0]);
+  auto name = expr_cast<symbol_expr>(exprs[1]);
+
+  if (head && name && head->get_id() == symbol_def && is_literal(exprs[2]) &&
+      defs_[name->get_id()] == 1 && !assigned_.count(name->get_id())) {
+    constants_[name->get_id()] = exprs[2];
+  }
+
+  return rewritten;
+}
+
+bool tree_optimizer::shadowed(symbol_id name) const {
+  return std::any_of(scopes_.begin(), scopes_.end(), [name](const auto& scope) {
+    return std::find(scope.begin(), scope.end(), name) != scope.end();
+  });
+}
+
+const expr* tree_optimizer::rewrite(const expr* node) {
+  if (auto symbol = expr_cast<symbol_expr>(node)) {
+    auto it = constants_.find(symbol->get_id());
+    return it != constants_.end() && !shadowed(symbol->get_id()) ? it->second
+                                                                 : node;
+  }
+
+  auto list = expr_cast<list_expr>(node);
+
+  if (!list || list->get_exprs().empty()) {
+    return node;
+  }
+
+  expr_span exprs = list->get_exprs();
+  std::vector<const expr*> children(exprs.begin(), exprs.end());
+  auto head = expr_cast<symbol_expr>(exprs[0]);
+
+  if (!head) {
+    for (auto& child : children) {
+      child = rewrite(child);
+    }
+
+    return rebuild(list, children);
+  }
+
+  // the head stays, as does the name def and set assign to
+  symbol_id op = head->get_id();
+  std::size_t first = (op == symbol_def || op == symbol_set) ? 2 : 1;
+
+  if (op == symbol_fun) {
+    return rewrite_fun(list);
+  }
+
+  for (std::size_t i = first; i < children.size(); ++i) {
+    children[i] = rewrite(children[i]);
+  }
+
+  std::vector<const expr*> args(children.begin() + 1, children.end());
+  const expr* folded = nullptr;
+
+  switch (op) {
+    case symbol_if:
+      return rewrite_if(list, children);
+    case symbol_add:
+    case symbol_sub:
+    case symbol_mul:
+    case symbol_div:
+      folded = fold_arith(op, args);
+      break;
+    case symbol_lt:
+    case symbol_gt:
+    case symbol_le:
+    case symbol_ge:
+    case symbol_eq:
+      folded = fold_compare(op, args);
+      break;
+  }
+
+  return folded ? folded : rebuild(list, children);
+}
+
+// only the body statements are rewritten, in a scope of their own.
+// anything malformed is left for evaluation to report
+const expr* tree_optimizer::rewrite_fun(const list_expr* list) {
+  expr_span exprs = list->get_exprs();
+  auto params = exprs.size() > 3 ? expr_cast<list_expr>(exprs[2]) : nullptr;
+  auto body = exprs.size() > 3 ? expr_cast<list_expr>(exprs[3]) : nullptr;
+
+  if (!params || !body) {
+    return list;
+  }
+
+  std::vector<symbol_id> scope;
+
+  for (const expr* param : params->get_exprs()) {
+    if (auto symbol = expr_cast<symbol_expr>(param)) {
+      scope.push_back(symbol->get_id());
+    }
+  }
+
+  std::vector<const expr*> statements(body->get_exprs().begin(),
+                                      body->get_exprs().end());
+  scopes_.push_back(std::move(scope));
+
+  for (auto& statement : statements) {
+    statement = rewrite(statement);
+  }
+
+  scopes_.pop_back();
+
+  std::vector<const expr*> children(exprs.begin(), exprs.end());
+  children[3] = rebuild(body, statements);
+
+  return rebuild(list, children);
+}
+
+const expr* tree_optimizer::rewrite_if(const list_expr* list,
+                                       std::vector<const expr*>& children) {
+  auto condition =
+      children.size() > 2 ? expr_cast<boolean_expr>(children[1]) : nullptr;
+
+  if (!condition) {
+    return rebuild(list, children);
+  }
+
+  if (condition->get_value()) {
+    return children[2];
+  }
+
+  return children.size() > 3 ? children[3] : arena_.make<integer_expr>(0);
+}
+
+const expr* tree_optimizer::fold_arith(symbol_id op,
+                                       const std::vector<const expr*>& args) {
+  std::vector<number> operands;
+
+  for (const expr* arg : args) {
+    auto value = literal_number(arg);
+
+    if (!value) {
+      return nullptr;
+    }
+
+    operands.push_back(*value);
+  }
+
+  std::optional<number> result;
+
+  switch (op) {
+    case symbol_add:
+      result = fold<add_op>(number{true, 0, 0}, operands, false);
+      break;
+    case symbol_mul:
+      result = fold<mul_op>(number{true, 1, 0}, operands, false);
+      break;
+    case symbol_sub:
+    case symbol_div:
+      if (operands.empty()) {
+        return nullptr;
+      }
+
+      {
+        number acc = operands.front();
+        operands.erase(operands.begin());
+        result = op == symbol_sub ? fold<sub_op>(acc, operands, false)
+                                  : fold<div_op>(acc, operands, true);
+      }
+      break;
+  }
+
+  if (!result) {
+    return nullptr;
+  }
+
+  if (result->is_int) {
+    return arena_.make<integer_expr>(result->i);
+  }
+
+  return arena_.make<float_expr>(result->d);
+}
+
+const expr* tree_optimizer::fold_compare(
+    symbol_id op, const std::vector<const expr*>& args) {
+  if (args.size() != 2) {
+    return nullptr;
+  }
+
+  auto lhs = literal_number(args[0]);
+  auto rhs = literal_number(args[1]);
+
+  if (lhs && rhs) {
+    bool result = lhs->is_int && rhs->is_int
+                      ? compare(op, lhs->i, rhs->i)
+                      : compare(op, lhs->as_double(), rhs->as_double());
+    return arena_.make<boolean_expr>(result);
+  }
+
+  if (op != symbol_eq) {
+    return nullptr;
+  }
+
+  auto lhs_bool = expr_cast<boolean_expr>(args[0]);
+  auto rhs_bool = expr_cast<boolean_expr>(args[1]);
+
+  if (lhs_bool && rhs_bool) {
+    return arena_.make<boolean_expr>(lhs_bool->get_value() ==
+                                     rhs_bool->get_value());
+  }
+
+  auto lhs_string = expr_cast<string_expr>(args[0]);
+  auto rhs_string = expr_cast<string_expr>(args[1]);
+
+  if (lhs_string && rhs_string) {
+    return arena_.make<boolean_expr>(lhs_string->get_value() ==
+                                     rhs_string->get_value());
+  }
+
+  return nullptr;
+}
+
+// lists without any rewritten child are shared with the original tree
+const expr* tree_optimizer::rebuild(const list_expr* list,
+                                    const std::vector<const expr*>& children) {
+  if (std::equal(children.begin(), children.end(),
+                 list->get_exprs().begin())) {
+    return list;
+  }
+
+  return arena_.make<list_expr>(expr_span(
+      arena_.copy_array(children.data(), children.size()), children.size()));
+}
+
+}  // namespace
+
+std::shared_ptr<const ast> optimize(const std::shared_ptr<const ast>& tree,
+                                    bool whole_program) {
+  auto optimized = std::make_shared<ast>();
+  tree_optimizer optimizer(optimized->arena);
+  auto program = expr_cast<list_expr>(tree->root);
+
+  if (whole_program && program) {
+    std::vector<const expr*> forms(program->get_exprs().begin(),
+                                   program->get_exprs().end());
+
+    for (const expr* form : forms) {
+      optimizer.scan(form, true);
+    }
+
+    for (auto& form : forms) {
+      form = optimizer.rewrite_form(form);
+    }
+
+    if (!std::equal(forms.begin(), forms.end(),
+                    program->get_exprs().begin())) {
+      optimized->root = optimized->arena.make<list_expr>(
+          expr_span(optimized->arena.copy_array(forms.data(), forms.size()),
+                    forms.size()));
+    }
+  } else {
+    const expr* root = optimizer.rewrite(tree->root);
+    optimized->root = root != tree->root ? root : nullptr;
+  }
+
+  if (!optimized->root) {
+    return tree;
+  }
+
+  optimized->depends_on.push_back(tree);
+  return optimized;
+}
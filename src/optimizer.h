@@ -0,0 +1,30 @@
+#pragma once
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <memory>
+
+#include "parser.h"
+
+// load-time rewrite of a parsed tree, run before it is resolved (or
+// compiled for the vm):
+//
+// - arithmetic and comparisons on literal operands are folded with the
+//   rules evaluation uses (see arith.h). anything that would fail when
+//   run (div by zero, overflow, wrong types) is left for evaluation to
+//   report
+// - an if with a literal boolean condition becomes the branch it takes,
+//   or 0 (the value of nothing) when it has no else branch to take
+// - in a whole program (the root is the list of top-level forms), a
+//   global def'd once at the top level to a literal and never set is
+//   replaced by the literal wherever it is read after the def
+//
+// the result shares every node it didn't change with tree, which it
+// keeps alive through depends_on. tree itself is returned when nothing
+// changed
+
+std::shared_ptr<const ast> optimize(const std::shared_ptr<const ast>& tree,
+                                    bool whole_program);
+
+#endif  // OPTIMIZER_H
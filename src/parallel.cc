@@ -0,0 +1,338 @@
+#include "./parallel.h"
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "./arrays.h"
+#include "./error.h"
+#include "./lists.h"
+#include "./persistent.h"
+#include "./thread_pool.h"
+
+namespace {
+
+// walks the bodies of a function and of the functions it calls, each
+// once, for the first thing that would reach outside a fork
+class effect_checker {
+ public:
+  explicit effect_checker(const eval_context& ctx) : ctx_(ctx) {}
+
+  std::string check_function(symbol_id name) {
+    if (!visited_.insert(name).second) {
+      return {};
+    }
+
+    auto it = ctx_.fmap.find(name);
+
+    // an undefined function fails when called, as it would anyway
+    if (it == ctx_.fmap.end() || is_primitive(it->second)) {
+      return {};
+    }
+
+    const list_expr* body = function_body(it->second);
+
+    if (!body) {
+      return "calls host function '" + symbol_name(name) + "'";
+    }
+
+    return check(body);
+  }
+
+ private:
+  const eval_context& ctx_;
+  std::unordered_set<symbol_id> visited_;
+
+  std::string check(const expr* node) {
+    switch (node->kind()) {
+      case expr_kind::global: {
+        auto global = static_cast<const global_expr*>(node);
+        std::size_t slot = global->get_slot();
+
+        if (slot < ctx_.globals.size() && !ctx_.globals[slot].is_undefined() &&
+            !is_portable(ctx_.globals[slot])) {
+          return "reads global '" + symbol_name(global->get_id()) +
+                 "', which is not a number, bool or string";
+        }
+
+        return {};
+      }
+      case expr_kind::call: {
+        auto call = static_cast<const call_expr*>(node);
+        std::string effect = check_function(call->get_id());
+
+        for (const expr* arg : call->get_args()) {
+          if (effect.empty()) {
+            effect = check(arg);
+          }
+        }
+
+        return effect;
+      }
+      case expr_kind::list: {
+        auto list = static_cast<const list_expr*>(node);
+        expr_span exprs = list->get_exprs();
+        auto head = exprs.empty() ? nullptr : expr_cast<symbol_expr>(exprs[0]);
+        auto target = exprs.size() > 1 ? expr_cast<global_expr>(exprs[1])
+                                       : nullptr;
+
+        if (head && head->get_id() == symbol_set && target) {
+          return "sets global '" + symbol_name(target->get_id()) + "'";
+        }
+
+        if (head && head->get_id() == symbol_def && target) {
+          return "defines global '" + symbol_name(target->get_id()) + "'";
+        }
+
+        if (head && head->get_id() == symbol_fun) {
+          return "defines a function";
+        }
+
+        if (head && head->get_id() == symbol_debug) {
+          return "writes output with debug";
+        }
+
+        std::string effect;
+
+        for (const expr* child : exprs) {
+          if (effect.empty()) {
+            effect = check(child);
+          }
+        }
+
+        return effect;
+      }
+      default:
+        return {};
+    }
+  }
+};
+
+enum class collection { list, vector, pvec, array };
+
+// the elements of coll, which have to be portable
+std::vector<expr_value> elements_of(const expr_value& coll, collection& kind,
+                                    const char* op) {
+  std::vector<expr_value> items;
+  gc_object* object = coll.is_object() ? coll.as_object() : nullptr;
+
+  if (auto vector = dynamic_cast<const gc_vector*>(object)) {
+    kind = collection::vector;
+
+    for (std::size_t i = 0; i < vector->length(); ++i) {
+      items.push_back((*vector)[i]);
+    }
+  } else if (auto vector = dynamic_cast<const gc_pvec*>(object)) {
+    kind = collection::pvec;
+
+    for (std::size_t i = 0; i < vector->count(); ++i) {
+      items.push_back((*vector)[i]);
+    }
+  } else if (auto array = dynamic_cast<const gc_array*>(object)) {
+    kind = collection::array;
+
+    for (std::size_t i = 0; i < array->length(); ++i) {
+      items.push_back((*array)[i]);
+    }
+  } else if (coll.is_empty_list() || dynamic_cast<const gc_pair*>(object)) {
+    kind = collection::list;
+
+    for (expr_value rest = coll; !rest.is_empty_list();) {
+      auto pair = static_cast<const gc_pair*>(rest.as_object());
+      items.push_back(pair->head);
+      rest = pair->tail;
+    }
+  } else {
+    invalid_type(op);
+  }
+
+  for (const expr_value& item : items) {
+    if (!is_portable(item)) {
+      invalid_type(op);
+    }
+  }
+
+  return items;
+}
+
+expr_value collection_of(eval_context& ctx, collection kind,
+                         const std::vector<expr_value>& items,
+                         const char* op) {
+  switch (kind) {
+    case collection::vector:
+      return ctx.heap.make<gc_vector>(items);
+    case collection::pvec: {
+      gc_pvec* vector = gc_pvec::empty(ctx.heap);
+
+      for (const expr_value& item : items) {
+        vector = vector->conj(ctx.heap, item);
+      }
+
+      return vector;
+    }
+    case collection::array:
+      return make_array(ctx.heap, items.data(), items.size(), op);
+    case collection::list:
+      break;
+  }
+
+  expr_value result = expr_value::empty_list();
+
+  for (std::size_t i = items.size(); i-- > 0;) {
+    result = ctx.heap.make<gc_pair>(items[i], result);
+  }
+
+  return result;
+}
+
+enum class pass { map, filter, reduce };
+
+// a run of consecutive elements and the fork they are evaluated in
+struct chunk {
+  std::unique_ptr<eval_context> ctx;
+  std::vector<expr_value> items;    // portable copies
+  std::vector<expr_value> results;  // one per item, or a single one
+};
+
+// a value a fork gives back has to be portable, it is read by the caller
+// once the fork is done
+const expr_value& portable(const expr_value& value, const char* op) {
+  if (!is_portable(value)) {
+    invalid_type(op);
+  }
+
+  return value;
+}
+
+// evaluates the function named by args[0] over the items in chunks,
+// each chunk's results in the order of its items (a single one for
+// reduce). the forks are made here, on the caller's thread, since
+// making one reads the caller's context
+std::vector<chunk> run_chunks(eval_context& ctx, const expr_value* args,
+                              const std::vector<expr_value>& items, pass step,
+                              const char* op) {
+  if (!args[0].is_string()) {
+    invalid_type(op);
+  }
+
+  symbol_id function = intern(args[0].as_string());
+  std::string effect = effect_checker(ctx).check_function(function);
+
+  if (!effect.empty()) {
+    throw eval_error("'" + symbol_name(function) + "' can't run in " + op +
+                     ", it " + effect);
+  }
+
+  thread_pool& pool = ctx.pool ? *ctx.pool : thread_pool::shared();
+
+  // a few chunks per thread, so threads that finish early can steal
+  std::size_t count = std::min(items.size(), 4 * (pool.size() + 1));
+  std::vector<chunk> chunks(count);
+
+  for (std::size_t c = 0; c < count; ++c) {
+    chunks[c].ctx = fork_context(ctx);
+
+    for (std::size_t i = c * items.size() / count;
+         i < (c + 1) * items.size() / count; ++i) {
+      chunks[c].items.push_back(portable_copy(items[i]));
+    }
+  }
+
+  pool.parallel_for(count, [&](std::size_t c) {
+    chunk& part = chunks[c];
+    eval_context& fork = *part.ctx;
+
+    if (step == pass::reduce) {
+      expr_value total = part.items[0];
+
+      for (std::size_t i = 1; i < part.items.size(); ++i) {
+        expr_value pair[] = {total, part.items[i]};
+        total = call_function(fork, function, pair, 2);
+      }
+
+      part.results.push_back(portable(total, op));
+      return;
+    }
+
+    for (const expr_value& item : part.items) {
+      expr_value result = call_function(fork, function, &item, 1);
+
+      if (step == pass::filter && !result.is_bool()) {
+        throw eval_error(std::string("'") + op +
+                         "' function must evaluate to a boolean");
+      }
+
+      part.results.push_back(portable(result, op));
+    }
+  });
+
+  return chunks;
+}
+
+expr_value pmap(eval_context& ctx, const expr_value* args, std::size_t) {
+  collection kind;
+  std::vector<expr_value> items = elements_of(args[1], kind, "pmap");
+  std::vector<expr_value> results;
+  results.reserve(items.size());
+
+  for (chunk& part : run_chunks(ctx, args, items, pass::map, "pmap")) {
+    results.insert(results.end(), part.results.begin(), part.results.end());
+  }
+
+  return collection_of(ctx, kind, results, "pmap");
+}
+
+expr_value pfilter(eval_context& ctx, const expr_value* args, std::size_t) {
+  collection kind;
+  std::vector<expr_value> items = elements_of(args[1], kind, "pfilter");
+  std::vector<expr_value> kept;
+  std::size_t i = 0;
+
+  for (chunk& part : run_chunks(ctx, args, items, pass::filter, "pfilter")) {
+    for (const expr_value& keep : part.results) {
+      if (keep.as_bool()) {
+        kept.push_back(items[i]);
+      }
+
+      ++i;
+    }
+  }
+
+  return collection_of(ctx, kind, kept, "pfilter");
+}
+
+// the results of the chunks are folded on the caller's context, which
+// may collect garbage in between. the values involved are all portable,
+// so none of them is on its heap
+expr_value preduce(eval_context& ctx, const expr_value* args, std::size_t) {
+  collection kind;
+  expr_value total = portable(args[1], "preduce");
+  std::vector<expr_value> items = elements_of(args[2], kind, "preduce");
+  symbol_id function =
+      args[0].is_string() ? intern(args[0].as_string()) : symbol_id();
+
+  for (chunk& part : run_chunks(ctx, args, items, pass::reduce, "preduce")) {
+    expr_value pair[] = {total, part.results[0]};
+    total = portable(call_function(ctx, function, pair, 2), "preduce");
+  }
+
+  return total;
+}
+
+}  // namespace
+
+std::string shared_effect(const eval_context& ctx, symbol_id name) {
+  return effect_checker(ctx).check_function(name);
+}
+
+void define_parallel_functions(eval_context& ctx) {
+  static const primitive_def functions[] = {
+      {"pmap", 2, 2, pmap},
+      {"pfilter", 2, 2, pfilter},
+      {"preduce", 3, 3, preduce},
+  };
+
+  define_primitives(ctx, functions, std::size(functions));
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <string>
+
+#include "interp.h"
+
+// map, filter and reduce over the elements of a collection in parallel.
+// the elements are split into chunks, each evaluated in a context forked
+// from the caller's (see fork_context) on a worker of the pool
+// (eval_context::pool), while the caller waits and works on chunks too.
+//
+// forks share no values with the caller or each other: the elements and
+// results have to be numbers, bools or strings (copied across), and the
+// function may only read globals that hold one of these. before anything
+// runs, the function and every function it calls are checked for what
+// could change or read state of the caller: setting or defining a
+// global, debug output, calling a function bound by the host, or reading
+// a global holding anything else. any of these is an error.
+//
+// a collection is a list, vector, pvec or array, and the result of pmap
+// and pfilter is of the same kind. fn names a function
+//
+//   (pmap "fn" c)          the results of fn on each element
+//   (pfilter "fn" c)       the elements fn gives true for
+//   (preduce "fn" x c)     fn folded over the elements, starting with x.
+//                          chunks are folded separately and their results
+//                          then folded in order, so fn has to be
+//                          associative
+
+void define_parallel_functions(eval_context& ctx);
+
+// what running the function name in a fork of ctx would change or read
+// of ctx, empty when nothing
+std::string shared_effect(const eval_context& ctx, symbol_id name);
+
+#endif  // PARALLEL_H
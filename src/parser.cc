@@ -1,21 +1,74 @@
 #include "parser.h"
 
+#include <charconv>
+#include <exception>
+
+#include "scan.h"
+#include "thread_pool.h"
+
+// string literal tokens exclude their quotes, source spans include them
+
+static const char* token_begin(const token& tok) {
+  bool quoted = tok.get_type() == token_type::token_string_literal;
+  return tok.get_value().data() - (quoted ? 1 : 0);
+}
+
+static const char* token_end(const token& tok) {
+  bool quoted = tok.get_type() == token_type::token_string_literal;
+  return tok.get_value().data() + tok.get_value().size() + (quoted ? 1 : 0);
+}
+
+parser::parser(token_stream& tokens)
+    : tokens_(tokens), current_(tokens_.next()) {}
+
 parser::parser(const std::vector<token>& tokens)
-    : tokens_(tokens), current_pos_(0) {}
+    : owned_tokens_(std::make_unique<vector_token_stream>(tokens)),
+      tokens_(*owned_tokens_),
+      current_(tokens_.next()) {}
 
 // std::shared_ptr<expr> parser::parse() { return parse_expr(); }
 
-std::shared_ptr<expr> parser::parse() {
-  auto list = std::make_shared<list_expr>();
+std::shared_ptr<ast> parser::parse() {
+  auto tree = std::make_shared<ast>();
+  arena_ = &tree->arena;
+  children_.clear();  // may hold leftovers from a failed parse
 
-  while (current_pos_ < tokens_.size()) {
-    list->add_expr(parse_expr());
+  while (!match(token_type::token_end_of_file)) {
+    form_begin_ = token_begin(current_);
+    children_.push_back(parse_expr());
   }
 
-  return list;
+  tree->root = make_list(0);
+  arena_ = nullptr;
+
+  return tree;
 }
 
-std::shared_ptr<expr> parser::parse_expr() {
+std::shared_ptr<ast> parser::parse_next() {
+  if (match(token_type::token_end_of_file)) {
+    return nullptr;
+  }
+
+  auto tree = std::make_shared<ast>();
+  arena_ = &tree->arena;
+  children_.clear();
+  form_begin_ = token_begin(current_);
+  tree->root = parse_expr();
+  arena_ = nullptr;
+
+  return tree;
+}
+
+std::string_view parser::last_form() const {
+  return std::string_view(form_begin_, form_end_ - form_begin_);
+}
+
+const char* parser::lookahead() const {
+  return match(token_type::token_end_of_file) ? nullptr
+                                              : token_begin(current_);
+}
+
+const expr* parser::parse_expr() {
   if (match(token_type::token_left_paren)) {
     return parse_list();
   } else {
@@ -23,46 +76,73 @@ std::shared_ptr<expr> parser::parse_expr() {
   }
 }
 
-std::shared_ptr<expr> parser::parse_list() {
+const expr* parser::parse_list() {
+  const char* open = current_token().get_value().data();
   eat();  // eat '('
-  auto list = std::make_shared<list_expr>();
+  std::size_t first_child = children_.size();
   while (!match(token_type::token_right_paren) &&
-         current_pos_ < tokens_.size()) {
-    list->add_expr(parse_expr());
+         !match(token_type::token_end_of_file)) {
+    children_.push_back(parse_expr());
   }
   if (!match(token_type::token_right_paren)) {
-    throw std::runtime_error("expected ')'");
+    throw syntax_error("expected ')'", open);
   }
   eat();  // eat ')'
-  return list;
+  return make_list(first_child);
 }
 
-std::shared_ptr<expr> parser::parse_atom() {
-  auto tok = current_token();
+// children are collected on a shared stack while the list is parsed and
+// only copied into the arena once complete, so each list's children end
+// up contiguous even though their own subtrees were allocated first
 
-  eat();
+const expr* parser::make_list(std::size_t first_child) {
+  std::size_t count = children_.size() - first_child;
+  const expr* const* children =
+      arena_->copy_array(children_.data() + first_child, count);
+  children_.resize(first_child);
+
+  return arena_->make<list_expr>(expr_span(children, count));
+}
+
+// the node is built before eating the token, since pulling the next
+// token may invalidate the text of the current one
+
+const expr* parser::parse_atom() {
+  const token& tok = current_token();
+  const expr* atom;
 
   switch (tok.get_type()) {
     case token_type::token_symbol:
-      return std::make_shared<symbol_expr>(tok.get_value());
+      atom = arena_->make<symbol_expr>(tok.get_symbol());
+      break;
     case token_type::token_integer:
-      return std::make_shared<integer_expr>(tok.get_value());
+      atom = arena_->make<integer_expr>(tok.get_value());
+      break;
     case token_type::token_float:
-      return std::make_shared<float_expr>(tok.get_value());
+      atom = arena_->make<float_expr>(tok.get_value());
+      break;
     case token_type::token_boolean:
-      return std::make_shared<boolean_expr>(tok.get_value() == "#t");
+      atom = arena_->make<boolean_expr>(tok.get_value() == "#t");
+      break;
     case token_type::token_string_literal:
-      return std::make_shared<string_expr>(tok.get_value());
+      atom = arena_->make<string_expr>(arena_->copy(tok.get_value()));
+      break;
     default:
-      throw std::runtime_error("unexpected token: " + tok.get_value());
+      throw syntax_error("unexpected token: " + std::string(tok.get_value()),
+                         tok.get_value().data());
   }
+
+  eat();
+
+  return atom;
 }
 
-token parser::current_token() const { return tokens_[current_pos_]; }
+const token& parser::current_token() const { return current_; }
 
 void parser::eat() {
-  if (current_pos_ < tokens_.size()) {
-    current_pos_++;
+  if (current_.get_type() != token_type::token_end_of_file) {
+    form_end_ = token_end(current_);
+    current_ = tokens_.next();
   }
 }
 
@@ -70,19 +150,162 @@ bool parser::match(token_type type) const {
   return current_token().get_type() == type;
 }
 
-void visit(std::shared_ptr<expr> node,
-           const std::unordered_map<std::type_index,
-                                    std::function<void(std::shared_ptr<expr>)>>&
-               callbacks) {
-  auto it = callbacks.find(std::type_index(typeid(*node)));
+// below this, splitting costs more than lexing the piece sequentially
+static const std::size_t min_parallel_chunk = 1 << 16;
+
+static syntax_error locate(const syntax_error& error, std::string_view source) {
+  const char* where = error.where();
+
+  if (!where || where < source.data() ||
+      where > source.data() + source.size()) {
+    return error;
+  }
+
+  std::size_t offset = where - source.data();
+  std::size_t line = 1;
+  std::size_t line_start = 0;
+
+  for (std::size_t i = 0; i < offset; ++i) {
+    if (source[i] == '\n') {
+      ++line;
+      line_start = i + 1;
+    }
+  }
+
+  return syntax_error("line " + std::to_string(line) + ", column " +
+                          std::to_string(offset - line_start + 1) + ": " +
+                          error.what(),
+                      where);
+}
+
+std::shared_ptr<ast> parse_source(std::string_view source) {
+  try {
+    lexer tokens(source);
+    return parser(tokens).parse();
+  } catch (const syntax_error& error) {
+    throw locate(error, source);
+  }
+}
+
+std::shared_ptr<ast> parse_parallel(std::string_view source,
+                                    std::size_t chunks) {
+  thread_pool& pool = thread_pool::shared();
+
+  if (chunks == 0) {
+    chunks = std::min(pool.size() + 1, source.size() / min_parallel_chunk);
+  }
+
+  std::vector<std::size_t> cuts = split_top_level(source, chunks);
 
-  if (it != callbacks.end()) {
-    it->second(node);
+  if (cuts.empty()) {
+    return parse_source(source);
+  }
+
+  cuts.insert(cuts.begin(), 0);
+  cuts.push_back(source.size());
+
+  std::size_t pieces = cuts.size() - 1;
+  std::vector<std::shared_ptr<ast>> trees(pieces);
+  std::vector<std::exception_ptr> errors(pieces);
+
+  pool.parallel_for(pieces, [&](std::size_t i) {
+    try {
+      lexer tokens(source.substr(cuts[i], cuts[i + 1] - cuts[i]));
+      trees[i] = parser(tokens).parse();
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  });
+
+  // pieces start at top-level boundaries, so the first failing piece
+  // holds the first error the sequential parser would have run into
+
+  for (const auto& error : errors) {
+    if (error) {
+      try {
+        std::rethrow_exception(error);
+      } catch (const syntax_error& e) {
+        throw locate(e, source);
+      }
+    }
   }
 
-  if (auto list = std::dynamic_pointer_cast<list_expr>(node)) {
-    for (const auto& child : list->get_exprs()) {
-      visit(child, callbacks);
+  auto tree = std::make_shared<ast>();
+  std::vector<const expr*> forms;
+
+  for (auto& piece : trees) {
+    for (const expr* form : expr_cast<list_expr>(piece->root)->get_exprs()) {
+      forms.push_back(form);
+    }
+
+    tree->arena.adopt(std::move(piece->arena));
+  }
+
+  const expr* const* children =
+      tree->arena.copy_array(forms.data(), forms.size());
+  tree->root = tree->arena.make<list_expr>(expr_span(children, forms.size()));
+
+  return tree;
+}
+
+void write_source(std::ostream& os, const expr* node) {
+  switch (node->kind()) {
+    case expr_kind::symbol:
+      os << static_cast<const symbol_expr*>(node)->get_name();
+      break;
+    case expr_kind::integer:
+      os << static_cast<const integer_expr*>(node)->get_value();
+      break;
+    case expr_kind::floating: {
+      // shortest text that reads back as the same double, with a point so
+      // it still lexes as a float
+      char text[32];
+      double value = static_cast<const float_expr*>(node)->get_value();
+      auto end = std::to_chars(text, text + sizeof(text), value).ptr;
+      std::string_view written(text, end - text);
+      os << written;
+
+      if (written.find_first_of(".ein") == std::string_view::npos) {
+        os << ".0";
+      }
+
+      break;
+    }
+    case expr_kind::boolean:
+      os << (static_cast<const boolean_expr*>(node)->get_value() ? "#t" : "#f");
+      break;
+    case expr_kind::string:
+      os << '"' << static_cast<const string_expr*>(node)->get_value() << '"';
+      break;
+    case expr_kind::local:
+      os << symbol_name(static_cast<const local_expr*>(node)->get_id());
+      break;
+    case expr_kind::global:
+      os << symbol_name(static_cast<const global_expr*>(node)->get_id());
+      break;
+    case expr_kind::call: {
+      auto call = static_cast<const call_expr*>(node);
+      os << '(' << call->get_name();
+
+      for (const expr* arg : call->get_args()) {
+        os << ' ';
+        write_source(os, arg);
+      }
+
+      os << ')';
+      break;
+    }
+    case expr_kind::list: {
+      expr_span items = static_cast<const list_expr*>(node)->get_exprs();
+      os << '(';
+
+      for (std::size_t i = 0; i < items.size(); ++i) {
+        os << (i ? " " : "");
+        write_source(os, items[i]);
+      }
+
+      os << ')';
+      break;
     }
   }
 }
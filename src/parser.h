@@ -3,52 +3,111 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <charconv>
 #include <functional>
+#include <cstdint>
 #include <memory>
+#include <ostream>
 #include <stdexcept>
-#include <typeindex> /*std::type_index*/
-#include <typeinfo>
-#include <unordered_map>
 #include <variant>
 #include <vector>
 
+#include "arena.h"
 #include "lexer.h"
 
+// nodes are allocated in the ast_arena of the tree they belong to and
+// are never destroyed individually, so they only hold trivially
+// destructible data: strings are views into the arena and list children
+// are a contiguous array of node pointers in the same arena.
+//
+// every node carries its kind as a tag (there are no virtual functions),
+// so evaluation and traversal dispatch with a switch on kind() and
+// downcast with expr_cast instead of going through rtti
+
+enum class expr_kind : uint8_t {
+  symbol,
+  integer,
+  floating,
+  boolean,
+  string,
+  list,
+  local,
+  global,
+  call,
+};
+
 class expr {
  public:
-  virtual ~expr() = default;
+  expr_kind kind() const { return kind_; }
+
+ protected:
+  explicit expr(expr_kind kind) : kind_(kind) {}
+
+ private:
+  expr_kind kind_;
 };
 
+// checked downcast, nullptr when the node is of another kind
+template <typename T>
+const T* expr_cast(const expr* node) {
+  return node && node->kind() == T::node_kind ? static_cast<const T*>(node)
+                                              : nullptr;
+}
+
 class symbol_expr : public expr {
  public:
-  explicit symbol_expr(const std::string& name) : name_(name) {}
-  std::string get_name() const { return name_; }
+  static constexpr expr_kind node_kind = expr_kind::symbol;
+
+  explicit symbol_expr(symbol_id id) : expr(node_kind), id_(id) {}
+  explicit symbol_expr(std::string_view name)
+      : expr(node_kind), id_(intern(name)) {}
+  symbol_id get_id() const { return id_; }
+  const std::string& get_name() const { return symbol_name(id_); }
 
  private:
-  std::string name_;
+  friend class ast_image;
+
+  symbol_id id_;
 };
 
 class integer_expr : public expr {
  public:
-  explicit integer_expr(const std::string& value) : value_(std::stoi(value)) {}
-  int get_value() const { return value_; }
+  static constexpr expr_kind node_kind = expr_kind::integer;
+
+  explicit integer_expr(std::string_view value) : expr(node_kind) {
+    auto [ptr, ec] =
+        std::from_chars(value.data(), value.data() + value.size(), value_);
+
+    if (ec != std::errc() || ptr != value.data() + value.size()) {
+      throw std::runtime_error("invalid integer: " + std::string(value));
+    }
+  }
+
+  explicit integer_expr(int64_t value) : expr(node_kind), value_(value) {}
+  int64_t get_value() const { return value_; }
 
  private:
-  int value_;
+  int64_t value_;
 };
 
 class float_expr : public expr {
  public:
-  explicit float_expr(const std::string& value) : value_(std::stof(value)) {}
-  float get_value() const { return value_; }
+  static constexpr expr_kind node_kind = expr_kind::floating;
+
+  explicit float_expr(std::string_view value)
+      : expr(node_kind), value_(std::stod(std::string(value))) {}
+  explicit float_expr(double value) : expr(node_kind), value_(value) {}
+  double get_value() const { return value_; }
 
  private:
-  float value_;
+  double value_;
 };
 
 class boolean_expr : public expr {
  public:
-  explicit boolean_expr(bool value) : value_(value) {}
+  static constexpr expr_kind node_kind = expr_kind::boolean;
+
+  explicit boolean_expr(bool value) : expr(node_kind), value_(value) {}
   bool get_value() const { return value_; }
 
  private:
@@ -57,47 +116,239 @@ class boolean_expr : public expr {
 
 class string_expr : public expr {
  public:
-  explicit string_expr(const std::string& value) : value_(value) {}
-  std::string get_value() const { return value_; }
+  static constexpr expr_kind node_kind = expr_kind::string;
+
+  explicit string_expr(std::string_view value)
+      : expr(node_kind), size_(value.size()), data_(value.data()) {}
+  std::string_view get_value() const { return {data_, size_}; }
+
+ private:
+  friend class ast_image;
+
+  uint32_t size_;  // packed next to the kind, keeps the node at 16 bytes
+  const char* data_;
+};
+
+class expr_span {
+ public:
+  expr_span() = default;
+  expr_span(const expr* const* data, std::size_t size)
+      : data_(data), size_(size) {}
+
+  const expr* const* begin() const { return data_; }
+  const expr* const* end() const { return data_ + size_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const expr* front() const { return data_[0]; }
+  const expr* operator[](std::size_t i) const { return data_[i]; }
 
  private:
-  std::string value_;
+  const expr* const* data_ = nullptr;
+  std::size_t size_ = 0;
 };
 
 class list_expr : public expr {
  public:
-  void add_expr(std::shared_ptr<expr> expression) {
-    exprs_.push_back(expression);
-  }
+  static constexpr expr_kind node_kind = expr_kind::list;
+
+  explicit list_expr(expr_span exprs)
+      : expr(node_kind), size_(exprs.size()), data_(exprs.begin()) {}
+  expr_span get_exprs() const { return expr_span(data_, size_); }
+
+ private:
+  friend class ast_image;
+
+  uint32_t size_;  // as in string_expr
+  const expr* const* data_;
+};
+
+// variable references as rewritten by the resolver (see resolver.h): a
+// parameter of the enclosing function by position, or a global by slot.
+// the parser never produces these, the symbol is kept for messages
+
+class local_expr : public expr {
+ public:
+  static constexpr expr_kind node_kind = expr_kind::local;
+
+  local_expr(symbol_id id, uint32_t slot)
+      : expr(node_kind), slot_(slot), id_(id) {}
+  uint32_t get_slot() const { return slot_; }
+  symbol_id get_id() const { return id_; }
+
+ private:
+  uint32_t slot_;
+  symbol_id id_;
+};
 
-  const std::vector<std::shared_ptr<expr>>& get_exprs() const { return exprs_; }
+class global_expr : public expr {
+ public:
+  static constexpr expr_kind node_kind = expr_kind::global;
+
+  global_expr(symbol_id id, uint32_t slot)
+      : expr(node_kind), slot_(slot), id_(id) {}
+  uint32_t get_slot() const { return slot_; }
+  symbol_id get_id() const { return id_; }
 
  private:
-  std::vector<std::shared_ptr<expr>> exprs_;
+  uint32_t slot_;
+  symbol_id id_;
+};
+
+class callable;
+
+// a call to a named function, made by the resolver from a list whose head
+// is not an operator or special form. the interpreter caches the function
+// it found in the node, tagged with the definition epoch it is valid for
+// (see eval_context::epoch). the cache is not owning, it's only used
+// while the epoch is current, which means the function is still defined
+
+class call_expr : public expr {
+ public:
+  static constexpr expr_kind node_kind = expr_kind::call;
+
+  call_expr(symbol_id id, expr_span args)
+      : expr(node_kind), id_(id), size_(args.size()), data_(args.begin()) {}
+  symbol_id get_id() const { return id_; }
+  const std::string& get_name() const { return symbol_name(id_); }
+  expr_span get_args() const { return expr_span(data_, size_); }
+
+  mutable uint64_t cached_epoch = 0;
+  mutable callable* cached = nullptr;
+
+ private:
+  symbol_id id_;
+  uint32_t size_;
+  const expr* const* data_;
+};
+
+// a parsed tree and the arena holding all of its nodes, freed in one go
+// when the last reference is dropped. a tree may also point into other
+// trees (e.g. a program stitched from separately parsed forms), which it
+// keeps alive through depends_on, or live in memory the arena does not
+// own (e.g. a mapped cache file, see ast_cache.h), kept alive by backing
+
+class ast {
+ public:
+  ast() = default;
+  explicit ast(std::size_t block_size) : arena(block_size) {}
+
+  ast_arena arena;
+  const expr* root = nullptr;
+  std::vector<std::shared_ptr<const ast>> depends_on;
+  std::shared_ptr<const void> backing;
 };
 
+// tokens are pulled from the stream on demand, parse_next() returns one
+// top-level form at a time (nullptr at the end of input) so a caller
+// can evaluate and release each form before reading the next one
+
 class parser {
  public:
+  explicit parser(token_stream& tokens);
   explicit parser(const std::vector<token>& tokens);
-  std::shared_ptr<expr> parse();
+
+  // parse() builds the whole program as one tree (a list of every
+  // top-level form), parse_next() builds each form in its own tree
+
+  std::shared_ptr<ast> parse();
+  std::shared_ptr<ast> parse_next();
+
+  // the text of the form returned by the last parse_next() and the start
+  // of the token following it (nullptr at the end of input). both point
+  // into the lexer's source, so they are only meaningful for streams
+  // lexed from a single in-memory view
+
+  std::string_view last_form() const;
+  const char* lookahead() const;
 
  private:
-  const std::vector<token>& tokens_;
-  std::size_t current_pos_;
+  std::unique_ptr<token_stream> owned_tokens_;
+  token_stream& tokens_;
+  token current_;
+  const char* form_begin_ = nullptr;
+  const char* form_end_ = nullptr;
+
+  ast_arena* arena_ = nullptr;         // arena of the tree being built
+  std::vector<const expr*> children_;  // stack of pending list children
 
-  std::shared_ptr<expr> parse_expr();
-  std::shared_ptr<expr> parse_list();
-  std::shared_ptr<expr> parse_atom();
+  const expr* parse_expr();
+  const expr* parse_list();
+  const expr* parse_atom();
+  const expr* make_list(std::size_t first_child);
 
-  token current_token() const;
+  const token& current_token() const;
 
   void eat();
   bool match(token_type type) const;
 };
 
-void visit(std::shared_ptr<expr> node,
-           const std::unordered_map<std::type_index,
-                                    std::function<void(std::shared_ptr<expr>)>>&
-               callbacks);
+// parse a whole in-memory source into one tree like parser::parse(),
+// syntax errors are reported with the line and column they occur at.
+// parse_parallel cuts the source at top-level form boundaries, lexes and
+// parses the pieces on the shared thread pool and stitches the forms
+// back together in source order, the result (and the error reported for
+// an invalid source) is the same as parse_source's
+
+std::shared_ptr<ast> parse_source(std::string_view source);
+std::shared_ptr<ast> parse_parallel(std::string_view source,
+                                    std::size_t chunks = 0);
+
+// writes node back out as source text, resolved references and calls as
+// the names they refer to. meant for inspecting trees (e.g. what the
+// optimizer made of a program), the text of a tree holding negative
+// numbers doesn't lex back to the same tree
+
+void write_source(std::ostream& os, const expr* node);
+
+// calls visitor with each node downcast to its concrete type (pre-order,
+// lists before their children), e.g. with a generic lambda or a struct
+// overloading operator() for the node types it cares about
+
+template <typename Visitor>
+void visit(const expr* node, Visitor&& visitor) {
+  switch (node->kind()) {
+    case expr_kind::symbol:
+      visitor(static_cast<const symbol_expr*>(node));
+      break;
+    case expr_kind::integer:
+      visitor(static_cast<const integer_expr*>(node));
+      break;
+    case expr_kind::floating:
+      visitor(static_cast<const float_expr*>(node));
+      break;
+    case expr_kind::boolean:
+      visitor(static_cast<const boolean_expr*>(node));
+      break;
+    case expr_kind::string:
+      visitor(static_cast<const string_expr*>(node));
+      break;
+    case expr_kind::local:
+      visitor(static_cast<const local_expr*>(node));
+      break;
+    case expr_kind::global:
+      visitor(static_cast<const global_expr*>(node));
+      break;
+    case expr_kind::call: {
+      auto call = static_cast<const call_expr*>(node);
+      visitor(call);
+
+      for (const expr* arg : call->get_args()) {
+        visit(arg, visitor);
+      }
+
+      break;
+    }
+    case expr_kind::list: {
+      auto list = static_cast<const list_expr*>(node);
+      visitor(list);
+
+      for (const expr* child : list->get_exprs()) {
+        visit(child, visitor);
+      }
+
+      break;
+    }
+  }
+}
 
 #endif  // PARSER_H
@@ -0,0 +1,651 @@
+#include "./persistent.h"
+
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <utility>
+
+#include "./error.h"
+#include "./lists.h"
+
+namespace {
+
+constexpr unsigned bits_per_level = 5;
+constexpr uint32_t fragment_mask = 31;
+constexpr unsigned hash_bits = 64;
+
+// spreads the bits of h over the whole hash (the splitmix64 finalizer),
+// so that keys like consecutive ints don't all share their low fragments
+uint64_t mix(uint64_t h) {
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+  return h ^ (h >> 31);
+}
+
+// a float that is a whole number hashes like the int, since = says they
+// are the same key
+uint64_t hash_of(const expr_value& key) {
+  if (key.is_int()) {
+    return mix(static_cast<uint64_t>(key.as_int()));
+  }
+
+  if (key.is_float()) {
+    double d = key.as_float();
+
+    if (d >= -9223372036854775808.0 && d < 9223372036854775808.0 &&
+        static_cast<double>(static_cast<int64_t>(d)) == d) {
+      return mix(static_cast<uint64_t>(static_cast<int64_t>(d)));
+    }
+
+    return mix(key.bits());
+  }
+
+  if (key.is_string()) {
+    return mix(std::hash<std::string>()(key.as_string()));
+  }
+
+  return mix(key.bits());
+}
+
+bool same_key(const expr_value& a, const expr_value& b) {
+  if (a.is_int() && b.is_int()) {
+    return a.as_int() == b.as_int();
+  }
+
+  if (a.is_number() && b.is_number()) {
+    return a.as_number() == b.as_number();
+  }
+
+  if (a.is_string() && b.is_string()) {
+    return a.as_string() == b.as_string();
+  }
+
+  return a.bits() == b.bits();
+}
+
+uint32_t fragment(uint64_t hash, unsigned shift) {
+  return static_cast<uint32_t>(hash >> shift) & fragment_mask;
+}
+
+int count_bits(uint32_t bits) { return __builtin_popcount(bits); }
+
+gc_node* node_of(const expr_value& value) {
+  return static_cast<gc_node*>(value.as_object());
+}
+
+// a vector node, or a map node without entries or children
+gc_node* plain_node(gc_heap& heap, std::vector<expr_value> slots = {}) {
+  return heap.make<gc_node>(0, 0, std::move(slots));
+}
+
+// where the entry and the child of bit are in the slots of a map node
+std::size_t entry_index(const gc_node* node, uint32_t bit) {
+  return 2 * count_bits(node->datamap & (bit - 1));
+}
+
+std::size_t child_index(const gc_node* node, uint32_t bit) {
+  return 2 * count_bits(node->datamap) + count_bits(node->nodemap & (bit - 1));
+}
+
+// the node of just two entries whose keys differ, as deep as their
+// hashes need to tell them apart
+gc_node* merge(gc_heap& heap, const expr_value& key1, const expr_value& value1,
+               uint64_t hash1, const expr_value& key2,
+               const expr_value& value2, uint64_t hash2, unsigned shift) {
+  if (shift >= hash_bits) {
+    std::vector<expr_value> slots{key1, value1, key2, value2};
+    return heap.make<gc_node>(0, 0, std::move(slots), true);
+  }
+
+  uint32_t fragment1 = fragment(hash1, shift);
+  uint32_t fragment2 = fragment(hash2, shift);
+
+  if (fragment1 == fragment2) {
+    gc_node* child = merge(heap, key1, value1, hash1, key2, value2, hash2,
+                           shift + bits_per_level);
+    return heap.make<gc_node>(0, uint32_t(1) << fragment1,
+                              std::vector<expr_value>{child});
+  }
+
+  uint32_t datamap = (uint32_t(1) << fragment1) | (uint32_t(1) << fragment2);
+
+  std::vector<expr_value> slots{key1, value1, key2, value2};
+
+  if (fragment1 > fragment2) {
+    std::swap(slots[0], slots[2]);
+    std::swap(slots[1], slots[3]);
+  }
+
+  return heap.make<gc_node>(datamap, 0, std::move(slots));
+}
+
+const expr_value* find_entry(const gc_node* node, const expr_value& key,
+                             uint64_t hash) {
+  for (unsigned shift = 0;; shift += bits_per_level) {
+    if (node->collision) {
+      for (std::size_t i = 0; i < node->slots.size(); i += 2) {
+        if (same_key(node->slots[i], key)) {
+          return &node->slots[i + 1];
+        }
+      }
+
+      return nullptr;
+    }
+
+    uint32_t bit = uint32_t(1) << fragment(hash, shift);
+
+    if (node->datamap & bit) {
+      std::size_t i = entry_index(node, bit);
+      return same_key(node->slots[i], key) ? &node->slots[i + 1] : nullptr;
+    }
+
+    if (!(node->nodemap & bit)) {
+      return nullptr;
+    }
+
+    node = node_of(node->slots[child_index(node, bit)]);
+  }
+}
+
+// node with key set to value, node itself when it already was. added is
+// set when the key is new
+gc_node* assoc_entry(gc_heap& heap, gc_node* node, const expr_value& key,
+                     const expr_value& value, uint64_t hash, unsigned shift,
+                     bool& added) {
+  std::vector<expr_value> slots;
+
+  if (node->collision) {
+    for (std::size_t i = 0; i < node->slots.size(); i += 2) {
+      if (same_key(node->slots[i], key)) {
+        if (node->slots[i + 1].bits() == value.bits()) {
+          return node;
+        }
+
+        slots = node->slots;
+        slots[i + 1] = value;
+        return heap.make<gc_node>(0, 0, std::move(slots), true);
+      }
+    }
+
+    slots = node->slots;
+    slots.push_back(key);
+    slots.push_back(value);
+    added = true;
+    return heap.make<gc_node>(0, 0, std::move(slots), true);
+  }
+
+  uint32_t bit = uint32_t(1) << fragment(hash, shift);
+
+  if (node->datamap & bit) {
+    std::size_t i = entry_index(node, bit);
+    const expr_value& other = node->slots[i];
+
+    if (same_key(other, key)) {
+      if (node->slots[i + 1].bits() == value.bits()) {
+        return node;
+      }
+
+      slots = node->slots;
+      slots[i + 1] = value;
+      return heap.make<gc_node>(node->datamap, node->nodemap,
+                                std::move(slots));
+    }
+
+    // the entry moves down into a new child holding both keys
+    gc_node* child = merge(heap, other, node->slots[i + 1], hash_of(other),
+                           key, value, hash, shift + bits_per_level);
+    std::size_t j = child_index(node, bit) - 2;
+    slots.reserve(node->slots.size() - 1);
+    slots.insert(slots.end(), node->slots.begin(), node->slots.begin() + i);
+    slots.insert(slots.end(), node->slots.begin() + i + 2,
+                 node->slots.begin() + j + 2);
+    slots.push_back(child);
+    slots.insert(slots.end(), node->slots.begin() + j + 2, node->slots.end());
+    added = true;
+    return heap.make<gc_node>(node->datamap ^ bit, node->nodemap | bit,
+                              std::move(slots));
+  }
+
+  if (node->nodemap & bit) {
+    std::size_t i = child_index(node, bit);
+    gc_node* child = node_of(node->slots[i]);
+    gc_node* updated = assoc_entry(heap, child, key, value, hash,
+                                   shift + bits_per_level, added);
+
+    if (updated == child) {
+      return node;
+    }
+
+    slots = node->slots;
+    slots[i] = updated;
+    return heap.make<gc_node>(node->datamap, node->nodemap, std::move(slots));
+  }
+
+  std::size_t i = entry_index(node, bit);
+  slots.reserve(node->slots.size() + 2);
+  slots.insert(slots.end(), node->slots.begin(), node->slots.begin() + i);
+  slots.push_back(key);
+  slots.push_back(value);
+  slots.insert(slots.end(), node->slots.begin() + i, node->slots.end());
+  added = true;
+  return heap.make<gc_node>(node->datamap | bit, node->nodemap,
+                            std::move(slots));
+}
+
+// a node left with a single entry and no children, which its parent
+// holds as an entry instead
+bool is_single_entry(const gc_node* node) {
+  return node->slots.size() == 2 && node->nodemap == 0;
+}
+
+// node without key, node itself when it didn't have it
+gc_node* dissoc_entry(gc_heap& heap, gc_node* node, const expr_value& key,
+                      uint64_t hash, unsigned shift) {
+  std::vector<expr_value> slots;
+
+  if (node->collision) {
+    for (std::size_t i = 0; i < node->slots.size(); i += 2) {
+      if (same_key(node->slots[i], key)) {
+        slots = node->slots;
+        slots.erase(slots.begin() + i, slots.begin() + i + 2);
+        return heap.make<gc_node>(0, 0, std::move(slots), true);
+      }
+    }
+
+    return node;
+  }
+
+  uint32_t bit = uint32_t(1) << fragment(hash, shift);
+
+  if (node->datamap & bit) {
+    std::size_t i = entry_index(node, bit);
+
+    if (!same_key(node->slots[i], key)) {
+      return node;
+    }
+
+    slots = node->slots;
+    slots.erase(slots.begin() + i, slots.begin() + i + 2);
+    return heap.make<gc_node>(node->datamap ^ bit, node->nodemap,
+                              std::move(slots));
+  }
+
+  if (!(node->nodemap & bit)) {
+    return node;
+  }
+
+  std::size_t i = child_index(node, bit);
+  gc_node* child = node_of(node->slots[i]);
+  gc_node* updated =
+      dissoc_entry(heap, child, key, hash, shift + bits_per_level);
+
+  if (updated == child) {
+    return node;
+  }
+
+  if (!is_single_entry(updated)) {
+    slots = node->slots;
+    slots[i] = updated;
+    return heap.make<gc_node>(node->datamap, node->nodemap, std::move(slots));
+  }
+
+  // the child's last entry moves up into this node
+  std::size_t j = entry_index(node, bit);
+  slots.reserve(node->slots.size() + 1);
+  slots.insert(slots.end(), node->slots.begin(), node->slots.begin() + j);
+  slots.push_back(updated->slots[0]);
+  slots.push_back(updated->slots[1]);
+  slots.insert(slots.end(), node->slots.begin() + j, node->slots.begin() + i);
+  slots.insert(slots.end(), node->slots.begin() + i + 1, node->slots.end());
+  return heap.make<gc_node>(node->datamap | bit, node->nodemap ^ bit,
+                            std::move(slots));
+}
+
+void visit_entries(
+    const gc_node* node,
+    const std::function<void(const expr_value&, const expr_value&)>& visit) {
+  std::size_t entries = node->collision ? node->slots.size()
+                                        : 2 * count_bits(node->datamap);
+
+  for (std::size_t i = 0; i < entries; i += 2) {
+    visit(node->slots[i], node->slots[i + 1]);
+  }
+
+  for (std::size_t i = entries; i < node->slots.size(); ++i) {
+    visit_entries(node_of(node->slots[i]), visit);
+  }
+}
+
+// the vector trie below node with element i set to value
+gc_node* assoc_element(gc_heap& heap, const gc_node* node, unsigned shift,
+                       std::size_t i, const expr_value& value) {
+  std::vector<expr_value> slots = node->slots;
+  std::size_t at = (i >> shift) & fragment_mask;
+
+  if (shift == 0) {
+    slots[at] = value;
+  } else {
+    slots[at] = assoc_element(heap, node_of(slots[at]),
+                              shift - bits_per_level, i, value);
+  }
+
+  return plain_node(heap, std::move(slots));
+}
+
+// leaf at the bottom of a new path of single children shift bits high
+gc_node* new_path(gc_heap& heap, unsigned shift, gc_node* leaf) {
+  if (shift == 0) {
+    return leaf;
+  }
+
+  return plain_node(heap, {new_path(heap, shift - bits_per_level, leaf)});
+}
+
+// the vector trie below node with the full tail leaf pushed in as the
+// elements from first on
+gc_node* push_tail(gc_heap& heap, const gc_node* node, unsigned shift,
+                   std::size_t first, gc_node* leaf) {
+  std::vector<expr_value> slots = node->slots;
+  std::size_t at = (first >> shift) & fragment_mask;
+
+  if (shift == bits_per_level) {
+    slots.push_back(leaf);
+  } else if (at < slots.size()) {
+    slots[at] = push_tail(heap, node_of(slots[at]), shift - bits_per_level,
+                          first, leaf);
+  } else {
+    slots.push_back(new_path(heap, shift - bits_per_level, leaf));
+  }
+
+  return plain_node(heap, std::move(slots));
+}
+
+gc_map* map_of(const expr_value& value) {
+  return value.is_object() ? dynamic_cast<gc_map*>(value.as_object())
+                           : nullptr;
+}
+
+gc_pvec* pvec_of(const expr_value& value) {
+  return value.is_object() ? dynamic_cast<gc_pvec*>(value.as_object())
+                           : nullptr;
+}
+
+// i as an index of vector, up to (and with append including) its count
+bool index_in(const gc_pvec* vector, const expr_value& i, bool append) {
+  if (!i.is_int()) {
+    return false;
+  }
+
+  int64_t index = i.as_int();
+  return index >= 0 && (static_cast<uint64_t>(index) < vector->count() ||
+                        (append && static_cast<uint64_t>(index) ==
+                                       vector->count()));
+}
+
+[[noreturn]] void out_of_range(const char* op) {
+  throw eval_error(std::string("index out of range for ") + op);
+}
+
+expr_value hash_map(eval_context& ctx, const expr_value* args,
+                    std::size_t argc) {
+  if (argc % 2) {
+    throw eval_error("'hash_map' requires a value for every key");
+  }
+
+  gc_map* map = gc_map::empty(ctx.heap);
+
+  for (std::size_t i = 0; i < argc; i += 2) {
+    map = map->assoc(ctx.heap, args[i], args[i + 1]);
+  }
+
+  return map;
+}
+
+expr_value pvec(eval_context& ctx, const expr_value* args, std::size_t argc) {
+  gc_pvec* vector = gc_pvec::empty(ctx.heap);
+
+  for (std::size_t i = 0; i < argc; ++i) {
+    vector = vector->conj(ctx.heap, args[i]);
+  }
+
+  return vector;
+}
+
+expr_value assoc(eval_context& ctx, const expr_value* args, std::size_t) {
+  if (gc_map* map = map_of(args[0])) {
+    return map->assoc(ctx.heap, args[1], args[2]);
+  }
+
+  gc_pvec* vector = pvec_of(args[0]);
+
+  if (!vector || !args[1].is_int()) {
+    invalid_type("assoc");
+  }
+
+  if (!index_in(vector, args[1], true)) {
+    out_of_range("assoc");
+  }
+
+  return vector->assoc(ctx.heap, args[1].as_int(), args[2]);
+}
+
+expr_value dissoc(eval_context& ctx, const expr_value* args, std::size_t) {
+  gc_map* map = map_of(args[0]);
+
+  if (!map) {
+    invalid_type("dissoc");
+  }
+
+  return map->dissoc(ctx.heap, args[1]);
+}
+
+expr_value get(eval_context&, const expr_value* args, std::size_t argc) {
+  if (gc_map* map = map_of(args[0])) {
+    if (const expr_value* value = map->find(args[1])) {
+      return *value;
+    }
+
+    if (argc < 3) {
+      throw eval_error("key not found for get");
+    }
+
+    return args[2];
+  }
+
+  gc_pvec* vector = pvec_of(args[0]);
+
+  if (!vector || !args[1].is_int()) {
+    invalid_type("get");
+  }
+
+  if (index_in(vector, args[1], false)) {
+    return (*vector)[args[1].as_int()];
+  }
+
+  if (argc < 3) {
+    out_of_range("get");
+  }
+
+  return args[2];
+}
+
+expr_value contains(eval_context&, const expr_value* args, std::size_t) {
+  if (gc_map* map = map_of(args[0])) {
+    return map->find(args[1]) != nullptr;
+  }
+
+  gc_pvec* vector = pvec_of(args[0]);
+
+  if (!vector) {
+    invalid_type("contains");
+  }
+
+  return index_in(vector, args[1], false);
+}
+
+expr_value conj(eval_context& ctx, const expr_value* args, std::size_t) {
+  gc_pvec* vector = pvec_of(args[0]);
+
+  if (!vector) {
+    invalid_type("conj");
+  }
+
+  return vector->conj(ctx.heap, args[1]);
+}
+
+// the keys or the values of a map as a list, both in the order for_each
+// visits the entries
+expr_value entries(eval_context& ctx, const expr_value& coll, bool keys,
+                   const char* op) {
+  gc_map* map = map_of(coll);
+
+  if (!map) {
+    invalid_type(op);
+  }
+
+  std::vector<expr_value> items;
+  items.reserve(map->count());
+
+  map->for_each([&](const expr_value& key, const expr_value& value) {
+    items.push_back(keys ? key : value);
+  });
+
+  expr_value result = expr_value::empty_list();
+
+  for (std::size_t i = items.size(); i-- > 0;) {
+    result = ctx.heap.make<gc_pair>(items[i], result);
+  }
+
+  return result;
+}
+
+expr_value keys(eval_context& ctx, const expr_value* args, std::size_t) {
+  return entries(ctx, args[0], true, "keys");
+}
+
+expr_value vals(eval_context& ctx, const expr_value* args, std::size_t) {
+  return entries(ctx, args[0], false, "vals");
+}
+
+}  // namespace
+
+void gc_node::trace(gc_heap& heap) const {
+  for (const expr_value& slot : slots) {
+    heap.mark(slot);
+  }
+}
+
+gc_map* gc_map::empty(gc_heap& heap) {
+  return heap.make<gc_map>(0, plain_node(heap));
+}
+
+void gc_map::trace(gc_heap& heap) const { heap.mark(root_); }
+
+const expr_value* gc_map::find(const expr_value& key) const {
+  return find_entry(root_, key, hash_of(key));
+}
+
+gc_map* gc_map::assoc(gc_heap& heap, const expr_value& key,
+                      const expr_value& value) const {
+  bool added = false;
+  gc_node* root = assoc_entry(heap, root_, key, value, hash_of(key), 0, added);
+
+  if (root == root_) {
+    return const_cast<gc_map*>(this);
+  }
+
+  return heap.make<gc_map>(count_ + added, root);
+}
+
+gc_map* gc_map::dissoc(gc_heap& heap, const expr_value& key) const {
+  gc_node* root = dissoc_entry(heap, root_, key, hash_of(key), 0);
+
+  if (root == root_) {
+    return const_cast<gc_map*>(this);
+  }
+
+  return heap.make<gc_map>(count_ - 1, root);
+}
+
+void gc_map::for_each(
+    const std::function<void(const expr_value&, const expr_value&)>& visit)
+    const {
+  visit_entries(root_, visit);
+}
+
+gc_pvec* gc_pvec::empty(gc_heap& heap) {
+  return heap.make<gc_pvec>(0, bits_per_level, plain_node(heap),
+                            plain_node(heap));
+}
+
+void gc_pvec::trace(gc_heap& heap) const {
+  heap.mark(root_);
+  heap.mark(tail_);
+}
+
+const expr_value& gc_pvec::operator[](std::size_t i) const {
+  if (i >= tail_offset()) {
+    return tail_->slots[i & fragment_mask];
+  }
+
+  const gc_node* node = root_;
+
+  for (unsigned shift = shift_; shift > 0; shift -= bits_per_level) {
+    node = node_of(node->slots[(i >> shift) & fragment_mask]);
+  }
+
+  return node->slots[i & fragment_mask];
+}
+
+gc_pvec* gc_pvec::assoc(gc_heap& heap, std::size_t i,
+                        const expr_value& value) const {
+  if (i == count_) {
+    return conj(heap, value);
+  }
+
+  if (i >= tail_offset()) {
+    std::vector<expr_value> slots = tail_->slots;
+    slots[i & fragment_mask] = value;
+    return heap.make<gc_pvec>(count_, shift_, root_,
+                              plain_node(heap, std::move(slots)));
+  }
+
+  gc_node* root = assoc_element(heap, root_, shift_, i, value);
+  return heap.make<gc_pvec>(count_, shift_, root, tail_);
+}
+
+gc_pvec* gc_pvec::conj(gc_heap& heap, const expr_value& value) const {
+  if (count_ - tail_offset() < 32) {
+    std::vector<expr_value> slots = tail_->slots;
+    slots.push_back(value);
+    return heap.make<gc_pvec>(count_ + 1, shift_, root_,
+                              plain_node(heap, std::move(slots)));
+  }
+
+  // the full tail goes into the trie, which grows a level when its root
+  // is full as well
+  gc_node* root;
+  unsigned shift = shift_;
+  std::size_t first = count_ - 32;
+
+  if ((count_ >> bits_per_level) > (std::size_t(1) << shift_)) {
+    root = plain_node(heap, {root_, new_path(heap, shift_, tail_)});
+    shift += bits_per_level;
+  } else {
+    root = push_tail(heap, root_, shift_, first, tail_);
+  }
+
+  return heap.make<gc_pvec>(count_ + 1, shift, root, plain_node(heap, {value}));
+}
+
+void define_persistent_functions(eval_context& ctx) {
+  static const primitive_def functions[] = {
+      {"hash_map", 0, any_args, hash_map}, {"pvec", 0, any_args, pvec},
+      {"assoc", 3, 3, assoc},              {"dissoc", 2, 2, dissoc},
+      {"get", 2, 3, get},                  {"contains", 2, 2, contains},
+      {"conj", 2, 2, conj},                {"keys", 1, 1, keys},
+      {"vals", 1, 1, vals},
+  };
+
+  define_primitives(ctx, functions, std::size(functions));
+}
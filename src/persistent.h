@@ -0,0 +1,132 @@
+#pragma once
+
+#ifndef PERSISTENT_H
+#define PERSISTENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "gc.h"
+#include "interp.h"
+
+// persistent (immutable) hash maps and vectors on the garbage collected
+// heap. updating one gives a new version that shares every node it
+// didn't change with the old one, which stays valid as it was: setting
+// one key of a map of n entries copies O(log n) small nodes instead of
+// the whole map.
+//
+// a map is a hash array mapped trie in the compressed (champ) layout,
+// each node branching on 5 bits of the hash of the key. a vector is a
+// 32-way trie of its elements in order plus a tail of up to 32 elements
+// that appending fills before it is pushed into the trie. nodes are
+// never changed once made, so they only point to older objects and need
+// no write barrier.
+//
+// keys are the same when = says they are: numbers by value (1 and 1.0
+// are one key), strings by content, bools and the empty list by value,
+// anything else by identity
+
+// a node of either trie. a map node holds its entries (key and value
+// next to each other) in the order of their hash fragments, followed by
+// its children. the bits of datamap and nodemap are the fragments that
+// have an entry and a child. keys whose whole hashes are equal end up in
+// a collision node, which just lists its entries. a vector node holds
+// its children, or its elements at the bottom level
+class gc_node final : public gc_object {
+ public:
+  gc_node(uint32_t datamap, uint32_t nodemap, std::vector<expr_value> slots,
+          bool collision = false)
+      : datamap(datamap),
+        nodemap(nodemap),
+        collision(collision),
+        slots(std::move(slots)) {}
+
+  void trace(gc_heap& heap) const override;
+  std::size_t size() const override {
+    return sizeof(*this) + slots.capacity() * sizeof(expr_value);
+  }
+
+  const uint32_t datamap;
+  const uint32_t nodemap;
+  const bool collision;
+  const std::vector<expr_value> slots;
+};
+
+class gc_map final : public gc_object {
+ public:
+  gc_map(std::size_t count, gc_node* root) : count_(count), root_(root) {}
+
+  static gc_map* empty(gc_heap& heap);
+
+  void trace(gc_heap& heap) const override;
+  std::size_t size() const override { return sizeof(*this); }
+
+  std::size_t count() const { return count_; }
+
+  // the value of key, nullptr when there is none
+  const expr_value* find(const expr_value& key) const;
+
+  // new versions of the map, or this one when nothing changes
+  gc_map* assoc(gc_heap& heap, const expr_value& key,
+                const expr_value& value) const;
+  gc_map* dissoc(gc_heap& heap, const expr_value& key) const;
+
+  // in no particular order
+  void for_each(
+      const std::function<void(const expr_value&, const expr_value&)>& visit)
+      const;
+
+ private:
+  const std::size_t count_;
+  gc_node* const root_;
+};
+
+class gc_pvec final : public gc_object {
+ public:
+  gc_pvec(std::size_t count, unsigned shift, gc_node* root, gc_node* tail)
+      : count_(count), shift_(shift), root_(root), tail_(tail) {}
+
+  static gc_pvec* empty(gc_heap& heap);
+
+  void trace(gc_heap& heap) const override;
+  std::size_t size() const override { return sizeof(*this); }
+
+  std::size_t count() const { return count_; }
+
+  // i must be below count
+  const expr_value& operator[](std::size_t i) const;
+
+  // i must be at most count, setting element count appends
+  gc_pvec* assoc(gc_heap& heap, std::size_t i, const expr_value& value) const;
+  gc_pvec* conj(gc_heap& heap, const expr_value& value) const;
+
+ private:
+  const std::size_t count_;
+  const unsigned shift_;  // of the bits indexing the root
+  gc_node* const root_;
+  gc_node* const tail_;
+
+  std::size_t tail_offset() const {
+    return count_ < 32 ? 0 : ((count_ - 1) >> 5) << 5;
+  }
+};
+
+// the functions on persistent maps and vectors every eval_context starts
+// out with, length (see lists.h) counts them too
+//
+//   (hash_map k v ..)      a map of the keys to the values after them
+//   (pvec a ..)            a persistent vector of the arguments
+//   (assoc c k v)          c with key (or index) k set to v, setting
+//                          index (length c) of a vector appends
+//   (dissoc m k)           m without key k
+//   (get c k)              the value of key (or index) k
+//   (get c k d)            likewise, d when there is none
+//   (contains c k)         whether c has key (or index) k
+//   (conj v x)             v with x appended
+//   (keys m) (vals m)      lists of the keys and values, in the same order
+
+void define_persistent_functions(eval_context& ctx);
+
+#endif  // PERSISTENT_H
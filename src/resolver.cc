@@ -0,0 +1,235 @@
+#include "./resolver.h"
+
+#include <algorithm>
+
+std::shared_ptr<const ast> resolver::resolve(
+    const std::shared_ptr<const ast>& tree, bool whole_program) {
+  scopes_.clear();
+
+  auto resolved = std::make_shared<ast>();
+  arena_ = &resolved->arena;
+
+  // each form is declared just before it is rewritten, so a whole
+  // program sees the same globals as when its forms come one at a time
+  if (whole_program) {
+    auto program = expr_cast<list_expr>(tree->root);
+    std::vector<const expr*> forms(program->get_exprs().begin(),
+                                   program->get_exprs().end());
+
+    for (auto& form : forms) {
+      declare(form);
+      form = rewrite_form(form);
+    }
+
+    resolved->root = rebuild(program, forms);
+  } else {
+    declare(tree->root);
+    resolved->root = rewrite_form(tree->root);
+  }
+  resolved->depends_on.push_back(tree);
+  arena_ = nullptr;
+
+  return resolved;
+}
+
+void resolver::finish() const {
+  for (std::size_t i = 0; i < names_.size(); ++i) {
+    if (!declared_[i]) {
+      throw resolve_error("identifier '" + symbol_name(names_[i]) +
+                          "' not found");
+    }
+  }
+}
+
+uint32_t resolver::slot(symbol_id name) {
+  auto [it, added] = slots_.emplace(name, names_.size());
+
+  if (added) {
+    names_.push_back(name);
+    declared_.push_back(false);
+  }
+
+  return it->second;
+}
+
+void resolver::declare(const expr* node) {
+  auto list = expr_cast<list_expr>(node);
+
+  if (!list) {
+    return;
+  }
+
+  expr_span exprs = list->get_exprs();
+  auto head = exprs.empty() ? nullptr : expr_cast<symbol_expr>(exprs[0]);
+
+  if (head && head->get_id() == symbol_def && exprs.size() == 3) {
+    if (auto name = expr_cast<symbol_expr>(exprs[1])) {
+      declared_[slot(name->get_id())] = true;
+    }
+  }
+
+  for (const expr* child : exprs) {
+    declare(child);
+  }
+}
+
+const expr* resolver::reference(const symbol_expr* symbol) {
+  symbol_id id = symbol->get_id();
+
+  for (auto scope = scopes_.rbegin(); scope != scopes_.rend(); ++scope) {
+    auto it = std::find(scope->begin(), scope->end(), id);
+
+    if (it == scope->end()) {
+      continue;
+    }
+
+    if (scope != scopes_.rbegin()) {
+      throw resolve_error("'" + symbol->get_name() +
+                          "' is a parameter of an enclosing function, "
+                          "nested functions cannot refer to it");
+    }
+
+    return arena_->make<local_expr>(id, it - scope->begin());
+  }
+
+  auto it = slots_.find(id);
+
+  if ((it == slots_.end() || !declared_[it->second]) && scopes_.empty()) {
+    throw resolve_error("identifier '" + symbol->get_name() + "' not found");
+  }
+
+  return arena_->make<global_expr>(id, slot(id));
+}
+
+const expr* resolver::rewrite_form(const expr* node) {
+  auto list = expr_cast<list_expr>(node);
+  auto head = list && !list->get_exprs().empty()
+                  ? expr_cast<symbol_expr>(list->get_exprs().front())
+                  : nullptr;
+
+  if (head && head->get_id() == symbol_fun) {
+    return rewrite_fun(list);
+  }
+
+  return rewrite(node);
+}
+
+const expr* resolver::rewrite(const expr* node) {
+  if (auto symbol = expr_cast<symbol_expr>(node)) {
+    return reference(symbol);
+  }
+
+  auto list = expr_cast<list_expr>(node);
+
+  if (!list || list->get_exprs().empty()) {
+    return node;
+  }
+
+  expr_span exprs = list->get_exprs();
+  auto head = expr_cast<symbol_expr>(exprs[0]);
+
+  if (head && head->get_id() >= builtin_symbol_count) {
+    return rewrite_call(head, list);
+  }
+
+  std::vector<const expr*> children(exprs.begin(), exprs.end());
+  std::size_t first = head ? 1 : 0;  // operators stay symbols
+
+  // a def or set without a name and a value is rejected before it runs,
+  // as the vm's compiler does
+  if (head && (head->get_id() == symbol_def || head->get_id() == symbol_set)) {
+    auto name = exprs.size() == 3 ? expr_cast<symbol_expr>(exprs[1]) : nullptr;
+
+    if (!name) {
+      throw resolve_error("'" + head->get_name() +
+                          "' expression requires a name and a value");
+    }
+  }
+
+  if (head) {
+    switch (head->get_id()) {
+      case symbol_def: {
+        auto name = static_cast<const symbol_expr*>(exprs[1]);
+        children[1] =
+            arena_->make<global_expr>(name->get_id(), slot(name->get_id()));
+        first = 2;
+        break;
+      }
+      case symbol_set:
+        children[1] = reference(static_cast<const symbol_expr*>(exprs[1]));
+        first = 2;
+        break;
+      case symbol_fun:
+        throw resolve_error("'fun' cannot be used as an expression");
+    }
+  }
+
+  for (std::size_t i = first; i < children.size(); ++i) {
+    children[i] = rewrite(children[i]);
+  }
+
+  return rebuild(list, children);
+}
+
+const expr* resolver::rewrite_call(const symbol_expr* name,
+                                   const list_expr* list) {
+  expr_span exprs = list->get_exprs();
+  std::vector<const expr*> args(exprs.begin() + 1, exprs.end());
+
+  for (auto& arg : args) {
+    arg = rewrite(arg);
+  }
+
+  return arena_->make<call_expr>(
+      name->get_id(),
+      expr_span(arena_->copy_array(args.data(), args.size()), args.size()));
+}
+
+// only the body is resolved, in a scope of its own. anything malformed is
+// left as it is for the interpreter to report when it defines the function
+const expr* resolver::rewrite_fun(const list_expr* list) {
+  expr_span exprs = list->get_exprs();
+  auto params = exprs.size() > 3 ? expr_cast<list_expr>(exprs[2]) : nullptr;
+  auto body = exprs.size() > 3 ? expr_cast<list_expr>(exprs[3]) : nullptr;
+
+  if (!params || !body) {
+    return list;
+  }
+
+  std::vector<symbol_id> scope;
+
+  for (const expr* param : params->get_exprs()) {
+    if (auto symbol = expr_cast<symbol_expr>(param)) {
+      scope.push_back(symbol->get_id());
+    } else {
+      return list;
+    }
+  }
+
+  std::vector<const expr*> statements(body->get_exprs().begin(),
+                                      body->get_exprs().end());
+  scopes_.push_back(std::move(scope));
+
+  for (auto& statement : statements) {
+    statement = rewrite(statement);
+  }
+
+  scopes_.pop_back();
+
+  std::vector<const expr*> children(exprs.begin(), exprs.end());
+  children[3] = rebuild(body, statements);
+
+  return rebuild(list, children);
+}
+
+// lists without any rewritten child are shared with the original tree
+const expr* resolver::rebuild(const list_expr* list,
+                              const std::vector<const expr*>& children) {
+  if (std::equal(children.begin(), children.end(),
+                 list->get_exprs().begin())) {
+    return list;
+  }
+
+  return arena_->make<list_expr>(expr_span(
+      arena_->copy_array(children.data(), children.size()), children.size()));
+}
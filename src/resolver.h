@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+
+class resolve_error : public std::runtime_error {
+ public:
+  explicit resolve_error(const std::string& message)
+      : std::runtime_error(message) {}
+};
+
+// lexical addressing for the interpreter, run once over a tree before it
+// is evaluated. every variable reference (and the target of def and set)
+// becomes a local_expr, the position of a parameter of the enclosing
+// function in the call's arguments, or a global_expr, a slot in
+// eval_context::globals. operators in head position stay symbols, a list
+// calling a function becomes a call_expr, which is still looked up by
+// name but caches what it found.
+//
+// functions are not closures, so a parameter is only visible in the body
+// of the function declaring it and a frame address is just the position,
+// referring to a parameter of an outer function from a nested one is an
+// error.
+//
+// fun defines a function only as a top-level form, elsewhere it is an
+// error. globals are declared by def anywhere in the top-level form
+// being resolved or in an earlier one, whether the forms come in one
+// tree or one at a time. outside function bodies, using an undeclared
+// name is an error right away. in a function body the name may still be
+// declared by a later form, finish() reports those that never were
+
+class resolver {
+ public:
+  // tree is a whole program (the list of top-level forms parse_source
+  // gives) or a single form. the resolved tree shares the atoms of the
+  // one given, which it keeps alive through depends_on
+  std::shared_ptr<const ast> resolve(const std::shared_ptr<const ast>& tree,
+                                     bool whole_program = false);
+  void finish() const;
+
+  std::size_t global_count() const { return names_.size(); }
+
+ private:
+  std::unordered_map<symbol_id, uint32_t> slots_;
+  std::vector<symbol_id> names_;  // by slot
+  std::vector<bool> declared_;    // by slot
+
+  // parameters of each function being resolved, innermost last
+  std::vector<std::vector<symbol_id>> scopes_;
+  ast_arena* arena_ = nullptr;
+
+  uint32_t slot(symbol_id name);
+  void declare(const expr* node);
+  const expr* reference(const symbol_expr* symbol);
+  const expr* rewrite_form(const expr* node);
+  const expr* rewrite(const expr* node);
+  const expr* rewrite_call(const symbol_expr* name, const list_expr* list);
+  const expr* rewrite_fun(const list_expr* list);
+  const expr* rebuild(const list_expr* list,
+                      const std::vector<const expr*>& children);
+};
+
+#endif  // RESOLVER_H
@@ -0,0 +1,433 @@
+#include "./scan.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || \
+    (defined(__i386__) && defined(__SSE2__))
+#define FLISP_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr uint8_t classify(unsigned char c) {
+  uint8_t mask = 0;
+  bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+  bool digit = c >= '0' && c <= '9';
+  bool symbol_punct =
+      c == '_' || c == '+' || c == '-' || c == '*' || c == '/' || c == '=' ||
+      c == '<' || c == '>';
+
+  if (c == ' ' || (c >= '\t' && c <= '\r')) mask |= char_space;
+  if (digit) mask |= char_digit | char_symbol | char_number;
+  if (alpha || symbol_punct) mask |= char_symbol_start | char_symbol;
+  if (c == '.') mask |= char_number;
+  if (c == '(' || c == ')' || c == '"') mask |= char_structural;
+
+  return mask;
+}
+
+std::size_t scalar_run(const char* p, std::size_t n, uint8_t mask) {
+  std::size_t i = 0;
+
+  while (i < n && (char_class_table[static_cast<uint8_t>(p[i])] & mask)) {
+    ++i;
+  }
+
+  return i;
+}
+
+std::size_t scalar_whitespace(const char* p, std::size_t n) {
+  return scalar_run(p, n, char_space);
+}
+
+std::size_t scalar_symbol(const char* p, std::size_t n) {
+  return scalar_run(p, n, char_symbol);
+}
+
+std::size_t scalar_number(const char* p, std::size_t n) {
+  return scalar_run(p, n, char_number);
+}
+
+std::size_t scalar_string(const char* p, std::size_t n) {
+  std::size_t i = 0;
+
+  while (i < n && p[i] != '"') {
+    ++i;
+  }
+
+  return i;
+}
+
+std::size_t scalar_structural(const char* p, std::size_t n) {
+  std::size_t i = 0;
+
+  while (i < n && !(char_class_table[static_cast<uint8_t>(p[i])] &
+                    char_structural)) {
+    ++i;
+  }
+
+  return i;
+}
+
+#ifdef FLISP_SCAN_X86
+
+// every class is expressed with byte compares: ranges use the unsigned
+// "(v - lo) <= span" trick via a saturating subtract, since sse2/avx2
+// only offer signed byte comparisons. the classifier returns 0xff in
+// each lane belonging to the class
+
+inline __m128i in_range_sse2(__m128i v, char lo, char span) {
+  __m128i d = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+  return _mm_cmpeq_epi8(_mm_subs_epu8(d, _mm_set1_epi8(span)),
+                        _mm_setzero_si128());
+}
+
+inline __m128i eq_sse2(__m128i v, char c) {
+  return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+
+__attribute__((target("avx2"))) inline __m256i in_range_avx2(__m256i v,
+                                                             char lo,
+                                                             char span) {
+  __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+  return _mm256_cmpeq_epi8(_mm256_subs_epu8(d, _mm256_set1_epi8(span)),
+                           _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) inline __m256i eq_avx2(__m256i v, char c) {
+  return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+
+struct space_class {
+  static constexpr uint8_t mask = char_space;
+
+  static __m128i sse2(__m128i v) {
+    return _mm_or_si128(eq_sse2(v, ' '), in_range_sse2(v, '\t', 4));
+  }
+
+  __attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+    return _mm256_or_si256(eq_avx2(v, ' '), in_range_avx2(v, '\t', 4));
+  }
+};
+
+struct symbol_class {
+  static constexpr uint8_t mask = char_symbol;
+
+  static __m128i sse2(__m128i v) {
+    __m128i alpha =
+        in_range_sse2(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 25);
+    __m128i digit = in_range_sse2(v, '0', 9);
+    __m128i punct = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(eq_sse2(v, '_'), eq_sse2(v, '+')),
+                     _mm_or_si128(eq_sse2(v, '-'), eq_sse2(v, '*'))),
+        _mm_or_si128(eq_sse2(v, '/'), in_range_sse2(v, '<', 2)));  // < = >
+    return _mm_or_si128(_mm_or_si128(alpha, digit), punct);
+  }
+
+  __attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+    __m256i alpha =
+        in_range_avx2(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 25);
+    __m256i digit = in_range_avx2(v, '0', 9);
+    __m256i punct = _mm256_or_si256(
+        _mm256_or_si256(_mm256_or_si256(eq_avx2(v, '_'), eq_avx2(v, '+')),
+                        _mm256_or_si256(eq_avx2(v, '-'), eq_avx2(v, '*'))),
+        _mm256_or_si256(eq_avx2(v, '/'), in_range_avx2(v, '<', 2)));
+    return _mm256_or_si256(_mm256_or_si256(alpha, digit), punct);
+  }
+};
+
+struct number_class {
+  static constexpr uint8_t mask = char_number;
+
+  static __m128i sse2(__m128i v) {
+    return _mm_or_si128(in_range_sse2(v, '0', 9), eq_sse2(v, '.'));
+  }
+
+  __attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+    return _mm256_or_si256(in_range_avx2(v, '0', 9), eq_avx2(v, '.'));
+  }
+};
+
+// string literals run until the closing quote, so the class is
+// "anything but '"'" and the lane test is inverted
+
+struct string_class {
+  static __m128i sse2(__m128i v) {
+    return _mm_xor_si128(eq_sse2(v, '"'), _mm_set1_epi8(-1));
+  }
+
+  __attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+    return _mm256_xor_si256(eq_avx2(v, '"'), _mm256_set1_epi8(-1));
+  }
+};
+
+struct structural_class {
+  static __m128i sse2(__m128i v) {
+    __m128i hit = _mm_or_si128(_mm_or_si128(eq_sse2(v, '('), eq_sse2(v, ')')),
+                               eq_sse2(v, '"'));
+    return _mm_xor_si128(hit, _mm_set1_epi8(-1));
+  }
+
+  __attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+    __m256i hit = _mm256_or_si256(
+        _mm256_or_si256(eq_avx2(v, '('), eq_avx2(v, ')')), eq_avx2(v, '"'));
+    return _mm256_xor_si256(hit, _mm256_set1_epi8(-1));
+  }
+};
+
+template <typename C>
+std::size_t run_sse2(const char* p, std::size_t n) {
+  std::size_t i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    unsigned miss = ~static_cast<unsigned>(_mm_movemask_epi8(C::sse2(v))) &
+                    0xffffu;
+
+    if (miss) {
+      return i + __builtin_ctz(miss);
+    }
+  }
+
+  return i;
+}
+
+template <typename C>
+__attribute__((target("avx2"))) std::size_t run_avx2(const char* p,
+                                                     std::size_t n) {
+  std::size_t i = 0;
+
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    unsigned miss = ~static_cast<unsigned>(_mm256_movemask_epi8(C::avx2(v)));
+
+    if (miss) {
+      return i + __builtin_ctz(miss);
+    }
+  }
+
+  // finish the last partial block with 16-byte vectors before scalar
+  return i + run_sse2<C>(p + i, n - i);
+}
+
+// the vector loops stop short of the final (n % width) bytes, which
+// are always finished by the scalar scanner of the same class
+
+template <typename C>
+std::size_t sse2_scan(const char* p, std::size_t n) {
+  if (n == 0 || !(char_class_table[static_cast<uint8_t>(*p)] & C::mask)) {
+    return 0;  // empty runs (e.g. no space after a paren) are the norm
+  }
+
+  std::size_t i = run_sse2<C>(p, n);
+  return i + scalar_run(p + i, n - i, C::mask);
+}
+
+template <typename C>
+std::size_t avx2_scan(const char* p, std::size_t n) {
+  if (n == 0 || !(char_class_table[static_cast<uint8_t>(*p)] & C::mask)) {
+    return 0;
+  }
+
+  std::size_t i = run_avx2<C>(p, n);
+  return i + scalar_run(p + i, n - i, C::mask);
+}
+
+std::size_t sse2_string(const char* p, std::size_t n) {
+  std::size_t i = run_sse2<string_class>(p, n);
+  return i + scalar_string(p + i, n - i);
+}
+
+std::size_t avx2_string(const char* p, std::size_t n) {
+  std::size_t i = run_avx2<string_class>(p, n);
+  return i + scalar_string(p + i, n - i);
+}
+
+std::size_t sse2_structural(const char* p, std::size_t n) {
+  std::size_t i = run_sse2<structural_class>(p, n);
+  return i + scalar_structural(p + i, n - i);
+}
+
+std::size_t avx2_structural(const char* p, std::size_t n) {
+  std::size_t i = run_avx2<structural_class>(p, n);
+  return i + scalar_structural(p + i, n - i);
+}
+
+#endif  // FLISP_SCAN_X86
+
+struct scan_fns {
+  std::size_t (*whitespace)(const char*, std::size_t);
+  std::size_t (*symbol)(const char*, std::size_t);
+  std::size_t (*number)(const char*, std::size_t);
+  std::size_t (*string)(const char*, std::size_t);
+  std::size_t (*structural)(const char*, std::size_t);
+};
+
+constexpr scan_fns scalar_fns = {scalar_whitespace, scalar_symbol,
+                                 scalar_number, scalar_string,
+                                 scalar_structural};
+
+#ifdef FLISP_SCAN_X86
+constexpr scan_fns sse2_fns = {sse2_scan<space_class>, sse2_scan<symbol_class>,
+                               sse2_scan<number_class>, sse2_string,
+                               sse2_structural};
+constexpr scan_fns avx2_fns = {avx2_scan<space_class>, avx2_scan<symbol_class>,
+                               avx2_scan<number_class>, avx2_string,
+                               avx2_structural};
+#endif
+
+// constant-initialized to the scalar path so scanning is valid even
+// before the dispatcher below has run during static initialization
+
+scan_fns active = scalar_fns;
+scan_isa active_isa = scan_isa::scalar;
+
+const bool dispatch_initialized = scan_select(scan_detect());
+
+}  // namespace
+
+const uint8_t char_class_table[256] = {
+#define FLISP_CLASS_ROW(base)                                     \
+  classify(base + 0), classify(base + 1), classify(base + 2),     \
+      classify(base + 3), classify(base + 4), classify(base + 5), \
+      classify(base + 6), classify(base + 7)
+    FLISP_CLASS_ROW(0),   FLISP_CLASS_ROW(8),   FLISP_CLASS_ROW(16),
+    FLISP_CLASS_ROW(24),  FLISP_CLASS_ROW(32),  FLISP_CLASS_ROW(40),
+    FLISP_CLASS_ROW(48),  FLISP_CLASS_ROW(56),  FLISP_CLASS_ROW(64),
+    FLISP_CLASS_ROW(72),  FLISP_CLASS_ROW(80),  FLISP_CLASS_ROW(88),
+    FLISP_CLASS_ROW(96),  FLISP_CLASS_ROW(104), FLISP_CLASS_ROW(112),
+    FLISP_CLASS_ROW(120), FLISP_CLASS_ROW(128), FLISP_CLASS_ROW(136),
+    FLISP_CLASS_ROW(144), FLISP_CLASS_ROW(152), FLISP_CLASS_ROW(160),
+    FLISP_CLASS_ROW(168), FLISP_CLASS_ROW(176), FLISP_CLASS_ROW(184),
+    FLISP_CLASS_ROW(192), FLISP_CLASS_ROW(200), FLISP_CLASS_ROW(208),
+    FLISP_CLASS_ROW(216), FLISP_CLASS_ROW(224), FLISP_CLASS_ROW(232),
+    FLISP_CLASS_ROW(240), FLISP_CLASS_ROW(248)
+#undef FLISP_CLASS_ROW
+};
+
+std::size_t scan_whitespace(const char* p, std::size_t n) {
+  return active.whitespace(p, n);
+}
+
+std::size_t scan_symbol(const char* p, std::size_t n) {
+  return active.symbol(p, n);
+}
+
+std::size_t scan_number(const char* p, std::size_t n) {
+  return active.number(p, n);
+}
+
+std::size_t scan_string(const char* p, std::size_t n) {
+  return active.string(p, n);
+}
+
+std::size_t scan_structural(const char* p, std::size_t n) {
+  return active.structural(p, n);
+}
+
+std::vector<std::size_t> split_top_level(std::string_view source,
+                                         std::size_t chunks) {
+  std::vector<std::size_t> cuts;
+  const char* p = source.data();
+  std::size_t n = source.size();
+  std::size_t pos = 0;
+  std::size_t depth = 0;
+  std::size_t next_cut = 1;
+
+  if (chunks < 2) {
+    return cuts;
+  }
+
+  // only parens and quotes matter for depth, everything in between is
+  // skipped a vector at a time
+
+  while (pos < n) {
+    pos += scan_structural(p + pos, n - pos);
+
+    if (pos >= n) {
+      break;
+    }
+
+    if (p[pos] == '"') {
+      pos += 1 + scan_string(p + pos + 1, n - pos - 1) + 1;
+      continue;
+    }
+
+    if (p[pos] == '(') {
+      ++depth;
+    } else if (depth > 0 && --depth == 0) {
+      // unbalanced ')' at depth 0 never cuts, the parser reports it
+      std::size_t end = pos + 1;
+
+      if (end < n && end >= n * next_cut / chunks) {
+        cuts.push_back(end);
+
+        while (next_cut < chunks && n * next_cut / chunks <= end) {
+          ++next_cut;
+        }
+
+        if (next_cut >= chunks) {
+          break;
+        }
+      }
+    }
+
+    ++pos;
+  }
+
+  return cuts;
+}
+
+scan_isa scan_detect() {
+#ifdef FLISP_SCAN_X86
+#if defined(__GNUC__) || defined(__clang__)
+  if (__builtin_cpu_supports("avx2")) {
+    return scan_isa::avx2;
+  }
+#endif
+
+  return scan_isa::sse2;  // part of the x86-64 baseline
+#else
+  return scan_isa::scalar;
+#endif
+}
+
+scan_isa scan_current() { return active_isa; }
+
+bool scan_select(scan_isa isa) {
+  if (static_cast<int>(isa) > static_cast<int>(scan_detect())) {
+    return false;
+  }
+
+  switch (isa) {
+    case scan_isa::scalar:
+      active = scalar_fns;
+      break;
+#ifdef FLISP_SCAN_X86
+    case scan_isa::sse2:
+      active = sse2_fns;
+      break;
+    case scan_isa::avx2:
+      active = avx2_fns;
+      break;
+#else
+    default:
+      return false;
+#endif
+  }
+
+  active_isa = isa;
+  return true;
+}
+
+const char* scan_isa_name(scan_isa isa) {
+  switch (isa) {
+    case scan_isa::scalar:
+      return "scalar";
+    case scan_isa::sse2:
+      return "sse2";
+    case scan_isa::avx2:
+      return "avx2";
+  }
+
+  return "unknown";
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// character classes used by the lexer, kept in a 256-entry table so
+// the scalar path is a single load per byte instead of a chain of
+// std::isspace/std::isalnum calls and comparisons
+
+enum char_class : uint8_t {
+  char_space = 1 << 0,         // ' ', \t, \n, \v, \f, \r
+  char_digit = 1 << 1,         // 0-9
+  char_symbol_start = 1 << 2,  // a-z, A-Z, _, +, -, *, /, =, <, >
+  char_symbol = 1 << 3,        // symbol_start and digits
+  char_number = 1 << 4,        // digits and '.'
+  char_structural = 1 << 5,    // '(', ')' and '"'
+};
+
+extern const uint8_t char_class_table[256];
+
+inline bool is_char_class(char c, uint8_t mask) {
+  return char_class_table[static_cast<uint8_t>(c)] & mask;
+}
+
+// each scanner returns the length of the longest prefix of [p, p + n)
+// made of its class (scan_string stops at the closing quote instead and
+// scan_structural at the first paren or quote).
+// the implementation is picked once at startup from the widest
+// instruction set the cpu supports, falling back to the table above
+
+std::size_t scan_whitespace(const char* p, std::size_t n);
+std::size_t scan_symbol(const char* p, std::size_t n);
+std::size_t scan_number(const char* p, std::size_t n);
+std::size_t scan_string(const char* p, std::size_t n);
+std::size_t scan_structural(const char* p, std::size_t n);
+
+// splits source into about `chunks` pieces of similar size, cutting only
+// right after a top-level form closes (tracking paren depth and skipping
+// string literals), and returns the cut offsets in increasing order
+std::vector<std::size_t> split_top_level(std::string_view source,
+                                         std::size_t chunks);
+
+enum class scan_isa { scalar, sse2, avx2 };
+
+scan_isa scan_detect();                 // best isa supported by this cpu
+scan_isa scan_current();                // isa currently in use
+bool scan_select(scan_isa isa);         // false if the cpu lacks it
+const char* scan_isa_name(scan_isa isa);
+
+#endif  // SCAN_H
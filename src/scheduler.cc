@@ -0,0 +1,174 @@
+#include "./scheduler.h"
+
+#include <iostream>
+
+#include "./compiler.h"
+#include "./error.h"
+
+namespace {
+
+// values the stack of a task's vm starts with, enough for a top-level
+// form and a few calls before it has to grow
+constexpr std::size_t task_stack_size = 32;
+
+}  // namespace
+
+task::task(const script& code) : vm_(task_stack_size) {
+  vm_.out = &output_;
+
+  auto program = expr_cast<list_expr>(code.tree()->root);
+
+  for (const expr* form : program->get_exprs()) {
+    forms_.push_back(compile(vm_, form));
+  }
+}
+
+bool task::step(vm_value value) {
+  if (vm_.suspended()) {
+    vm_.resume(std::move(value));
+  }
+
+  while (!vm_.suspended()) {
+    if (next_form_ > 0) {
+      forms_[next_form_ - 1].reset();
+    }
+
+    if (next_form_ == forms_.size()) {
+      return true;
+    }
+
+    vm_.run(*forms_[next_form_++]);
+  }
+
+  return false;
+}
+
+scheduler::scheduler(thread_pool& pool) : pool_(pool) {}
+
+task& scheduler::spawn(std::shared_ptr<const script> code,
+                       const std::function<void(task&)>& setup) {
+  static const symbol_id sleep_name = intern("sleep");
+
+  std::unique_ptr<task> added(new task(*code));
+  task& target = *added;
+
+  target.vm_.bind(sleep_name, 1, [this, &target](vm& machine,
+                                                 const vm_value* args) {
+    double ms;
+
+    if (auto i = std::get_if<int64_t>(&args[0])) {
+      ms = *i;
+    } else if (auto f = std::get_if<double>(&args[0])) {
+      ms = *f;
+    } else {
+      throw eval_error("invalid type for sleep");
+    }
+
+    machine.suspend();
+    resume_after(target,
+                 std::chrono::duration_cast<clock::duration>(
+                     std::chrono::duration<double, std::milli>(ms)),
+                 args[0]);
+    return vm_value();
+  });
+
+  if (setup) {
+    setup(target);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  tasks_.push_back(std::move(added));
+  ready_.push_back(&target);
+  ++unfinished_;
+  return target;
+}
+
+void scheduler::resume(task& suspended, vm_value value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  make_ready(suspended, std::move(value));
+}
+
+void scheduler::resume_after(task& suspended, clock::duration delay,
+                             vm_value value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  timers_.push({clock::now() + delay, next_order_++, &suspended,
+                std::move(value)});
+  wake_.notify_one();  // a worker may be sleeping until a later timer
+}
+
+void scheduler::run() {
+  pool_.parallel_for(pool_.size() + 1, [this](std::size_t) { work(); });
+}
+
+// with the mutex held
+void scheduler::make_ready(task& target, vm_value value) {
+  if (target.resumed_ || target.state_ == task::state::ready ||
+      target.state_ == task::state::finished) {
+    std::cerr << "error: a task was resumed without being suspended"
+              << std::endl;
+    exit(1);
+  }
+
+  target.value_ = std::move(value);
+  target.resumed_ = true;
+
+  // a running task is queued once it has stopped, see work
+  if (target.state_ == task::state::waiting) {
+    target.state_ = task::state::ready;
+    ready_.push_back(&target);
+    wake_.notify_one();
+  }
+}
+
+void scheduler::work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (unfinished_ > 0) {
+    while (!timers_.empty() && timers_.top().deadline <= clock::now()) {
+      timer due = timers_.top();
+      timers_.pop();
+      make_ready(*due.target, std::move(due.value));
+    }
+
+    if (ready_.empty()) {
+      if (timers_.empty()) {
+        wake_.wait(lock);
+      } else {
+        wake_.wait_until(lock, timers_.top().deadline);
+      }
+
+      continue;
+    }
+
+    task* next = ready_.front();
+    ready_.pop_front();
+    next->state_ = task::state::running;
+    next->resumed_ = false;
+    vm_value value = std::move(next->value_);
+
+    lock.unlock();
+    bool done = false;
+
+    try {
+      done = next->step(std::move(value));
+    } catch (const eval_error& error) {
+      std::cerr << "error: " << error.what() << std::endl;
+      exit(1);
+    }
+
+    lock.lock();
+
+    if (done) {
+      next->state_ = task::state::finished;
+
+      if (--unfinished_ == 0) {
+        wake_.notify_all();
+      }
+    } else if (next->resumed_) {
+      next->state_ = task::state::ready;
+      ready_.push_back(next);
+    } else {
+      next->state_ = task::state::waiting;
+    }
+  }
+}
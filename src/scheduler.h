@@ -0,0 +1,131 @@
+#pragma once
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "isolate.h"
+#include "thread_pool.h"
+#include "vm.h"
+
+// running many scripts that wait on the host (lookups, remote calls) on
+// a few threads. each script runs as a task on a bytecode vm of its own
+// (see vm.h), whose calls live on the vm's stacks rather than the
+// thread's, so a host function can suspend the task without holding on
+// to a thread: the thread goes on with another task, and the suspended
+// one is picked up by whichever thread is free once the host resumes it.
+// a waiting task costs its vm's stacks, globals and compiled functions,
+// a few kilobytes for a small script, instead of a thread and its stack.
+//
+// a task is run by one thread at a time, and the values of a vm are
+// plain copies (see vm_value), so tasks share nothing but the script
+// they run. every task can call (sleep ms), which suspends it for ms
+// milliseconds and evaluates to ms: it stands in for a host function
+// answering asynchronously, and shows how to write one with resume_after
+
+class task {
+ public:
+  task(const task&) = delete;
+  task& operator=(const task&) = delete;
+
+  // e.g. to bind host functions before the task first runs
+  vm& machine() { return vm_; }
+
+  // everything debug has written so far
+  std::string output() const { return output_.str(); }
+
+ private:
+  friend class scheduler;
+
+  enum class state { ready, running, waiting, finished };
+
+  // compiles every form of code up front
+  explicit task(const script& code);
+
+  // runs the task until it is suspended or done, true when done. value is
+  // the result of the host call it was suspended in, if any
+  bool step(vm_value value);
+
+  vm vm_;
+  std::vector<std::unique_ptr<vm_function>> forms_;  // released once run
+  std::size_t next_form_ = 0;
+  std::ostringstream output_;
+
+  // guarded by the scheduler's mutex. a task can be resumed while the
+  // host function suspending it is still running, in which case the
+  // value waits here until the task has stopped
+  state state_ = state::ready;
+  bool resumed_ = false;
+  vm_value value_;
+};
+
+class scheduler {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  explicit scheduler(thread_pool& pool = thread_pool::shared());
+
+  scheduler(const scheduler&) = delete;
+  scheduler& operator=(const scheduler&) = delete;
+
+  // adds a task running code, which starts with the next run. setup, if
+  // given, is called on it first. compile errors in code are thrown
+  task& spawn(std::shared_ptr<const script> code,
+              const std::function<void(task&)>& setup = nullptr);
+
+  // hands value to a task suspended by a host function (as the result
+  // of that call) and lets it continue. any thread may call this, also
+  // from inside the host function before it returns
+  void resume(task& suspended, vm_value value);
+
+  // resumes a suspended task with value once delay has passed
+  void resume_after(task& suspended, clock::duration delay, vm_value value);
+
+  // runs the tasks on the workers of the pool and the calling thread
+  // until all of them have finished, so every suspended task has to be
+  // resumed eventually. errors in a script end the process, as they do
+  // when running a single program
+  void run();
+
+  // the tasks in the order they were spawned
+  const std::vector<std::unique_ptr<task>>& tasks() const { return tasks_; }
+
+ private:
+  struct timer {
+    clock::time_point deadline;
+    std::size_t order;  // timers with the same deadline fire in order
+    task* target;
+    vm_value value;
+
+    bool operator>(const timer& other) const {
+      return deadline != other.deadline ? deadline > other.deadline
+                                        : order > other.order;
+    }
+  };
+
+  thread_pool& pool_;
+  std::vector<std::unique_ptr<task>> tasks_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;  // a task is ready, a timer due or all done
+  std::deque<task*> ready_;
+  std::priority_queue<timer, std::vector<timer>, std::greater<timer>> timers_;
+  std::size_t next_order_ = 0;
+  std::size_t unfinished_ = 0;
+
+  void make_ready(task& target, vm_value value);
+  void work();
+};
+
+#endif  // SCHEDULER_H
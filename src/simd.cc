@@ -0,0 +1,390 @@
+#include "./simd.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+template <simd_op op>
+double scalar_op(double a, double b) {
+  if constexpr (op == simd_op::add) {
+    return a + b;
+  } else if constexpr (op == simd_op::sub) {
+    return a - b;
+  } else if constexpr (op == simd_op::mul) {
+    return a * b;
+  } else {
+    return a / b;
+  }
+}
+
+template <simd_op op>
+void scalar_apply(const double* a, bool a_single, const double* b,
+                  bool b_single, double* out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    out[i] = scalar_op<op>(a[a_single ? 0 : i], b[b_single ? 0 : i]);
+  }
+}
+
+void scalar_apply(simd_op op, const double* a, bool a_single,
+                  const double* b, bool b_single, double* out,
+                  std::size_t n) {
+  switch (op) {
+    case simd_op::add:
+      return scalar_apply<simd_op::add>(a, a_single, b, b_single, out, n);
+    case simd_op::sub:
+      return scalar_apply<simd_op::sub>(a, a_single, b, b_single, out, n);
+    case simd_op::mul:
+      return scalar_apply<simd_op::mul>(a, a_single, b, b_single, out, n);
+    case simd_op::div:
+      return scalar_apply<simd_op::div>(a, a_single, b, b_single, out, n);
+  }
+}
+
+double scalar_sum(const double* a, std::size_t n) {
+  double total = 0;
+
+  for (std::size_t i = 0; i < n; ++i) {
+    total += a[i];
+  }
+
+  return total;
+}
+
+double scalar_dot(const double* a, const double* b, std::size_t n) {
+  double total = 0;
+
+  for (std::size_t i = 0; i < n; ++i) {
+    total += a[i] * b[i];
+  }
+
+  return total;
+}
+
+double scalar_min(const double* a, std::size_t n) {
+  double least = a[0];
+
+  for (std::size_t i = 1; i < n; ++i) {
+    least = a[i] < least ? a[i] : least;
+  }
+
+  return least;
+}
+
+double scalar_max(const double* a, std::size_t n) {
+  double most = a[0];
+
+  for (std::size_t i = 1; i < n; ++i) {
+    most = a[i] > most ? a[i] : most;
+  }
+
+  return most;
+}
+
+const simd_kernels scalar_kernels = {
+    "scalar",   scalar_apply, scalar_sum, scalar_dot,
+    scalar_min, scalar_max,
+};
+
+#if defined(__x86_64__)
+
+// sse2 is part of x86-64, so these need no check (or target attribute)
+
+template <simd_op op>
+__m128d sse2_op(__m128d a, __m128d b) {
+  if constexpr (op == simd_op::add) {
+    return _mm_add_pd(a, b);
+  } else if constexpr (op == simd_op::sub) {
+    return _mm_sub_pd(a, b);
+  } else if constexpr (op == simd_op::mul) {
+    return _mm_mul_pd(a, b);
+  } else {
+    return _mm_div_pd(a, b);
+  }
+}
+
+template <simd_op op>
+void sse2_apply(const double* a, bool a_single, const double* b,
+                bool b_single, double* out, std::size_t n) {
+  __m128d single_a = a_single ? _mm_set1_pd(a[0]) : _mm_setzero_pd();
+  __m128d single_b = b_single ? _mm_set1_pd(b[0]) : _mm_setzero_pd();
+  std::size_t i = 0;
+
+  for (; i + 2 <= n; i += 2) {
+    __m128d x = a_single ? single_a : _mm_loadu_pd(a + i);
+    __m128d y = b_single ? single_b : _mm_loadu_pd(b + i);
+    _mm_storeu_pd(out + i, sse2_op<op>(x, y));
+  }
+
+  for (; i < n; ++i) {
+    out[i] = scalar_op<op>(a[a_single ? 0 : i], b[b_single ? 0 : i]);
+  }
+}
+
+void sse2_apply(simd_op op, const double* a, bool a_single, const double* b,
+                bool b_single, double* out, std::size_t n) {
+  switch (op) {
+    case simd_op::add:
+      return sse2_apply<simd_op::add>(a, a_single, b, b_single, out, n);
+    case simd_op::sub:
+      return sse2_apply<simd_op::sub>(a, a_single, b, b_single, out, n);
+    case simd_op::mul:
+      return sse2_apply<simd_op::mul>(a, a_single, b, b_single, out, n);
+    case simd_op::div:
+      return sse2_apply<simd_op::div>(a, a_single, b, b_single, out, n);
+  }
+}
+
+double sse2_lanes(__m128d v) {
+  double lanes[2];
+  _mm_storeu_pd(lanes, v);
+  return lanes[0] + lanes[1];
+}
+
+// two accumulators, so an add doesn't wait for the one before
+double sse2_sum(const double* a, std::size_t n) {
+  __m128d total0 = _mm_setzero_pd();
+  __m128d total1 = _mm_setzero_pd();
+  std::size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    total0 = _mm_add_pd(total0, _mm_loadu_pd(a + i));
+    total1 = _mm_add_pd(total1, _mm_loadu_pd(a + i + 2));
+  }
+
+  double total = sse2_lanes(_mm_add_pd(total0, total1));
+
+  for (; i < n; ++i) {
+    total += a[i];
+  }
+
+  return total;
+}
+
+double sse2_dot(const double* a, const double* b, std::size_t n) {
+  __m128d total0 = _mm_setzero_pd();
+  __m128d total1 = _mm_setzero_pd();
+  std::size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    total0 = _mm_add_pd(total0,
+                        _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    total1 = _mm_add_pd(
+        total1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+  }
+
+  double total = sse2_lanes(_mm_add_pd(total0, total1));
+
+  for (; i < n; ++i) {
+    total += a[i] * b[i];
+  }
+
+  return total;
+}
+
+double sse2_min(const double* a, std::size_t n) {
+  __m128d least = _mm_set1_pd(a[0]);
+  std::size_t i = 0;
+
+  for (; i + 2 <= n; i += 2) {
+    least = _mm_min_pd(least, _mm_loadu_pd(a + i));
+  }
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, least);
+  double result = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+
+  for (; i < n; ++i) {
+    result = a[i] < result ? a[i] : result;
+  }
+
+  return result;
+}
+
+double sse2_max(const double* a, std::size_t n) {
+  __m128d most = _mm_set1_pd(a[0]);
+  std::size_t i = 0;
+
+  for (; i + 2 <= n; i += 2) {
+    most = _mm_max_pd(most, _mm_loadu_pd(a + i));
+  }
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, most);
+  double result = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+
+  for (; i < n; ++i) {
+    result = a[i] > result ? a[i] : result;
+  }
+
+  return result;
+}
+
+const simd_kernels sse2_kernels = {
+    "sse2", sse2_apply, sse2_sum, sse2_dot, sse2_min, sse2_max,
+};
+
+// avx is only used when the cpu (and os) support it, the functions are
+// compiled for it regardless of the flags of the rest of the build
+
+#define AVX __attribute__((target("avx")))
+
+template <simd_op op>
+AVX __m256d avx_op(__m256d a, __m256d b) {
+  if constexpr (op == simd_op::add) {
+    return _mm256_add_pd(a, b);
+  } else if constexpr (op == simd_op::sub) {
+    return _mm256_sub_pd(a, b);
+  } else if constexpr (op == simd_op::mul) {
+    return _mm256_mul_pd(a, b);
+  } else {
+    return _mm256_div_pd(a, b);
+  }
+}
+
+template <simd_op op>
+AVX void avx_apply(const double* a, bool a_single, const double* b,
+                   bool b_single, double* out, std::size_t n) {
+  __m256d single_a = a_single ? _mm256_set1_pd(a[0]) : _mm256_setzero_pd();
+  __m256d single_b = b_single ? _mm256_set1_pd(b[0]) : _mm256_setzero_pd();
+  std::size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m256d x = a_single ? single_a : _mm256_loadu_pd(a + i);
+    __m256d y = b_single ? single_b : _mm256_loadu_pd(b + i);
+    _mm256_storeu_pd(out + i, avx_op<op>(x, y));
+  }
+
+  for (; i < n; ++i) {
+    out[i] = scalar_op<op>(a[a_single ? 0 : i], b[b_single ? 0 : i]);
+  }
+}
+
+AVX void avx_apply(simd_op op, const double* a, bool a_single,
+                   const double* b, bool b_single, double* out,
+                   std::size_t n) {
+  switch (op) {
+    case simd_op::add:
+      return avx_apply<simd_op::add>(a, a_single, b, b_single, out, n);
+    case simd_op::sub:
+      return avx_apply<simd_op::sub>(a, a_single, b, b_single, out, n);
+    case simd_op::mul:
+      return avx_apply<simd_op::mul>(a, a_single, b, b_single, out, n);
+    case simd_op::div:
+      return avx_apply<simd_op::div>(a, a_single, b, b_single, out, n);
+  }
+}
+
+AVX double avx_lanes(__m256d v) {
+  double lanes[4];
+  _mm256_storeu_pd(lanes, v);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+AVX double avx_sum(const double* a, std::size_t n) {
+  __m256d total0 = _mm256_setzero_pd();
+  __m256d total1 = _mm256_setzero_pd();
+  std::size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    total0 = _mm256_add_pd(total0, _mm256_loadu_pd(a + i));
+    total1 = _mm256_add_pd(total1, _mm256_loadu_pd(a + i + 4));
+  }
+
+  double total = avx_lanes(_mm256_add_pd(total0, total1));
+
+  for (; i < n; ++i) {
+    total += a[i];
+  }
+
+  return total;
+}
+
+AVX double avx_dot(const double* a, const double* b, std::size_t n) {
+  __m256d total0 = _mm256_setzero_pd();
+  __m256d total1 = _mm256_setzero_pd();
+  std::size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    total0 = _mm256_add_pd(
+        total0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    total1 = _mm256_add_pd(total1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4),
+                                                 _mm256_loadu_pd(b + i + 4)));
+  }
+
+  double total = avx_lanes(_mm256_add_pd(total0, total1));
+
+  for (; i < n; ++i) {
+    total += a[i] * b[i];
+  }
+
+  return total;
+}
+
+AVX double avx_min(const double* a, std::size_t n) {
+  __m256d least = _mm256_set1_pd(a[0]);
+  std::size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    least = _mm256_min_pd(least, _mm256_loadu_pd(a + i));
+  }
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, least);
+  double result = scalar_min(lanes, 4);
+
+  for (; i < n; ++i) {
+    result = a[i] < result ? a[i] : result;
+  }
+
+  return result;
+}
+
+AVX double avx_max(const double* a, std::size_t n) {
+  __m256d most = _mm256_set1_pd(a[0]);
+  std::size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    most = _mm256_max_pd(most, _mm256_loadu_pd(a + i));
+  }
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, most);
+  double result = scalar_max(lanes, 4);
+
+  for (; i < n; ++i) {
+    result = a[i] > result ? a[i] : result;
+  }
+
+  return result;
+}
+
+#undef AVX
+
+const simd_kernels avx_kernels = {
+    "avx", avx_apply, avx_sum, avx_dot, avx_min, avx_max,
+};
+
+#endif
+
+}  // namespace
+
+std::vector<const simd_kernels*> simd_available() {
+  std::vector<const simd_kernels*> sets = {&scalar_kernels};
+
+#if defined(__x86_64__)
+  sets.push_back(&sse2_kernels);
+
+  if (__builtin_cpu_supports("avx")) {
+    sets.push_back(&avx_kernels);
+  }
+#endif
+
+  return sets;
+}
+
+const simd_kernels& simd() {
+  static const simd_kernels* best = simd_available().back();
+  return *best;
+}
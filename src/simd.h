@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+#include <vector>
+
+// loops over arrays of doubles for the numeric arrays of arrays.h, in
+// sets of kernels for what the cpu can do: avx (4 lanes), sse2 (2
+// lanes, every x86-64 has it) and plain scalar loops for other targets.
+// the best set the running cpu supports is picked on first use.
+//
+// sums (and dot products) are accumulated per lane and the lanes added
+// up at the end, so their rounding can differ in the last bits from
+// adding the elements left to right. with nan elements, which element
+// min and max find is unspecified
+
+enum class simd_op { add, sub, mul, div };
+
+struct simd_kernels {
+  const char* name;
+
+  // out[i] = a[i] op b[i], where a or b is a single value used for every
+  // i when a_single or b_single is set. out may be a or b
+  void (*apply)(simd_op op, const double* a, bool a_single, const double* b,
+                bool b_single, double* out, std::size_t n);
+
+  double (*sum)(const double* a, std::size_t n);
+  double (*dot)(const double* a, const double* b, std::size_t n);
+
+  // n must not be 0
+  double (*min)(const double* a, std::size_t n);
+  double (*max)(const double* a, std::size_t n);
+};
+
+// the best kernels for this cpu
+const simd_kernels& simd();
+
+// every set this cpu can run, scalar first and the best last
+std::vector<const simd_kernels*> simd_available();
+
+#endif  // SIMD_H
@@ -0,0 +1,102 @@
+#include "./source.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FLISP_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+source_buffer::source_buffer(std::string text) : owned_(std::move(text)) {
+  data_ = owned_.data();
+  size_ = owned_.size();
+}
+
+source_buffer::~source_buffer() { release(); }
+
+source_buffer::source_buffer(source_buffer&& other) noexcept {
+  *this = std::move(other);
+}
+
+source_buffer& source_buffer::operator=(source_buffer&& other) noexcept {
+  if (this != &other) {
+    release();
+
+    mapped_ = other.mapped_;
+    size_ = other.size_;
+    owned_ = std::move(other.owned_);
+
+    // moving a short string relocates its characters, so the view
+    // has to be re-pointed at our own copy unless it is a mapping
+    data_ = mapped_ ? other.data_ : owned_.data();
+
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.mapped_ = false;
+  }
+
+  return *this;
+}
+
+void source_buffer::release() {
+#ifdef FLISP_HAS_MMAP
+  if (mapped_ && data_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+#endif
+
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+  owned_.clear();
+}
+
+source_buffer source_buffer::map_file(const std::string& file_path) {
+#ifdef FLISP_HAS_MMAP
+  int fd = open(file_path.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    throw std::runtime_error("file not found: " + file_path);
+  }
+
+  struct stat st;
+
+  // empty files cannot be mapped and pipes/devices have no fixed size,
+  // both are read through the stream fallback below instead
+
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error("failed to map file: " + file_path);
+    }
+
+    madvise(addr, size, MADV_SEQUENTIAL);
+
+    source_buffer buffer;
+    buffer.data_ = static_cast<const char*>(addr);
+    buffer.size_ = size;
+    buffer.mapped_ = true;
+    return buffer;
+  }
+
+  close(fd);
+#endif
+
+  std::ifstream file(file_path, std::ios::binary);
+
+  if (!file) {
+    throw std::runtime_error("file not found: " + file_path);
+  }
+
+  return source_buffer(std::string((std::istreambuf_iterator<char>(file)),
+                                   std::istreambuf_iterator<char>()));
+}
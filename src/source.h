@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// read-only view over program text. files are memory-mapped where the
+// platform allows it so the lexer can hand out slices of the mapping
+// instead of copying every token, the buffer must therefore outlive
+// any token (or string_view) taken from it
+
+class source_buffer {
+ public:
+  source_buffer() = default;
+  explicit source_buffer(std::string text);
+  ~source_buffer();
+
+  source_buffer(const source_buffer&) = delete;
+  source_buffer& operator=(const source_buffer&) = delete;
+  source_buffer(source_buffer&& other) noexcept;
+  source_buffer& operator=(source_buffer&& other) noexcept;
+
+  static source_buffer map_file(const std::string& file_path);
+
+  std::string_view view() const { return {data_, size_}; }
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool is_mapped() const { return mapped_; }
+
+ private:
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+  bool mapped_ = false;
+  std::string owned_;  // used for in-memory and unmappable sources
+
+  void release();
+};
+
+#endif  // SOURCE_H
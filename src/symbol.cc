@@ -0,0 +1,81 @@
+#include "./symbol.h"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+// names live in a deque so the string_view keys of the index (and the
+// references handed out by symbol_name) stay valid as the table grows
+
+class symbol_table {
+ public:
+  symbol_table() {
+    static const char* const builtins[builtin_symbol_count] = {
+        "def", "set", "debug", "fun", "if", "+",  "-",
+        "*",   "/",   "<",     ">",   "<=", ">=", "=", "while"};
+
+    for (const char* name : builtins) {
+      insert(name);
+    }
+  }
+
+  symbol_id intern(std::string_view name) {
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      auto it = index_.find(name);
+
+      if (it != index_.end()) {
+        return it->second;
+      }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = index_.find(name);  // may have been added meanwhile
+
+    return it != index_.end() ? it->second : insert(name);
+  }
+
+  const std::string& name(symbol_id id) {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    if (id >= names_.size()) {
+      throw std::out_of_range("unknown symbol id: " + std::to_string(id));
+    }
+
+    return names_[id];
+  }
+
+  std::size_t size() {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return names_.size();
+  }
+
+ private:
+  std::shared_mutex mutex_;
+  std::deque<std::string> names_;
+  std::unordered_map<std::string_view, symbol_id> index_;
+
+  symbol_id insert(std::string_view name) {
+    symbol_id id = static_cast<symbol_id>(names_.size());
+    names_.emplace_back(name);
+    index_.emplace(names_.back(), id);
+    return id;
+  }
+};
+
+symbol_table& table() {
+  static symbol_table instance;
+  return instance;
+}
+
+}  // namespace
+
+symbol_id intern(std::string_view name) { return table().intern(name); }
+
+const std::string& symbol_name(symbol_id id) { return table().name(id); }
+
+std::size_t symbol_count() { return table().size(); }
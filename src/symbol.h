@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// every distinct symbol name is interned once into a process-wide table
+// and referred to by a dense 32-bit id from then on, so evaluation can
+// compare and hash plain integers instead of strings. the table is safe
+// to use from several threads (lookups take a shared lock)
+
+using symbol_id = uint32_t;
+
+// special forms and operators are interned first so their ids are
+// fixed and can be used directly as case labels
+
+enum builtin_symbol : symbol_id {
+  symbol_def,
+  symbol_set,
+  symbol_debug,
+  symbol_fun,
+  symbol_if,
+  symbol_add,
+  symbol_sub,
+  symbol_mul,
+  symbol_div,
+  symbol_lt,
+  symbol_gt,
+  symbol_le,
+  symbol_ge,
+  symbol_eq,
+  symbol_while,
+  builtin_symbol_count
+};
+
+symbol_id intern(std::string_view name);
+const std::string& symbol_name(symbol_id id);
+std::size_t symbol_count();
+
+#endif  // SYMBOL_H
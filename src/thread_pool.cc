@@ -0,0 +1,185 @@
+#include "./thread_pool.h"
+
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace {
+
+// the pool and queue of the worker running on this thread, if any
+thread_local const void* current_pool = nullptr;
+thread_local std::size_t current_worker = 0;
+
+}  // namespace
+
+thread_pool::thread_pool(std::size_t threads) {
+  workers_.reserve(threads);
+  queues_.reserve(threads);
+
+  for (std::size_t i = 0; i < threads; ++i) {
+    queues_.push_back(std::make_unique<task_queue>());
+  }
+
+  for (std::size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back([this, i] { work(i); });
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stopping_ = true;
+  }
+
+  ready_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+std::size_t thread_pool::default_size() {
+  unsigned cores = std::thread::hardware_concurrency();
+  return cores > 1 ? cores - 1 : 1;  // the caller of parallel_for helps too
+}
+
+thread_pool& thread_pool::shared() {
+  static thread_pool pool;
+  return pool;
+}
+
+// a worker queues onto its own queue, other threads spread their tasks
+// over the queues in turn
+void thread_pool::submit(std::function<void()> task) {
+  if (queues_.empty()) {
+    task();
+    return;
+  }
+
+  std::size_t target = current_pool == this
+                           ? current_worker
+                           : next_queue_.fetch_add(1) % queues_.size();
+
+  {
+    std::lock_guard<std::mutex> lock(queues_[target]->mutex);
+    queues_[target]->tasks.push_back(std::move(task));
+  }
+
+  {
+    // under the lock, so a worker about to sleep can't miss the count
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    ++queued_;
+  }
+
+  ready_.notify_one();
+}
+
+// the newest task of worker's own queue, or else the oldest of the
+// first other queue that has any
+bool thread_pool::take(std::size_t worker, std::function<void()>& task) {
+  for (std::size_t i = 0; i < queues_.size(); ++i) {
+    task_queue& queue = *queues_[(worker + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (queue.tasks.empty()) {
+      continue;
+    }
+
+    if (i == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+
+    --queued_;
+    return true;
+  }
+
+  return false;
+}
+
+void thread_pool::work(std::size_t worker) {
+  current_pool = this;
+  current_worker = worker;
+
+  for (;;) {
+    std::function<void()> task;
+
+    if (take(worker, task)) {
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    ready_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+
+    if (stopping_ && queued_ == 0) {
+      return;
+    }
+  }
+}
+
+void thread_pool::parallel_for(std::size_t count,
+                               const std::function<void(std::size_t)>& job) {
+  if (count == 0) {
+    return;
+  }
+
+  // helpers may still be queued when the last index is done, so the
+  // shared state lives on the heap rather than on this stack frame
+
+  struct state {
+    std::atomic<std::size_t> next{0};
+    std::size_t finished = 0;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable done;
+    const std::function<void(std::size_t)>* job;
+    std::size_t count;
+  };
+
+  auto shared = std::make_shared<state>();
+  shared->job = &job;
+  shared->count = count;
+
+  auto drain = [](const std::shared_ptr<state>& s) {
+    std::size_t i;
+
+    while ((i = s->next.fetch_add(1)) < s->count) {
+      std::exception_ptr error;
+
+      try {
+        (*s->job)(i);
+      } catch (...) {
+        error = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> lock(s->mutex);
+
+      if (error && !s->error) {
+        s->error = error;
+      }
+
+      if (++s->finished == s->count) {
+        s->done.notify_all();
+      }
+    }
+  };
+
+  std::size_t helpers = std::min(count - 1, workers_.size());
+
+  for (std::size_t i = 0; i < helpers; ++i) {
+    submit([shared, drain] { drain(shared); });
+  }
+
+  drain(shared);
+
+  std::unique_lock<std::mutex> lock(shared->mutex);
+  shared->done.wait(lock, [&] { return shared->finished == count; });
+
+  if (shared->error) {
+    std::rethrow_exception(shared->error);
+  }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads with a task queue each. a worker takes
+// the newest task from its own queue and, when that is empty, steals the
+// oldest one from another's, so a worker submitting tasks keeps them to
+// itself while others are busy and idle workers spread them out.
+// parallel_for is the main entry point: the calling thread works through
+// the indices alongside the workers, so it is safe to call from inside a
+// job
+
+class thread_pool {
+ public:
+  explicit thread_pool(std::size_t threads = default_size());
+  ~thread_pool();
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  // runs job(0) .. job(count - 1) and returns once all of them have
+  // finished, rethrowing the first exception a job raised (if any)
+  void parallel_for(std::size_t count,
+                    const std::function<void(std::size_t)>& job);
+
+  std::size_t size() const { return workers_.size(); }
+
+  static std::size_t default_size();
+  static thread_pool& shared();  // process-wide pool
+
+ private:
+  struct task_queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<task_queue>> queues_;  // one per worker
+  std::atomic<std::size_t> next_queue_{0};  // for tasks from other threads
+  // tasks in all the queues. counted after a task is queued, so it can
+  // briefly be -1 while the task has been taken before being counted
+  std::atomic<std::ptrdiff_t> queued_{0};
+
+  // idle workers sleep on ready_ until something is queued
+  std::mutex sleep_mutex_;
+  std::condition_variable ready_;
+  bool stopping_ = false;
+
+  void submit(std::function<void()> task);
+  bool take(std::size_t worker, std::function<void()>& task);
+  void work(std::size_t worker);
+};
+
+#endif  // THREAD_POOL_H
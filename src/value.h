@@ -0,0 +1,237 @@
+#pragma once
+
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// interpreter values are nan-boxed into 8 bytes. a double is stored as
+// its own bits, every other type sits in the payload of a negative quiet
+// nan that no arithmetic produces (nans are canonicalized on the way in):
+//
+//   top 16 bits    payload (low 48 bits)
+//   < 0xfff9       a double
+//   0xfff9         int (signed 48 bits)
+//   0xfffa         bool
+//   0xfffb         undefined (an unbound global, never seen by programs)
+//   0xfffc         heap_string*
+//   0xfffd         callable*
+//   0xfffe         heap_int*, an int that needs more than 48 bits
+//   0xffff         gc_object* (a pair or vector), or null: the empty list
+//
+// so checking a type is a shift and compare. ints are 64 bits, only
+// those outside the 48-bit range are boxed on the heap. heap objects are
+// refcounted by the values pointing to them and shared on copy. gc
+// objects can point to each other (and so form cycles), they are not
+// counted but traced by the collector of the context owning them (see
+// gc.h). user space pointers fit in 48 bits on the 64-bit targets we
+// build for
+
+static_assert(sizeof(void*) == 8, "nan-boxing needs 64-bit pointers");
+
+class eval_context;
+class expr_value;
+
+class heap_object {
+ public:
+  virtual ~heap_object() = default;
+
+ private:
+  friend class expr_value;
+  uint32_t refs_ = 0;  // values pointing here
+};
+
+class heap_string : public heap_object {
+ public:
+  explicit heap_string(std::string text) : text(std::move(text)) {}
+
+  const std::string text;
+};
+
+class heap_int : public heap_object {
+ public:
+  explicit heap_int(int64_t value) : value(value) {}
+
+  const int64_t value;
+};
+
+class gc_object;
+
+class callable : public heap_object {
+ public:
+  // the arguments are the argc values on top of ctx.stack, which the
+  // caller pops once the call returns
+  virtual expr_value operator()(eval_context& ctx, std::size_t argc) = 0;
+};
+
+class expr_value {
+ public:
+  // an int 0, the value of forms without one (if without an else branch)
+  expr_value() : bits_(box(tag_int, 0)) {}
+  expr_value(int i) : expr_value(static_cast<int64_t>(i)) {}
+  expr_value(bool b) : bits_(box(tag_bool, b)) {}
+
+  expr_value(int64_t i) {
+    if (i >= min_small_int && i <= max_small_int) {
+      bits_ = box(tag_int, static_cast<uint64_t>(i) & payload_mask);
+    } else {
+      bits_ = box(tag_heap_int, reinterpret_cast<uintptr_t>(new heap_int(i)));
+      retain();
+    }
+  }
+
+  expr_value(double d) {
+    std::memcpy(&bits_, &d, sizeof(d));
+
+    if (d != d) {
+      bits_ = canonical_nan;
+    }
+  }
+
+  expr_value(std::string_view text)
+      : expr_value(new heap_string(std::string(text)), tag_string) {}
+  expr_value(const std::string& text)
+      : expr_value(new heap_string(text), tag_string) {}
+  expr_value(std::string&& text)
+      : expr_value(new heap_string(std::move(text)), tag_string) {}
+  expr_value(const char*) = delete;  // would silently become a bool
+
+  // takes a reference to function, which is freed with the last value
+  // holding it
+  expr_value(callable* function) : expr_value(function, tag_callable) {}
+
+  // object stays owned by its heap
+  expr_value(gc_object* object)
+      : bits_(box(tag_object, reinterpret_cast<uintptr_t>(object))) {}
+
+  static expr_value undefined() {
+    expr_value value;
+    value.bits_ = box(tag_undefined, 0);
+    return value;
+  }
+
+  static expr_value empty_list() {
+    return expr_value(static_cast<gc_object*>(nullptr));
+  }
+
+  expr_value(const expr_value& other) : bits_(other.bits_) { retain(); }
+  expr_value(expr_value&& other) noexcept : bits_(other.bits_) {
+    other.bits_ = box(tag_int, 0);
+  }
+
+  expr_value& operator=(const expr_value& other) {
+    expr_value(other).swap(*this);
+    return *this;
+  }
+
+  expr_value& operator=(expr_value&& other) noexcept {
+    expr_value(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  ~expr_value() { release(); }
+
+  void swap(expr_value& other) noexcept { std::swap(bits_, other.bits_); }
+
+  bool is_float() const { return bits_ < box(tag_int, 0); }
+  bool is_small_int() const { return tag() == tag_int; }
+  bool is_int() const { return is_small_int() || tag() == tag_heap_int; }
+  bool is_number() const {
+    return bits_ <= box(tag_int, payload_mask) || tag() == tag_heap_int;
+  }
+  bool is_bool() const { return tag() == tag_bool; }
+  bool is_undefined() const { return tag() == tag_undefined; }
+  bool is_string() const { return tag() == tag_string; }
+  bool is_callable() const { return tag() == tag_callable; }
+  bool is_empty_list() const { return bits_ == box(tag_object, 0); }
+  bool is_object() const { return tag() == tag_object && !is_empty_list(); }
+
+  // shifting the payload up to the sign bit and back sign-extends it
+  int64_t as_small_int() const {
+    return static_cast<int64_t>(bits_ << 16) >> 16;
+  }
+
+  int64_t as_int() const {
+    return is_small_int() ? as_small_int()
+                          : static_cast<heap_int*>(pointer())->value;
+  }
+
+  bool as_bool() const { return bits_ & 1; }
+
+  double as_float() const {
+    double d;
+    std::memcpy(&d, &bits_, sizeof(d));
+    return d;
+  }
+
+  // an int or a float, as a double
+  double as_number() const {
+    return is_float() ? as_float() : static_cast<double>(as_int());
+  }
+
+  const std::string& as_string() const {
+    return static_cast<heap_string*>(pointer())->text;
+  }
+
+  callable* as_callable() const { return static_cast<callable*>(pointer()); }
+
+  gc_object* as_object() const {
+    return reinterpret_cast<gc_object*>(bits_ & payload_mask);
+  }
+
+  uint64_t bits() const { return bits_; }
+
+ private:
+  static constexpr uint64_t tag_int = 0xfff9;
+  static constexpr uint64_t tag_bool = 0xfffa;
+  static constexpr uint64_t tag_undefined = 0xfffb;
+  static constexpr uint64_t tag_string = 0xfffc;
+  static constexpr uint64_t tag_callable = 0xfffd;
+  static constexpr uint64_t tag_heap_int = 0xfffe;
+  static constexpr uint64_t tag_object = 0xffff;
+  static constexpr uint64_t payload_mask = (uint64_t(1) << 48) - 1;
+  static constexpr uint64_t canonical_nan = 0x7ff8000000000000;
+  static constexpr int64_t max_small_int = (int64_t(1) << 47) - 1;
+  static constexpr int64_t min_small_int = -(int64_t(1) << 47);
+
+  uint64_t bits_;
+
+  expr_value(heap_object* object, uint64_t tag)
+      : bits_(box(tag, reinterpret_cast<uintptr_t>(object))) {
+    ++object->refs_;
+  }
+
+  static constexpr uint64_t box(uint64_t tag, uint64_t payload) {
+    return tag << 48 | payload;
+  }
+
+  uint64_t tag() const { return bits_ >> 48; }
+  bool is_heap() const {
+    return bits_ >= box(tag_string, 0) && bits_ < box(tag_object, 0);
+  }
+
+  heap_object* pointer() const {
+    return reinterpret_cast<heap_object*>(bits_ & payload_mask);
+  }
+
+  void retain() const {
+    if (is_heap()) {
+      ++pointer()->refs_;
+    }
+  }
+
+  void release() const {
+    if (is_heap() && --pointer()->refs_ == 0) {
+      delete pointer();
+    }
+  }
+};
+
+static_assert(sizeof(expr_value) == 8);
+
+#endif  // VALUE_H
@@ -0,0 +1,449 @@
+#include "./vm.h"
+
+#include <functional>
+#include <iostream>
+
+#include "./arith.h"
+#include "./compiler.h"
+#include "./error.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FLISP_COMPUTED_GOTO 1
+#endif
+
+namespace {
+
+// frames reserved per value of the initial stack. both stacks grow when
+// recursion goes deeper, so a call only allocates the first time its
+// depth is reached
+constexpr std::size_t values_per_frame = 16;
+
+[[noreturn]] void fail(const std::string& message) {
+  throw eval_error(message);
+}
+
+double to_float(const vm_value& value, const char* op) {
+  if (auto i = std::get_if<int64_t>(&value)) {
+    return *i;
+  }
+
+  if (auto f = std::get_if<double>(&value)) {
+    return *f;
+  }
+
+  fail(std::string("invalid type for ") + op);
+}
+
+template <typename Op>
+vm_value arith(const vm_value& lhs, const vm_value& rhs) {
+  auto l = std::get_if<int64_t>(&lhs);
+  auto r = std::get_if<int64_t>(&rhs);
+
+  if (l && r) {
+    int64_t out;
+
+    switch (Op::ints(*l, *r, &out)) {
+      case int_step::ok:
+        return out;
+      case int_step::overflow:
+        fail(std::string("integer overflow in ") + Op::name);
+      case int_step::inexact:
+        break;
+    }
+  }
+
+  return Op::floats(to_float(lhs, Op::name), to_float(rhs, Op::name));
+}
+
+// numbers compare as doubles unless both are ints, = also compares two
+// booleans or two strings
+template <typename Compare>
+bool compare(const vm_value& lhs, const vm_value& rhs, Compare cmp,
+             const char* name) {
+  auto l = std::get_if<int64_t>(&lhs);
+  auto r = std::get_if<int64_t>(&rhs);
+
+  if (l && r) {
+    return cmp(*l, *r);
+  }
+
+  return cmp(to_float(lhs, name), to_float(rhs, name));
+}
+
+bool equal(const vm_value& lhs, const vm_value& rhs) {
+  if (lhs.index() == rhs.index() && (std::holds_alternative<bool>(lhs) ||
+                                     std::holds_alternative<std::string>(lhs))) {
+    return lhs == rhs;
+  }
+
+  return compare(lhs, rhs, std::equal_to<>(), "=");
+}
+
+void print(std::ostream& out, const vm_value& value) {
+  std::visit(
+      [&out](auto&& arg) {
+        using T = std::decay_t<decltype(arg)>;
+
+        if constexpr (std::is_same_v<T, int64_t>) {
+          out << "int: " << arg << std::endl;
+        } else if constexpr (std::is_same_v<T, double>) {
+          out << "float: " << arg << std::endl;
+        } else if constexpr (std::is_same_v<T, bool>) {
+          out << "boolean: " << (arg ? "true" : "false") << std::endl;
+        } else if constexpr (std::is_same_v<T, std::string>) {
+          out << "string: " << arg << std::endl;
+        }
+      },
+      value);
+}
+
+}  // namespace
+
+vm::vm(std::size_t stack_size) : stack_(stack_size) {
+  frames_.reserve(stack_size / values_per_frame);
+}
+
+void vm::eval(const expr* form) {
+  std::unique_ptr<vm_function> function = compile(*this, form);
+  run(*function);
+}
+
+uint16_t vm::global_slot(symbol_id name) {
+  auto [it, added] = global_slots_.emplace(name, globals_.size());
+
+  if (added) {
+    if (globals_.size() > 0xffff) {
+      throw compile_error("too many globals");
+    }
+
+    globals_.emplace_back();
+    global_names_.push_back(name);
+  }
+
+  return it->second;
+}
+
+uint16_t vm::function_slot(symbol_id name) {
+  auto [it, added] = function_slots_.emplace(name, functions_.size());
+
+  if (added) {
+    if (functions_.size() > 0xffff) {
+      throw compile_error("too many functions");
+    }
+
+    functions_.push_back(nullptr);
+    function_names_.push_back(name);
+  }
+
+  return it->second;
+}
+
+const vm_function* vm::adopt(std::unique_ptr<vm_function> function) {
+  owned_.push_back(std::move(function));
+  return owned_.back().get();
+}
+
+void vm::bind(symbol_id name, uint8_t arity, vm_host_function function) {
+  auto bound = std::make_unique<vm_function>();
+  bound->name = name;
+  bound->arity = arity;
+  bound->host = std::move(function);
+  functions_[function_slot(name)] = adopt(std::move(bound));
+}
+
+vm_value vm::run(const vm_function& entry) {
+  if (suspended_) {
+    fail("can't run a form while another is suspended");
+  }
+
+  if (stack_.size() < entry.registers) {
+    stack_.resize(entry.registers);
+  }
+
+  return execute(&entry, entry.code.data(), 0);
+}
+
+vm_value vm::resume(vm_value value) {
+  if (!suspended_) {
+    fail("can't resume a vm that is not suspended");
+  }
+
+  suspended_ = false;
+  stack_[result_] = std::move(value);
+  return execute(resume_at_.function, resume_at_.pc, resume_at_.base);
+}
+
+vm_value vm::execute(const vm_function* function, const vm_instr* pc,
+                     std::size_t base) {
+  const vm_value* k = function->constants.data();
+  vm_value* r = stack_.data() + base;
+  vm_instr i;
+
+  // every handler ends by fetching the next instruction and jumping to
+  // its handler directly, one indirect branch per instruction. compilers
+  // without labels as values fall back to a switch in a loop
+
+#ifdef FLISP_COMPUTED_GOTO
+  static const void* const handlers[op_count] = {
+#define FLISP_VM_OP_LABEL(name) &&do_##name,
+      FLISP_VM_OPS(FLISP_VM_OP_LABEL)
+#undef FLISP_VM_OP_LABEL
+  };
+
+#define VM_CASE(name) do_##name
+#define VM_NEXT()             \
+  do {                        \
+    i = *pc++;                \
+    goto* handlers[i.op];     \
+  } while (0)
+
+  VM_NEXT();
+#else
+#define VM_CASE(name) case op_##name
+#define VM_NEXT() goto dispatch
+
+dispatch:
+  i = *pc++;
+
+  switch (i.op) {
+#endif
+
+  VM_CASE(loadk) : {
+    r[i.a] = k[i.bx()];
+    VM_NEXT();
+  }
+
+  VM_CASE(move) : {
+    r[i.a] = r[i.b];
+    VM_NEXT();
+  }
+
+  VM_CASE(getglobal) : {
+    const vm_value& value = globals_[i.bx()];
+
+    if (std::holds_alternative<std::monostate>(value)) {
+      fail("identifier '" + symbol_name(global_names_[i.bx()]) +
+           "' not found");
+    }
+
+    r[i.a] = value;
+    VM_NEXT();
+  }
+
+  VM_CASE(setglobal) : {
+    globals_[i.bx()] = r[i.a];
+    VM_NEXT();
+  }
+
+  VM_CASE(getfn) : {
+    const vm_function* callee = functions_[i.bx()];
+
+    if (!callee) {
+      fail("function '" + symbol_name(function_names_[i.bx()]) +
+           "' not found");
+    }
+
+    r[i.a] = callee;
+    VM_NEXT();
+  }
+
+  VM_CASE(setfn) : {
+    functions_[i.bx()] = std::get<const vm_function*>(r[i.a]);
+    VM_NEXT();
+  }
+
+  VM_CASE(tonumber) : {
+    to_float(r[i.b], "arithmetic");
+    r[i.a] = r[i.b];
+    VM_NEXT();
+  }
+
+  VM_CASE(add) : {
+    r[i.a] = arith<add_op>(r[i.b], r[i.c]);
+    VM_NEXT();
+  }
+
+  VM_CASE(sub) : {
+    r[i.a] = arith<sub_op>(r[i.b], r[i.c]);
+    VM_NEXT();
+  }
+
+  VM_CASE(mul) : {
+    r[i.a] = arith<mul_op>(r[i.b], r[i.c]);
+    VM_NEXT();
+  }
+
+  VM_CASE(div) : {
+    r[i.a] = arith<div_op>(r[i.b], r[i.c]);
+    VM_NEXT();
+  }
+
+  VM_CASE(lt) : {
+    r[i.a] = compare(r[i.b], r[i.c], std::less<>(), "<");
+    VM_NEXT();
+  }
+
+  VM_CASE(gt) : {
+    r[i.a] = compare(r[i.b], r[i.c], std::greater<>(), ">");
+    VM_NEXT();
+  }
+
+  VM_CASE(le) : {
+    r[i.a] = compare(r[i.b], r[i.c], std::less_equal<>(), "<=");
+    VM_NEXT();
+  }
+
+  VM_CASE(ge) : {
+    r[i.a] = compare(r[i.b], r[i.c], std::greater_equal<>(), ">=");
+    VM_NEXT();
+  }
+
+  VM_CASE(eq) : {
+    r[i.a] = equal(r[i.b], r[i.c]);
+    VM_NEXT();
+  }
+
+  VM_CASE(jump) : {
+    pc += i.sbx();
+    VM_NEXT();
+  }
+
+  VM_CASE(jumpf) : {
+    auto condition = std::get_if<bool>(&r[i.a]);
+
+    if (!condition) {
+      fail("'if' condition must evaluate to a boolean");
+    }
+
+    if (!*condition) {
+      pc += i.sbx();
+    }
+
+    VM_NEXT();
+  }
+
+  VM_CASE(loopf) : {
+    auto condition = std::get_if<bool>(&r[i.a]);
+
+    if (!condition) {
+      fail("'while' condition must evaluate to a boolean");
+    }
+
+    if (!*condition) {
+      pc += i.sbx();
+    }
+
+    VM_NEXT();
+  }
+
+  VM_CASE(call) : {
+    const vm_function* callee = std::get<const vm_function*>(r[i.a]);
+
+    if (callee->arity != i.b) {
+      fail("argument count does not match parameter count");
+    }
+
+    // a host function's result goes where the callee was, as a return
+    // would put it. a suspended vm picks up at the next instruction
+    if (callee->host) {
+      r[i.a] = callee->host(*this, r + i.a + 1);
+
+      if (suspended_) {
+        resume_at_ = {function, pc, base};
+        result_ = base + i.a;
+        return {};
+      }
+
+      VM_NEXT();
+    }
+
+    frames_.push_back({function, pc, base});
+
+    base += i.a + 1;
+    function = callee;
+    pc = function->code.data();
+    k = function->constants.data();
+
+    if (stack_.size() < base + function->registers) {
+      stack_.resize(2 * (base + function->registers));
+    }
+
+    r = stack_.data() + base;
+    VM_NEXT();
+  }
+
+  // the arguments move down to the start of our window and the callee
+  // runs in it, the frame to return to is still the caller's
+  VM_CASE(tailcall) : {
+    const vm_function* callee = std::get<const vm_function*>(r[i.a]);
+
+    if (callee->arity != i.b) {
+      fail("argument count does not match parameter count");
+    }
+
+    // there is no window to reuse for a host function, it is called as
+    // by call and its result returned
+    if (callee->host) {
+      r[i.a] = callee->host(*this, r + i.a + 1);
+      tail_return_ = vm_instr::abc(op_ret, i.a);
+
+      if (suspended_) {
+        resume_at_ = {function, &tail_return_, base};
+        result_ = base + i.a;
+        return {};
+      }
+
+      pc = &tail_return_;
+      VM_NEXT();
+    }
+
+    std::move(r + i.a + 1, r + i.a + 1 + i.b, r);
+
+    function = callee;
+    pc = function->code.data();
+    k = function->constants.data();
+
+    if (stack_.size() < base + function->registers) {
+      stack_.resize(2 * (base + function->registers));
+    }
+
+    r = stack_.data() + base;
+    VM_NEXT();
+  }
+
+  VM_CASE(ret) : {
+    if (frames_.empty()) {
+      return std::move(r[i.a]);
+    }
+
+    // the result replaces the callee in the caller's window, right
+    // below the callee's own window
+    r[-1] = std::move(r[i.a]);
+
+    frame caller = frames_.back();
+    frames_.pop_back();
+
+    function = caller.function;
+    pc = caller.pc;
+    k = function->constants.data();
+    base = caller.base;
+    r = stack_.data() + base;
+    VM_NEXT();
+  }
+
+  VM_CASE(debug) : {
+    print(*out, r[i.a]);
+    VM_NEXT();
+  }
+
+#ifndef FLISP_COMPUTED_GOTO
+    case op_count:
+      break;
+  }
+#endif
+
+  return {};
+
+#undef VM_CASE
+#undef VM_NEXT
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#ifndef VM_H
+#define VM_H
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "parser.h"
+
+// register-based bytecode vm, run with --vm instead of the tree-walking
+// interp. each top-level form is compiled (see compiler.h) into a
+// vm_function whose instructions address registers in a window of one
+// contiguous value stack. a call slides the window up so that the
+// arguments, placed right after the callee, become its first registers.
+//
+// calls run on the vm's own stack of frames and never recurse on the
+// native stack, so a program can stop in the middle of any call and
+// carry on later: a host function (see bind) suspends the program, run
+// returns, and resume continues it from the same point with the value
+// the host function was waiting for, possibly on another thread
+
+class vm;
+class vm_function;
+
+// std::monostate is an unbound global slot and never reaches a program
+using vm_value = std::variant<std::monostate, int64_t, double, bool,
+                              std::string, const vm_function*>;
+
+// a function of the host, given the arguments of the call (as many as
+// its arity). its result is the value of the call unless it suspends
+// the vm, see vm::suspend
+using vm_host_function = std::function<vm_value(vm&, const vm_value* args)>;
+
+// r[x] is a register, k[x] a constant of the running function, operands
+// are 8 bits (a, b, c) or 16 bits (bx, sbx for jumps, which are relative
+// to the next instruction)
+
+#define FLISP_VM_OPS(X)                                          \
+  X(loadk)     /* r[a] = k[bx] */                                \
+  X(move)      /* r[a] = r[b] */                                 \
+  X(getglobal) /* r[a] = globals[bx] */                          \
+  X(setglobal) /* globals[bx] = r[a] */                          \
+  X(getfn)     /* r[a] = functions[bx] */                        \
+  X(setfn)     /* functions[bx] = r[a] */                        \
+  X(tonumber)  /* r[a] = r[b], which must be a number */         \
+  X(add)       /* r[a] = r[b] + r[c] (see arith.h), likewise: */ \
+  X(sub)                                                         \
+  X(mul)                                                         \
+  X(div)                                                         \
+  X(lt)        /* r[a] = r[b] < r[c], likewise: */             \
+  X(gt)                                                          \
+  X(le)                                                          \
+  X(ge)                                                          \
+  X(eq)                                                          \
+  X(jump)      /* pc += sbx */                                   \
+  X(jumpf)     /* if r[a] is false: pc += sbx */                 \
+  X(loopf)     /* the same, testing a while condition */        \
+  X(call)      /* r[a] = r[a](r[a + 1], .., r[a + b]) */         \
+  X(tailcall)  /* return r[a](r[a + 1], .., r[a + b]) */         \
+  X(ret)       /* return r[a] */                                 \
+  X(debug)     /* print r[a] */
+
+enum vm_op : uint8_t {
+#define FLISP_VM_OP_ENUM(name) op_##name,
+  FLISP_VM_OPS(FLISP_VM_OP_ENUM)
+#undef FLISP_VM_OP_ENUM
+      op_count
+};
+
+struct vm_instr {
+  vm_op op;
+  uint8_t a;
+  uint8_t b;
+  uint8_t c;
+
+  uint16_t bx() const { return b | c << 8; }
+  int16_t sbx() const { return static_cast<int16_t>(bx()); }
+
+  static vm_instr abc(vm_op op, uint8_t a, uint8_t b = 0, uint8_t c = 0) {
+    return {op, a, b, c};
+  }
+
+  static vm_instr abx(vm_op op, uint8_t a, uint16_t bx) {
+    return {op, a, static_cast<uint8_t>(bx), static_cast<uint8_t>(bx >> 8)};
+  }
+};
+
+class vm_function {
+ public:
+  symbol_id name = 0;
+  uint8_t arity = 0;       // parameters are r[0] .. r[arity - 1]
+  uint16_t registers = 1;  // size of the register window
+  std::vector<vm_instr> code;
+  std::vector<vm_value> constants;
+  vm_host_function host;  // set for functions bound by the host only
+};
+
+class vm {
+ public:
+  // stack_size values are allocated up front, the stack grows as calls
+  // go deeper. a small one keeps the memory of many idle vms down
+  explicit vm(std::size_t stack_size = 1 << 12);
+
+  std::ostream* out = &std::cout;  // where debug writes
+
+  // compiles and runs one top-level form, a program is run by passing
+  // each of its forms in order
+  void eval(const expr* form);
+
+  // runs a compiled top-level form (see compile()) and returns its value.
+  // when a host function suspends the vm, this returns nothing instead
+  // and entry has to be kept until the form is resumed to its end
+  vm_value run(const vm_function& entry);
+
+  // binds name to a host function taking arity arguments, replacing any
+  // function of that name
+  void bind(symbol_id name, uint8_t arity, vm_host_function function);
+
+  // called from a host function to stop the program once it returns
+  void suspend() { suspended_ = true; }
+  bool suspended() const { return suspended_; }
+
+  // continues a suspended program with value as the result of the host
+  // function that suspended it, and returns as run does
+  vm_value resume(vm_value value);
+
+  // globals and functions live in separate namespaces (as globals and
+  // fmap do for the interpreter), the compiler turns names into slots once
+  // so the running code only ever indexes into these tables
+
+  uint16_t global_slot(symbol_id name);
+  uint16_t function_slot(symbol_id name);
+
+  // functions are kept for as long as the vm, since a definition can be
+  // called long after the form that compiled it is gone
+  const vm_function* adopt(std::unique_ptr<vm_function> function);
+
+ private:
+  struct frame {
+    const vm_function* function;
+    const vm_instr* pc;  // where to resume the caller
+    std::size_t base;    // first register of the caller's window
+  };
+
+  std::vector<vm_value> stack_;
+  std::vector<frame> frames_;
+
+  // where a suspended program carries on: the running function, the
+  // next instruction and the window, with the host call's result going
+  // to stack_[result_]. a host function called in tail position resumes
+  // at tail_return_, which returns that result
+  bool suspended_ = false;
+  frame resume_at_{};
+  std::size_t result_ = 0;
+  vm_instr tail_return_{};
+
+  std::vector<vm_value> globals_;
+  std::vector<symbol_id> global_names_;
+  std::unordered_map<symbol_id, uint16_t> global_slots_;
+
+  std::vector<const vm_function*> functions_;
+  std::vector<symbol_id> function_names_;
+  std::unordered_map<symbol_id, uint16_t> function_slots_;
+
+  std::vector<std::unique_ptr<vm_function>> owned_;
+
+  vm_value execute(const vm_function* function, const vm_instr* pc,
+                   std::size_t base);
+};
+
+#endif  // VM_H
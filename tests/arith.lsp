@@ -0,0 +1,16 @@
+(fun add (a b) ((+ a b)))
+(fun sub (a b) ((- a b)))
+(fun mul (a b) ((* a b)))
+(fun div (a b) ((/ a b)))
+(def max 9223372036854775807)
+(def min (sub (sub 0 max) 1))
+(debug max min)
+(debug (add max 0) (sub min 0) (mul max 1) (mul min 1) (sub 0 max))
+(debug (add (sub max 1) 1) (mul 3037000499 3037000499))
+(debug (add 140737488355327 1) (sub (sub 0 140737488355328) 1))
+(debug (div 8 2) (div (div 12 2) 3) (div min 1) (div min (sub 0 2)))
+(debug (div 7 2) (div 1 3) (div (div 12 2) 4) (div min 3))
+(debug (add 1 0.5) (sub 2 0.5) (mul 3 0.5) (div 3 0.5) (div 1.5 0.5))
+(debug (add max 1.0) (mul max 2.0) (sub min 1.0) (div max 0.5))
+(debug (< (div 7 2) 4) (= (div 7 2) 3.5) (= (div 8 2) 4) (> max 1.0))
+(debug (+ 0.5 1 2) (* 2 0.25 4) (/ 7 2) (/ 12 2 3) (- 1 0.5))
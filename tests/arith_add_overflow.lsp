@@ -0,0 +1,4 @@
+(fun add (a b) ((+ a b)))
+(def max 9223372036854775807)
+(debug (add max 0))
+(debug (add 1 max))
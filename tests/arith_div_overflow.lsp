@@ -0,0 +1,4 @@
+(fun div (a b) ((/ a b)))
+(def min (- (- 0 9223372036854775807) 1))
+(debug (div min 1))
+(debug (div min (- 0 1)))
@@ -0,0 +1,3 @@
+(fun mul (a b c) ((* a b c)))
+(debug (mul 3037000499 3037000499 1))
+(debug (mul 4294967296 4294967296 0.5))
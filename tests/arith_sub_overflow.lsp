@@ -0,0 +1,4 @@
+(fun sub (a b) ((- a b)))
+(def min (sub (sub 0 9223372036854775807) 1))
+(debug (sub min 0))
+(debug (sub min 1))
@@ -0,0 +1,29 @@
+(fun check (n) ((def a (arr_add (array_range n) 0.5)) (def b (arr_sub 10.0 (array_range n))) (debug n a b (arr_add a b) (arr_sub a 1) (arr_mul 2 a) (arr_div a b) (arr_div 1 b) (arr_sum a) (arr_dot a b)) (if (> n 0) (debug (arr_min a) (arr_max b) (arr_min b) (arr_max a)))))
+
+(check 0)
+
+(check 1)
+
+(check 3)
+
+(check 5)
+
+(check 9)
+
+(def ints (array_range 9))
+
+(debug (arr_mul ints 3) (arr_sub ints (arr_add ints 1)) (arr_sum ints) (arr_dot ints ints))
+
+(debug (arr_div (array 2 4 6) 2) (arr_div (array 2 4 7) 2) (arr_div 60 (array 1 2 3 4 5)))
+
+(debug (arr_div 7 (array 1 2 3)) (arr_min (array 5 (- 0 3) 7)) (arr_max (array 5 (- 0 3) 7)))
+
+(debug (arr_add (array 1 2 3) (array 0.5 0.25 0)) (array 1 2.5) (to_array (list 1 2 3)))
+
+(fun half (x) ((/ x 2)))
+
+(debug (arr_map "half" (array 2 4 6)) (arr_map "half" (array 1 2 3)) (arr_map "half" (array)))
+
+(debug (arr_sum (array)) (arr_dot (array) (array)) (arr_add (array) 1))
+
+(debug (arr_min (arr_mul (array_range 0) 0.5)))
@@ -0,0 +1,160 @@
+// c++ functions bound with eval_context::bind, called from scripts:
+// arguments of each supported type converted on the way in, results on
+// the way out (void ones giving 0), and calls rejected for the wrong
+// argument count, an argument of the wrong type or an int that doesn't
+// fit the parameter
+
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "error.h"
+#include "interp.h"
+#include "parser.h"
+
+static int failures = 0;
+
+static std::vector<int64_t> recorded;
+
+static int add_small(int a, int8_t b) { return a + b; }
+
+static std::string greet(const std::string& name) { return "hello " + name; }
+
+static std::size_t count_bytes(std::string_view text) { return text.size(); }
+
+static const char* parity(uint16_t n) { return n % 2 ? "odd" : "even"; }
+
+static float half(double x) { return x / 2; }
+
+static bool negate(bool b) { return !b; }
+
+static void record(int64_t n) { recorded.push_back(n); }
+
+static void define(eval_context& ctx) {
+  ctx.bind("add_small", &add_small);
+  ctx.bind("greet", &greet);
+  ctx.bind("count_bytes", &count_bytes);
+  ctx.bind("parity", &parity);
+  ctx.bind("half", &half);
+  ctx.bind("negate", &negate);
+  ctx.bind("record", &record);
+  ctx.bind("same", [](const expr_value& value) { return value; });
+}
+
+static std::string run(const std::string& source) {
+  eval_context ctx;
+  interp evaluator;
+  std::ostringstream out;
+  ctx.out = &out;
+  define(ctx);
+  evaluator.eval(ctx, parse_source(source), true);
+  return out.str();
+}
+
+static void expect(const std::string& source, const std::string& expected) {
+  std::string output = run(source);
+
+  if (output != expected) {
+    std::cerr << source << ": printed '" << output << "'" << std::endl;
+    ++failures;
+  }
+}
+
+// source has to stop with error
+static void expect_error(const std::string& source, const std::string& error) {
+  try {
+    run(source);
+    std::cerr << source << ": no error" << std::endl;
+    ++failures;
+  } catch (const eval_error& thrown) {
+    if (thrown.what() != error) {
+      std::cerr << source << ": " << thrown.what() << std::endl;
+      ++failures;
+    }
+  }
+}
+
+int main() {
+  // conversions in and out
+  expect("(debug (add_small 2147483647 (- 0 128)) (add_small (- 0 5) 127))",
+         "int: 2147483519\nint: 122\n");
+  expect("(debug (greet \"there\") (count_bytes \"four\") (count_bytes \"\"))",
+         "string: hello there\nint: 4\nint: 0\n");
+  expect("(debug (parity 65535) (parity 0))", "string: odd\nstring: even\n");
+  expect("(debug (half 3) (half 2.5) (negate #f))",
+         "float: 1.5\nfloat: 1.25\nboolean: true\n");
+  expect("(debug (same 1) (same \"s\") (same #t) (same 0.5))",
+         "int: 1\nstring: s\nboolean: true\nfloat: 0.5\n");
+
+  // void results are nothing, which is 0
+  expect("(def r (record 7)) (record 8) (debug r)", "int: 0\n");
+
+  if (recorded != std::vector<int64_t>{7, 8}) {
+    std::cerr << "record was called " << recorded.size() << " times"
+              << std::endl;
+    ++failures;
+  }
+
+  // binding a name again replaces the function, also at cached call sites
+  {
+    eval_context ctx;
+    interp evaluator;
+    std::ostringstream out;
+    ctx.out = &out;
+    define(ctx);
+    evaluator.eval(ctx, parse_source("(fun call (x) ((half x)))"), true);
+    evaluator.eval(ctx, parse_source("(debug (call 4))"), true);
+    ctx.bind("half", [](int64_t x) { return x * 2; });
+    evaluator.eval(ctx, parse_source("(debug (call 4))"), true);
+
+    if (out.str() != "float: 2\nint: 8\n") {
+      std::cerr << "rebinding: printed '" << out.str() << "'" << std::endl;
+      ++failures;
+    }
+  }
+
+  // argument count
+  expect_error("(debug (greet \"a\" \"b\"))",
+               "argument count does not match parameter count");
+  expect_error("(debug (negate))",
+               "argument count does not match parameter count");
+
+  // argument types
+  expect_error("(debug (greet 1))", "invalid type for argument 1 of 'greet'");
+  expect_error("(debug (half \"1\"))", "invalid type for argument 1 of 'half'");
+  expect_error("(debug (negate 0))",
+               "invalid type for argument 1 of 'negate'");
+  expect_error("(debug (add_small 1.0 1))",
+               "invalid type for argument 1 of 'add_small'");
+  expect_error("(debug (count_bytes #t))",
+               "invalid type for argument 1 of 'count_bytes'");
+
+  // ints that don't fit the parameter
+  expect_error("(debug (add_small 2147483648 0))",
+               "invalid type for argument 1 of 'add_small'");
+  expect_error("(debug (add_small (- 0 2147483649) 0))",
+               "invalid type for argument 1 of 'add_small'");
+  expect_error("(debug (add_small 0 128))",
+               "invalid type for argument 2 of 'add_small'");
+  expect_error("(debug (add_small 0 (- 0 129)))",
+               "invalid type for argument 2 of 'add_small'");
+  expect_error("(debug (parity 65536))",
+               "invalid type for argument 1 of 'parity'");
+  expect_error("(debug (parity (- 0 1)))",
+               "invalid type for argument 1 of 'parity'");
+
+  // the range check at the edges of 64-bit types
+  if (!host_accepts<uint64_t>(expr_value(INT64_MAX)) ||
+      host_accepts<uint64_t>(expr_value(int64_t(-1))) ||
+      !host_accepts<int64_t>(expr_value(INT64_MIN)) ||
+      !host_accepts<const int&>(expr_value(int64_t(-2147483648LL))) ||
+      host_accepts<uint32_t>(expr_value(int64_t(1) << 32))) {
+    std::cerr << "host_accepts: wrong range" << std::endl;
+    ++failures;
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+(fun g (x) ((list x)))
+
+(fun h (x) ((g x)))
+
+(def i 0)
+
+(def n 0)
+
+(while (< i 10) (set n (+ n (length (h i)))) (set i (+ i 1)))
+
+(debug n)
@@ -0,0 +1,3 @@
+(debug 1)
+
+(def x)
@@ -0,0 +1,145 @@
+// document edits against parsing from scratch: after every edit the
+// forms of the document (their text ranges and trees) have to be the
+// ones a fresh parse of the edited source gives, and an edit that leaves
+// the source unparseable has to throw and leave the document as it was
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "document.h"
+
+static int failures = 0;
+
+static std::string written(const expr* node) {
+  std::ostringstream out;
+  write_source(out, node);
+  return out.str();
+}
+
+// the document against parse_source and a document made from its source
+static void compare(const document& edited, const std::string& what) {
+  const std::string& source = edited.source();
+  document fresh(source);
+  auto parsed = expr_cast<list_expr>(parse_source(source)->root);
+  const auto& forms = edited.forms();
+  bool same = forms.size() == fresh.forms().size() &&
+              forms.size() == parsed->get_exprs().size();
+
+  for (std::size_t i = 0; same && i < forms.size(); ++i) {
+    same = forms[i].begin == fresh.forms()[i].begin &&
+           forms[i].end == fresh.forms()[i].end &&
+           written(forms[i].tree->root) == written(parsed->get_exprs()[i]);
+  }
+
+  same = same && written(edited.tree()->root) == written(parsed);
+
+  if (!same) {
+    std::cerr << what << ": the forms differ from a full parse of '"
+              << source << "'" << std::endl;
+    ++failures;
+  }
+}
+
+static void edit(document& doc, std::size_t offset, std::size_t length,
+                 std::string_view text, const std::string& what) {
+  std::string expected = doc.source();
+  expected.replace(offset, length, text);
+
+  try {
+    doc.edit(offset, length, text);
+  } catch (const syntax_error& error) {
+    std::cerr << what << ": " << error.what() << " in '" << expected << "'"
+              << std::endl;
+    ++failures;
+    return;
+  }
+
+  if (doc.source() != expected) {
+    std::cerr << what << ": the source is '" << doc.source() << "'"
+              << std::endl;
+    ++failures;
+  }
+
+  compare(doc, what);
+}
+
+static void failing_edit(document& doc, std::size_t offset,
+                         std::size_t length, std::string_view text,
+                         const std::string& what) {
+  std::string before = doc.source();
+
+  try {
+    doc.edit(offset, length, text);
+    std::cerr << what << ": no syntax error" << std::endl;
+    ++failures;
+  } catch (const syntax_error&) {
+    if (doc.source() != before) {
+      std::cerr << what << ": the source changed" << std::endl;
+      ++failures;
+    }
+  }
+
+  compare(doc, what);
+}
+
+int main() {
+  document doc(
+      "(def a (+ 1 2))\n(def b \"x\")\n(fun f (x) ((* x a)))\n"
+      "(debug (f 3))\n");
+  compare(doc, "initial");
+
+  // inside a form: only that one is re-parsed
+  edit(doc, doc.source().find("2)"), 1, "20", "inside a form");
+
+  if (doc.last_reparsed() != 1) {
+    std::cerr << "inside a form: " << doc.last_reparsed()
+              << " forms re-parsed" << std::endl;
+    ++failures;
+  }
+
+  // across the boundary of two forms, keeping both
+  std::size_t at = doc.source().find("\")\n(fun f");
+  edit(doc, at, 8, "\") (fun g", "across forms");
+
+  // across a boundary, joining the first two forms into one
+  at = doc.source().find("))\n(def b");
+  edit(doc, at, 9, ") b", "joining forms");
+
+  // a symbol running into the next form, then split off again
+  at = doc.source().find("(fun g");
+  edit(doc, at - 1, 1, "c", "joining tokens");
+  edit(doc, at - 1, 1, " c ", "splitting tokens");
+
+  // moving the closing paren of the first form to the end: it swallows
+  // all the others, and moving it back gives them back
+  std::string original = doc.source();
+  std::string swallowing = original;
+  swallowing.erase(swallowing.find("\"x\")") + 3, 1);
+  swallowing.insert(swallowing.size() - 1, ")");
+  doc.reload(swallowing);
+  compare(doc, "unbalanced, swallowing");
+
+  if (doc.forms().size() != 1) {
+    std::cerr << "unbalanced, swallowing: " << doc.forms().size() << " forms"
+              << std::endl;
+    ++failures;
+  }
+
+  doc.reload(original);
+  compare(doc, "rebalanced");
+
+  // edits leaving the source unparseable
+  failing_edit(doc, doc.source().size() - 2, 1, "", "unclosed form");
+  failing_edit(doc, doc.source().find("(fun"), 0, ")", "stray paren");
+  failing_edit(doc, doc.source().find("\"x\"") + 2, 1, "", "unclosed string");
+
+  // reload applies the difference as a single edit
+  std::string reloaded = doc.source();
+  reloaded.insert(reloaded.find("(fun"), "(debug (g 2))\n");
+  doc.reload(reloaded);
+  compare(doc, "reload");
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+// scripts run side by side in isolates of their own, each checked for
+// what it printed: the same script many times over, scripts defining the
+// same names differently, and scripts stopping with an error while
+// running or resolving, which must leave the others to finish untouched.
+// an isolate that had an error keeps what ran before it and runs on
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "error.h"
+#include "isolate.h"
+
+static int failures = 0;
+
+static void expect(const std::string& what, const std::string& output,
+                   const std::string& expected) {
+  if (output != expected) {
+    std::cerr << what << ": printed '" << output << "'" << std::endl;
+    ++failures;
+  }
+}
+
+// sums 1..n through a recursive function, in a global named after the
+// script so every script defines the same names to something else
+static std::string summing(int n) {
+  return "(def total 0)"
+         "(fun sum (n acc) ((if (= n 0) acc (sum (- n 1) (+ acc n)))))"
+         "(fun add (n) ((set total (+ total (sum n 0)))))"
+         "(add " + std::to_string(n) + ") (add " + std::to_string(n) + ")"
+         "(debug total)";
+}
+
+static std::string summed(int n) {
+  return "int: " + std::to_string(int64_t(n) * (n + 1)) + "\n";
+}
+
+int main() {
+  std::vector<std::shared_ptr<const script>> scripts;
+  std::vector<std::string> expected;
+
+  for (int i = 0; i < 24; ++i) {
+    switch (i % 4) {
+      case 0:  // the same script in many isolates
+        scripts.push_back(std::make_shared<const script>(summing(1000)));
+        expected.push_back(summed(1000));
+        break;
+      case 1:
+        scripts.push_back(std::make_shared<const script>(summing(i * 10)));
+        expected.push_back(summed(i * 10));
+        break;
+      case 2:  // a type error deep in a call, after printing
+        scripts.push_back(std::make_shared<const script>(
+            "(fun deep (n) ((if (= n 0) (+ 1 #t) (+ 1 (deep (- n 1))))))"
+            "(debug 1) (debug (deep 50)) (debug 2)"));
+        expected.push_back("int: 1\nerror: invalid type for add\n");
+        break;
+      case 3:  // resolving fails, so nothing runs: set doesn't declare
+        scripts.push_back(std::make_shared<const script>(
+            "(debug 1) (set later 1) (def later 2) (debug later)"));
+        expected.push_back("error: identifier 'later' not found\n");
+        break;
+    }
+  }
+
+  thread_pool pool(4);
+  std::vector<std::string> outputs = run_isolated(scripts, nullptr, pool);
+
+  for (std::size_t i = 0; i < scripts.size(); ++i) {
+    expect("script " + std::to_string(i), outputs[i], expected[i]);
+  }
+
+  // running again after an error, with the globals defined before it
+  isolate context;
+
+  try {
+    context.run(script("(def kept 5) (fun boom () ((/ kept 0)))"
+                       "(debug kept) (boom)"));
+    std::cerr << "boom: no error" << std::endl;
+    ++failures;
+  } catch (const eval_error& error) {
+    expect("boom", error.what(), "div by zero");
+  }
+
+  context.run(script("(set kept (+ kept 1)) (debug kept)"));
+  expect("after boom", context.output(), "int: 5\nint: 6\n");
+
+  return failures == 0 ? 0 : 1;
+}
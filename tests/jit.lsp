@@ -0,0 +1,51 @@
+(fun sq (x) ((* x x)))
+
+(fun half (x) ((/ x 2)))
+
+(fun sign (a b) ((if (< a b) (- 0 1) (if (> a b) 1 0))))
+
+(fun within (lo hi x) ((if (<= lo x) (if (>= hi x) 1 0) 0)))
+
+(fun same (a b) ((if (= a b) 1 0)))
+
+(fun fib (n) ((if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))
+
+(fun count (n acc) ((if (= n 0) acc (count (- n 1) (+ acc n)))))
+
+(def squares 0)
+
+(def halves 0)
+
+(def signs 0)
+
+(def inside 0)
+
+(def equal 0)
+
+(def i 0)
+
+(while (< i 1500) (set squares (+ squares (sq i))) (set halves (+ halves (half (* 2 i)))) (set signs (+ signs (sign i 750))) (set inside (+ inside (within 500 1000 i))) (set equal (+ equal (same (* 3 (/ (* 3 i) 3)) (* 3 i)))) (set i (+ i 1)))
+
+(debug squares halves signs inside equal)
+
+(debug (half 7) (half 8) (half (- 0 9)))
+
+(set halves 0)
+
+(set i 0)
+
+(while (< i 20) (set halves (+ halves (half (+ (* 2 i) 1)))) (set i (+ i 1)))
+
+(debug halves)
+
+(def floats 0.0)
+
+(set signs 0)
+
+(set i 0)
+
+(while (< i 1500) (set floats (+ floats (sq (+ i 0.5)))) (set signs (+ signs (sign (* i 0.5) 375.25))) (set i (+ i 1)))
+
+(debug floats signs (sq 3) (sq 1.5) (within 0 10 2.5) (within 0.5 1 0.25) (same 1 1.0) (same 0.5 0.25))
+
+(debug (fib 20) (count 100000 0) (count 10 0.5))
@@ -0,0 +1,11 @@
+(fun ratio (a b) ((/ a b)))
+
+(def i 1)
+
+(def total 0)
+
+(while (< i 1500) (set total (+ total (ratio (* 2 i) 2))) (set i (+ i 1)))
+
+(debug total (ratio 1.5 0.5))
+
+(debug (ratio 1 0))
@@ -0,0 +1,9 @@
+(fun next (x) ((+ x 1)))
+
+(def i 0)
+
+(while (< i 1500) (set i (next i)))
+
+(debug i (next 9223372036854775806))
+
+(debug (next 9223372036854775807))
@@ -0,0 +1,187 @@
+// chunked_lexer against lexer: the same source read in chunks of every
+// size from 1 byte up to the whole file has to give the same tokens, so
+// every token (a symbol, a number, a string holding parens and spaces, a
+// boolean, a paren) straddles a chunk boundary at some size.
+//
+// then the scanners the lexer is built on, with each isa scan_select can
+// force, against loops over char_class_table: runs of every length up to
+// a few 16 and 32 byte vectors, ended at every position by a byte outside
+// the class, non-ascii ones included (some of which are a class member
+// with the top bit set, to catch signed compares). the bytes after the
+// end of the input belong to the class, so reading past it shows up
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lexer.h"
+#include "scan.h"
+
+static const char* source =
+    "(def counter 12345)\n"
+    "(fun add_one (x) ((+ x 1.25)))\n"
+    "(debug \"a (string) with ) and (\" #t #f .5 counter)\n"
+    "(set counter (add_one 6789.0))(debug counter)";
+
+struct scanner {
+  const char* name;
+  std::size_t (*scan)(const char*, std::size_t);
+  bool (*in_run)(unsigned char);  // the bytes the scanner skips over
+};
+
+static const scanner scanners[] = {
+    {"whitespace", scan_whitespace,
+     [](unsigned char c) { return is_char_class(c, char_space); }},
+    {"symbol", scan_symbol,
+     [](unsigned char c) { return is_char_class(c, char_symbol); }},
+    {"number", scan_number,
+     [](unsigned char c) { return is_char_class(c, char_number); }},
+    {"string", scan_string, [](unsigned char c) { return c != '"'; }},
+    {"structural", scan_structural,
+     [](unsigned char c) { return !is_char_class(c, char_structural); }},
+};
+
+// bytes ending a run: a few ascii ones and each of ' ', '\t', '0', '.',
+// 'a', 'A', '_', '(' and '"' with the top bit set
+static const unsigned char stops[] = {
+    ' ', '\n', '0', '.', 'a', '_', '(', ')', '"', '#', '@', '[', '`', '{',
+    0x7f, 0x80, 0xa0, 0x89, 0xb0, 0xae, 0xe1, 0xc1, 0xdf, 0xa8, 0xa2, 0xff};
+
+static std::size_t reference(const scanner& s, const char* p, std::size_t n) {
+  std::size_t i = 0;
+
+  while (i < n && s.in_run(static_cast<unsigned char>(p[i]))) {
+    ++i;
+  }
+
+  return i;
+}
+
+static int check_scanners(scan_isa isa) {
+  int failures = 0;
+
+  for (const scanner& s : scanners) {
+    std::vector<char> run;  // every byte of the run, in turn
+
+    for (int c = 0; c < 256; ++c) {
+      if (s.in_run(c)) {
+        run.push_back(static_cast<char>(c));
+      }
+    }
+
+    for (std::size_t n = 0; n <= 100; ++n) {
+      std::vector<char> buffer(n + 64);
+
+      for (std::size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = run[(i * 7 + n) % run.size()];
+      }
+
+      // the run reaching the end of the input, then ending at each byte
+      std::size_t got = s.scan(buffer.data(), n);
+
+      if (got != n) {
+        std::cerr << scan_isa_name(isa) << " " << s.name << ": " << got
+                  << " of a run of " << n << std::endl;
+        ++failures;
+      }
+
+      for (std::size_t end = 0; end < n; ++end) {
+        for (unsigned char stop : stops) {
+          if (s.in_run(stop)) {
+            continue;
+          }
+
+          char kept = buffer[end];
+          buffer[end] = static_cast<char>(stop);
+          got = s.scan(buffer.data(), n);
+          buffer[end] = kept;
+
+          if (got != end) {
+            std::cerr << scan_isa_name(isa) << " " << s.name << ": " << got
+                      << " of " << n << " with byte " << int(stop) << " at "
+                      << end << std::endl;
+            ++failures;
+            break;
+          }
+        }
+      }
+    }
+
+    // and from every byte of a short mixed input
+    const char text[] = "  \t12.5e (sym-bol \"str\xc3\xa9\") ";
+
+    for (std::size_t at = 0; at < sizeof(text) - 1; ++at) {
+      if (s.scan(text + at, sizeof(text) - 1 - at) !=
+          reference(s, text + at, sizeof(text) - 1 - at)) {
+        std::cerr << scan_isa_name(isa) << " " << s.name << ": differs at "
+                  << at << std::endl;
+        ++failures;
+      }
+    }
+  }
+
+  return failures;
+}
+
+int main() {
+  std::string path =
+      (std::filesystem::temp_directory_path() / "flisp_test_lexer.lsp")
+          .string();
+  std::ofstream(path, std::ios::binary) << source;
+
+  // copies, since a token's value is a view into the lexer's window
+  std::vector<std::pair<token_type, std::string>> expected;
+
+  for (const token& tok : tokenize(source)) {
+    expected.emplace_back(tok.get_type(), std::string(tok.get_value()));
+  }
+
+  int failures = 0;
+  std::size_t length = std::string(source).size();
+
+  for (std::size_t chunk = 1; chunk <= length + 1; ++chunk) {
+    chunked_lexer tokens(path, chunk);
+    std::size_t i = 0;
+    bool mismatch = false;
+
+    for (token tok = tokens.next();
+         tok.get_type() != token_type::token_end_of_file;
+         tok = tokens.next(), ++i) {
+      if (i >= expected.size() || tok.get_type() != expected[i].first ||
+          tok.get_value() != expected[i].second) {
+        std::cerr << "chunks of " << chunk << ": token " << i << " is "
+                  << tok.get_type() << " '" << tok.get_value() << "'"
+                  << std::endl;
+        mismatch = true;
+        break;
+      }
+    }
+
+    if (!mismatch && i != expected.size()) {
+      std::cerr << "chunks of " << chunk << ": " << i << " tokens instead of "
+                << expected.size() << std::endl;
+      mismatch = true;
+    }
+
+    failures += mismatch;
+  }
+
+  std::remove(path.c_str());
+
+  scan_isa detected = scan_detect();
+
+  for (scan_isa isa : {scan_isa::scalar, scan_isa::sse2, scan_isa::avx2}) {
+    if (scan_select(isa)) {
+      failures += check_scanners(isa);
+    } else if (static_cast<int>(isa) <= static_cast<int>(detected)) {
+      std::cerr << scan_isa_name(isa) << " could not be selected" << std::endl;
+      ++failures;
+    }
+  }
+
+  scan_select(detected);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+(def l (list 1 2 3))
+
+(debug l (car l) (cdr l) (is_empty (cdr (cdr (cdr l)))) (length l))
+
+(def v (vec "a" 2 3.5))
+
+(vec_push v (cons 0 l))
+
+(debug v (vec_get v 2) (length v))
+
+(fun build (n acc) ((if (= n 0) acc (build (- n 1) (cons n acc)))))
+
+(def kept (build 1000 (list)))
+
+(def old (vec 1 2 3))
+
+(def young (vec))
+
+(gc)
+
+(fun put (v i) ((vec_set v i (list i (vec i "young") (build 3 (list))))))
+
+(put old 0)
+
+(vec_push old (build 5 (list)))
+
+(def junk 0)
+
+(def i 0)
+
+(while (< i 20000) (set junk (list i i i i)) (set i (+ i 1)))
+
+(put old 1)
+
+(vec_push young (cons "survivor" kept))
+
+(set i 0)
+
+(while (< i 20000) (set junk (list i i i i)) (set i (+ i 1)))
+
+(debug old (length kept) (car kept) (car (cdr (vec_get young 0))))
+
+(gc)
+
+(debug old (vec_get old 3) (length (vec_get young 0)))
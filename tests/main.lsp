@@ -27,3 +27,19 @@
 (def n (add 99 3))
 
 (debug n (add 0.1 0.2))
+
+(debug (< 1 2) (>= 1 2.5) (= "a" "a"))
+
+(fun fib (n) ((if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))
+
+(debug (fib 20))
+
+(fun sum_to (n acc) ((if (= n 0) acc (sum_to (- n 1) (+ acc n)))))
+
+(debug (sum_to 100000 0))
+
+(def i 0)
+
+(while (< i 3) (set i (+ i 1)))
+
+(debug i)
@@ -0,0 +1,5 @@
+(debug 1)
+
+(fun f (a) ((fun g () (a))))
+
+(debug 2)
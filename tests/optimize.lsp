@@ -0,0 +1,14 @@
+(def width 8)
+(def height 2.5)
+(def name "box")
+(def counter 0)
+(def twice 1)
+(def twice 2)
+(def derived (* width 2))
+(fun area (scale) ((* width height scale)))
+(fun fails () ((debug (/ 1 0) (+ 9223372036854775807 1) (+ 1 #t))))
+(debug (+ 1 2 3) (* 2 (- 10 4)) (/ 7 2) (< 1 2.5) (= 3 3))
+(debug (if (< 1 2) "yes" "no") (if #f 1) (if (= 1 2) 1 (+ 2 2)))
+(debug (+ width 1) name (area 2) derived twice)
+(set counter (+ counter width))
+(debug counter)
@@ -0,0 +1,35 @@
+(fun square (x) ((* x x)))
+
+(fun is_even (x) ((= (* (/ x 2) 2) x)))
+
+(fun add (a b) ((+ a b)))
+
+(fun last (a b) (b))
+
+(def scale 3)
+
+(fun scaled (x) ((+ (square x) scale)))
+
+(def a (array_range 1000))
+
+(def mapped (pmap "square" a))
+
+(debug (length mapped) (arr_sum (arr_sub mapped (arr_map "square" a))) (arr_get mapped 999))
+
+(debug (pmap "square" (list 1 2 3 4 5 6 7 8 9 10)) (pmap "scaled" (vec 1 2 3)) (pmap "square" (pvec)))
+
+(debug (pfilter "is_even" (list 1 2 3 4 5 6 7 8 9 10 11 12)) (pfilter "is_even" (pvec 1 3 5)))
+
+(def kept (pfilter "is_even" a))
+
+(debug (length kept) (arr_get kept 0) (arr_get kept 499))
+
+(def total 0)
+
+(def i 0)
+
+(while (< i 1000) (set total (add total i)) (set i (+ i 1)))
+
+(debug total (preduce "add" 0 a) (preduce "add" 0.5 (array 1 2)) (preduce "add" 7 (list)))
+
+(debug (preduce "last" 0 a) (preduce "last" 0 (list 5 6 7 8 9 10 11)))
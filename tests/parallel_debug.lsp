@@ -0,0 +1,7 @@
+(fun shout (x) ((debug x)))
+
+(fun loud (x) ((shout x)))
+
+(def r (pfilter "loud" (list 1 2)))
+
+(debug r)
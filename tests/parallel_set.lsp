@@ -0,0 +1,7 @@
+(def total 0)
+
+(fun bad (x) ((set total x)))
+
+(def r (pmap "bad" (array 1 2 3)))
+
+(debug r)
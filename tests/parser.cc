@@ -0,0 +1,97 @@
+// parse_parallel against parse_source: a program cut into pieces that are
+// parsed on the thread pool has to come back as the same tree, and an
+// invalid one has to fail with the same error, located in the whole
+// source, even when the error is in a later piece than the first
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "parser.h"
+#include "scan.h"
+
+static int failures = 0;
+
+static std::string text_of(const ast& tree) {
+  std::ostringstream os;
+  write_source(os, tree.root);
+  return os.str();
+}
+
+// the message source fails to parse with, empty if it parses
+template <typename Parse>
+static std::string error_of(const std::string& source, Parse parse) {
+  try {
+    parse(source);
+  } catch (const syntax_error& error) {
+    return error.what();
+  }
+
+  return "";
+}
+
+static std::string program(int forms) {
+  std::string code;
+
+  for (int i = 0; i < forms; ++i) {
+    std::string n = std::to_string(i);
+    code += "(def g" + n + " " + n + ")\n";
+    code += "(fun f" + n + " (x) ((+ x " + n + ".5 (* g" + n + " 2))))\n";
+    code += "(debug \"form (" + n + ") with ) and (\" #t #f (f" + n +
+            " (- 0 " + n + ")))\n\n";
+  }
+
+  return code;
+}
+
+int main() {
+  const std::string source = program(40);
+  const std::size_t lines = 4 * 40;
+
+  for (std::size_t chunks : {2, 3, 4, 7, 16}) {
+    std::string label = std::to_string(chunks) + " chunks";
+
+    // the source really is cut, rather than parsed in one piece
+    if (split_top_level(source, chunks).empty()) {
+      std::cerr << label << ": not split" << std::endl;
+      ++failures;
+    }
+
+    if (text_of(*parse_parallel(source, chunks)) !=
+        text_of(*parse_source(source))) {
+      std::cerr << label << ": the trees differ" << std::endl;
+      ++failures;
+    }
+
+    // an error in the last piece, and two errors in different pieces
+    // of which the earlier one has to be reported
+    const std::string broken[] = {
+        source + "(debug 1 $)\n",
+        source + "(debug (+ 1 2)\n",
+        program(10) + "(debug 1 $)\n" + program(10) + "(debug \"open\n",
+    };
+    const std::string expected[] = {
+        "line " + std::to_string(lines + 1) +
+            ", column 10: Unexpected character: $",
+        "line " + std::to_string(lines + 1) + ", column 1: expected ')'",
+        "line 41, column 10: Unexpected character: $",
+    };
+
+    for (int i = 0; i < 3; ++i) {
+      std::string sequential = error_of(broken[i], parse_source);
+      std::string parallel =
+          error_of(broken[i], [&](const std::string& code) {
+            return parse_parallel(code, chunks);
+          });
+
+      if (sequential != expected[i] || parallel != expected[i]) {
+        std::cerr << label << ", error " << i << ": '" << parallel
+                  << "' in parallel, '" << sequential << "' in sequence"
+                  << std::endl;
+        ++failures;
+      }
+    }
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+(def m1 (hash_map "a" 1 "b" 2))
+
+(def m2 (assoc m1 "c" 3))
+
+(def m3 (assoc m2 "a" 10))
+
+(def m4 (dissoc m3 "b"))
+
+(debug (length m1) (length m2) (length m3) (length m4))
+
+(debug (get m1 "a") (get m2 "a") (get m3 "a") (get m4 "b" "none"))
+
+(debug (contains m1 "c") (contains m2 "c") (contains m3 "b") (contains m4 "b"))
+
+(debug (keys m3) (vals m3))
+
+(def bits 4602678819172646912)
+
+(def c1 (hash_map 0.5 "half" bits "int"))
+
+(def c2 (assoc c1 1 "one"))
+
+(def c3 (assoc c2 4602678819172646912.0 "float"))
+
+(def c4 (dissoc c3 0.5))
+
+(def c5 (dissoc c4 bits))
+
+(debug (length c1) (get c1 0.5) (get c1 bits) (length c3) (get c3 bits))
+
+(debug (get c2 bits) (length c4) (get c4 0.5 "gone") (get c4 bits))
+
+(debug (length c5) (get c5 1) (get c5 bits "gone") (get c3 0.5))
+
+(def big (hash_map))
+
+(def half big)
+
+(def i 0)
+
+(while (< i 20000) (set big (assoc big i (* i 2))) (if (= i 9999) (set half big)) (set i (+ i 1)))
+
+(debug (length big) (length half) (get big 19999) (get half 19999 "absent"))
+
+(def sum 0)
+
+(set i 0)
+
+(while (< i 20000) (set sum (+ sum (get half i 0))) (set big (dissoc big i)) (set i (+ i 1)))
+
+(debug sum (length big) (length half) (get half 9999))
+
+(def v (pvec))
+
+(def v32 v)
+
+(def v1024 v)
+
+(set i 0)
+
+(while (< i 1100) (set v (conj v (* i 3))) (if (= i 31) (set v32 v)) (if (= i 1023) (set v1024 v)) (set i (+ i 1)))
+
+(debug (length v) (length v32) (length v1024) (get v1024 1024 "past"))
+
+(debug (get v 31) (get v 32) (get v 1023) (get v 1024) (get v 1099))
+
+(set sum 0)
+
+(set i 0)
+
+(while (< i 1100) (set sum (+ sum (get v i))) (set i (+ i 1)))
+
+(debug sum)
+
+(def w (assoc (assoc v 1050 "x") 5 "y"))
+
+(debug (get w 1050) (get v 1050) (get w 5) (get v 5) (get v1024 5) (length w))
+
+(def appended (assoc v32 32 "end"))
+
+(debug (length appended) (get appended 32) (length v32) (get v32 32 "past"))
+
+(debug v32)
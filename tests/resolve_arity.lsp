@@ -0,0 +1,3 @@
+(fun two (x y) ((+ x y)))
+(debug (two 1 2))
+(debug (two 1))
@@ -0,0 +1,4 @@
+(fun known (x) ((+ x 1)))
+(debug (known 1))
+(debug (unknown 1))
+(fun unknown (x) (x))
@@ -0,0 +1,4 @@
+(def a 1)
+(debug a)
+(debug later)
+(def later 2)
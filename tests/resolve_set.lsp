@@ -0,0 +1,5 @@
+(def a 1)
+(debug a)
+(set later 2)
+(def later 3)
+(debug later)
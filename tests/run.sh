@@ -0,0 +1,128 @@
+#!/bin/sh
+# runs the tests, "make test" builds what they need first:
+#
+#   build/test_*   built from tests/*.cc, exit non-zero on failure
+#   tests/*.lsp    run by build/flisp, output (stdout and stderr) has to
+#                  match tests/*.out. scripts run on both engines, which
+#                  also have to exit with the same status, except those
+#                  in interp_only (lists, maps, arrays and the builtins
+#                  using them are not in the vm). those in all_modes run
+#                  with each way of reading a file, the rest with -c
+#                  only. -c also runs with the tree cache on, once
+#                  missing and once hitting it, with the same output
+#                  expected, and the interpreter runs it with --no-jit
+#                  as well
+#   tests/*.stats  what --stats reports for the script of the same name:
+#                  the call cache and jit lines and the number of
+#                  collections
+#   tests/*.dump   what the optimizer makes of the script of the same
+#                  name as a whole program, printed by --dump -p
+
+build=${1:-./build}
+dir=$(dirname "$0")
+failed=0
+
+interp_only="arrays calls lists parallel parallel_debug parallel_set persistent"
+all_modes="main optimize resolve_arity resolve_function resolve_global resolve_set"
+
+cache=$(mktemp -d)
+trap 'rm -rf "$cache"' EXIT
+unset FLISP_CACHE_DIR
+
+# check expected label command..
+check() {
+  expected=$1
+  label=$2
+  shift 2
+
+  if "$@" 2>&1 | cmp -s - "$expected"; then
+    echo "ok: $label"
+  else
+    echo "FAILED: $label"
+    failed=1
+  fi
+}
+
+# same label mode script: the output and exit status of both engines
+same() {
+  interp=$("$build/flisp" "$2" "$3" 2>&1; echo "exit status $?")
+  vm=$("$build/flisp" --vm "$2" "$3" 2>&1; echo "exit status $?")
+
+  if [ "$interp" = "$vm" ]; then
+    echo "ok: $1"
+  else
+    echo "FAILED: $1"
+    failed=1
+  fi
+}
+
+for test in "$build"/test_*; do
+  [ -x "$test" ] || continue
+
+  if "$test"; then
+    echo "ok: $test"
+  else
+    echo "FAILED: $test"
+    failed=1
+  fi
+done
+
+for script in "$dir"/*.lsp; do
+  expected=${script%.lsp}.out
+  name=$(basename "$script" .lsp)
+  engines="interp --vm"
+  modes="-c"
+
+  case " $interp_only " in
+    *" $name "*) engines="interp" ;;
+  esac
+
+  case " $all_modes " in
+    *" $name "*) modes="-c -s -p" ;;
+  esac
+
+  for engine in $engines; do
+    [ "$engine" = interp ] && engine=""
+
+    for mode in $modes; do
+      check "$expected" "$script${engine:+ $engine} $mode" \
+        "$build/flisp" $engine $mode "$script"
+    done
+
+    if [ -z "$engine" ]; then
+      check "$expected" "$script --no-jit -c" \
+        "$build/flisp" --no-jit -c "$script"
+    fi
+
+    for run in miss hit; do
+      check "$expected" "$script${engine:+ $engine} -c, cache $run" \
+        env FLISP_CACHE_DIR="$cache/$engine" "$build/flisp" $engine -c "$script"
+    done
+  done
+
+  [ "$engines" = interp ] && continue
+
+  for mode in $modes; do
+    same "$script $mode, same on both engines" "$mode" "$script"
+  done
+done
+
+for stats in "$dir"/*.stats; do
+  [ -e "$stats" ] || continue
+  script=${stats%.stats}.lsp
+
+  check "$stats" "$script --stats" sh -c \
+    '"$1" --stats -c "$2" 2>&1 |
+      grep -o -e "^call cache: .*" -e "^jit: .*" \
+        -e "^gc: [0-9]* minor, [0-9]* major"' \
+    sh "$build/flisp" "$script"
+done
+
+for dump in "$dir"/*.dump; do
+  [ -e "$dump" ] || continue
+  script=${dump%.dump}.lsp
+
+  check "$dump" "$script --dump -p" "$build/flisp" --dump -p "$script"
+done
+
+exit $failed
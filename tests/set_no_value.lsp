@@ -0,0 +1,5 @@
+(def x 1)
+
+(fun f (a) ((set a)))
+
+(debug (f x))
@@ -0,0 +1,106 @@
+// every kernel set the cpu can run against plain loops, at every length
+// up to a few vector widths past a multiple of each (so the vector body,
+// the leftover elements and no elements at all are all covered), with
+// either operand a single broadcast value and with out being an operand.
+// the elements are small multiples of 1/4 and the divisors powers of 2,
+// so every result is exact whatever order a kernel adds in
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "simd.h"
+
+static int failures = 0;
+
+static void expect(bool same, const simd_kernels& kernels, const char* what,
+                   std::size_t n) {
+  if (!same) {
+    std::cerr << kernels.name << ": " << what << " of " << n
+              << " elements differs" << std::endl;
+    ++failures;
+  }
+}
+
+static double reference(simd_op op, double a, double b) {
+  switch (op) {
+    case simd_op::add:
+      return a + b;
+    case simd_op::sub:
+      return a - b;
+    case simd_op::mul:
+      return a * b;
+    case simd_op::div:
+      return a / b;
+  }
+
+  return 0;
+}
+
+int main() {
+  const simd_op ops[] = {simd_op::add, simd_op::sub, simd_op::mul,
+                         simd_op::div};
+  const double divisors[] = {0.5, 1, 2, -4, 8, -0.25, 16};
+
+  for (const simd_kernels* kernels : simd_available()) {
+    for (std::size_t n = 0; n <= 19; ++n) {
+      std::vector<double> a(n), b(n);
+
+      for (std::size_t i = 0; i < n; ++i) {
+        a[i] = static_cast<double>(i * 7 % 13) - 6 + 0.25 * (i % 4);
+        b[i] = divisors[i % 7];
+      }
+
+      double sum = 0, dot = 0;
+
+      for (std::size_t i = 0; i < n; ++i) {
+        sum += a[i];
+        dot += a[i] * b[i];
+      }
+
+      expect(kernels->sum(a.data(), n) == sum, *kernels, "sum", n);
+      expect(kernels->dot(a.data(), b.data(), n) == dot, *kernels, "dot", n);
+
+      if (n > 0) {
+        expect(kernels->min(a.data(), n) == *std::min_element(a.begin(),
+                                                              a.end()),
+               *kernels, "min", n);
+        expect(kernels->max(a.data(), n) == *std::max_element(a.begin(),
+                                                              a.end()),
+               *kernels, "max", n);
+      }
+
+      for (simd_op op : ops) {
+        for (int single = 0; single < 3; ++single) {
+          bool a_single = single == 1, b_single = single == 2;
+          std::vector<double> out(n), in_place = a;
+
+          // a single operand is read from element 0 only
+          double a0 = n > 0 ? a[0] : 0, b0 = n > 0 ? b[0] : 1;
+          std::vector<double> one_a = {a0}, one_b = {b0};
+          const double* x = a_single ? one_a.data() : a.data();
+          const double* y = b_single ? one_b.data() : b.data();
+
+          kernels->apply(op, x, a_single, y, b_single, out.data(), n);
+          kernels->apply(op, in_place.data(), false, y, b_single,
+                         in_place.data(), n);
+
+          bool same = true, same_in_place = true;
+
+          for (std::size_t i = 0; i < n; ++i) {
+            double lhs = a_single ? a0 : a[i];
+            double rhs = b_single ? b0 : b[i];
+            same = same && out[i] == reference(op, lhs, rhs);
+            same_in_place =
+                same_in_place && in_place[i] == reference(op, a[i], rhs);
+          }
+
+          expect(same, *kernels, "apply", n);
+          expect(same_in_place, *kernels, "apply in place", n);
+        }
+      }
+    }
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,3 @@
+(debug 1)
+
+(debug (+ 1 2)
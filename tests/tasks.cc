@@ -0,0 +1,102 @@
+// several tasks on the scheduler, each sleeping for its own delays and
+// noting the time it has slept to a shared log: the delays are spaced
+// far enough apart for the log to come out in a known interleaving. a
+// and b sleep through wait, a host call in tail position (resuming at
+// the vm's tail return), c calls sleep inside an expression. every task
+// ends with lookup in tail position, which resumes its task from inside
+// the host function, before the task has even stopped
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "scheduler.h"
+
+struct sleeper {
+  const char* name;
+  bool tail;  // sleeps through wait rather than calling sleep itself
+  std::vector<int> delays;
+};
+
+static std::string program(const sleeper& s) {
+  std::string code =
+      "(fun wait (ms) ((sleep ms)))"
+      "(fun fetch (k) ((lookup k)))"
+      "(def t 0) (def noted 0)";
+
+  for (int delay : s.delays) {
+    code += "(set t (+ t (" + std::string(s.tail ? "wait " : "sleep ") +
+            std::to_string(delay) + ")))";
+    code += "(set noted (note \"" + std::string(s.name) + "\" t))";
+  }
+
+  return code + "(debug t (fetch 21))";
+}
+
+int main() {
+  const std::vector<sleeper> sleepers = {
+      {"a", true, {20, 60}}, {"b", true, {40, 60}}, {"c", false, {60}}};
+  const std::vector<std::string> expected_log = {"a 20", "b 40", "c 60",
+                                                 "a 80", "b 100"};
+
+  std::mutex log_mutex;
+  std::vector<std::string> log;
+  symbol_id note = intern("note"), lookup = intern("lookup");
+
+  // more threads than tasks run at once, so tasks do run side by side
+  thread_pool pool(2);
+  scheduler loop(pool);
+
+  for (const sleeper& s : sleepers) {
+    loop.spawn(std::make_shared<const script>(program(s)), [&](task& added) {
+      added.machine().bind(note, 2, [&](vm&, const vm_value* args) {
+        std::lock_guard<std::mutex> lock(log_mutex);
+        log.push_back(std::get<std::string>(args[0]) + " " +
+                      std::to_string(std::get<int64_t>(args[1])));
+        return args[1];
+      });
+      added.machine().bind(lookup, 1, [&, target = &added](
+                                          vm& machine, const vm_value* args) {
+        machine.suspend();
+        loop.resume(*target, std::get<int64_t>(args[0]) * 2);
+        return vm_value();
+      });
+    });
+  }
+
+  loop.run();
+
+  int failures = 0;
+
+  if (log != expected_log) {
+    std::cerr << "the log is";
+
+    for (const std::string& line : log) {
+      std::cerr << " '" << line << "'";
+    }
+
+    std::cerr << std::endl;
+    ++failures;
+  }
+
+  for (std::size_t i = 0; i < sleepers.size(); ++i) {
+    int slept = 0;
+
+    for (int delay : sleepers[i].delays) {
+      slept += delay;
+    }
+
+    std::string expected =
+        "int: " + std::to_string(slept) + "\nint: 42\n";
+
+    if (loop.tasks()[i]->output() != expected) {
+      std::cerr << sleepers[i].name << " printed '"
+                << loop.tasks()[i]->output() << "'" << std::endl;
+      ++failures;
+    }
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+(fun f (a) ((debug a)))
+
+(f 5)
+
+(def x (debug 1))
+
+(if #t (debug 2) (debug 3))
+
+(while #f (debug 4))
+
+7
+
+"ignored"
+
+x
+
+(f (+ x 6))
+
+(1 2)
+
+(debug 8)